@@ -5,6 +5,8 @@ import json
 import random
 import secrets
 import string
+import struct
+import time
 import datetime
 import aiohttp
 
@@ -43,6 +45,7 @@ environment = os.environ.get("ENVIRONMENT") or "PROD"
 geo_lite_db_path = os.environ.get("GEO_PATH") or "GeoLite2-City.mmdb"
 google_stat_send = os.environ.get("GOOGLE_STAT", "False").lower() in ("true", "1", "t")
 ip_info_token = os.environ.get("IP_INFO_TOKEN") or ""
+binary_snapshot_interval = int(os.environ.get("BINARY_SNAPSHOT_INTERVAL", 300))
 
 logging.basicConfig(level=log_level, format="%(asctime)s %(levelname)s : %(message)s")
 logger = logging.getLogger(__name__)
@@ -84,6 +87,7 @@ class SharedData:
         self.trackers = {}
         self.blocked_ips = []
         self.test_id = None
+        self.binary_values = {}
 
 
 shared_data = SharedData()
@@ -95,6 +99,36 @@ class AlertVersion:
     v3 = 3
 
 
+# clients that advertise this protocol in user_info get binary delta frames instead of v3 JSON
+BINARY_PROTOCOL_VERSION = 4
+# binary frames carry server send time, client reports alert latency in "stats" message
+BINARY_SENT_TIME_PROTOCOL_VERSION = 5
+
+
+class BinaryFrame:
+    # frame: version, type, flags, sequence (uint32), records count, [send time in unix ms (uint64)], records
+    # little endian
+    # must match firmware/src/JaamDeltaDecoder.h
+    version = 1
+    alerts = 1
+    explosions = 2
+    missiles = 3
+    drones = 4
+    weather = 5
+    types = [alerts, explosions, missiles, drones, weather]
+    flag_snapshot = 0x01
+    flag_sent_time = 0x02
+    header_format = "<BBBIB"
+    sent_time_format = "<Q"
+    record_formats = {
+        alerts: "<BBI",  # slot, state, unix time
+        explosions: "<BI",  # slot, unix time
+        missiles: "<BI",
+        drones: "<BI",
+        weather: "<Bh",  # slot, temperature in 1/10 degree
+    }
+
+
 regions = {
     "Закарпатська область": {"id": 0},
     "Івано-Франківська область": {"id": 1},
@@ -260,7 +294,9 @@ async def get_geo_ip_data(ip, mc, request):
             return data
 
 
-async def message_handler(websocket: ServerConnection, client, client_id, client_ip, country, region, city):
+async def message_handler(
+    websocket: ServerConnection, client, client_id, client_ip, binary_state, country, region, city
+):
     if google_stat_send:
         tracker = shared_data.trackers[f"{client_ip}_{client_id}"]
     async for message in websocket:
@@ -290,6 +326,7 @@ async def message_handler(websocket: ServerConnection, client, client_id, client
                 logger.debug(f"{client_ip}:{chip_id} >>> firmware saved")
             case "user_info":
                 json_data = json.loads(data)
+                client["protocol"] = int(json_data.get("protocol", AlertVersion.v3))
                 if google_stat_send:
                     for key, value in json_data.items():
                         tracker.store.set_user_property(key, value)
@@ -309,6 +346,16 @@ async def message_handler(websocket: ServerConnection, client, client_id, client
                     online_event.set_event_param("online", "true")
                     await send_google_stat(tracker, online_event)
                 logger.debug(f"{client_ip}:{data} >>> chip_id saved")
+            case "resync":
+                # client lost a delta frame, next frame of this type will be a snapshot
+                binary_state["resync"].add(int(data))
+                logger.info(f"{client_ip}:{chip_id} >>> resync requested: {data}")
+            case "state_hash":
+                frame_type, sequence, state_hash = (int(part) for part in data.split(","))
+                expected = binary_state["hashes"].get(frame_type)
+                if expected and expected[0] == sequence and expected[1] != state_hash:
+                    binary_state["resync"].add(frame_type)
+                    logger.warning(f"{client_ip}:{chip_id} !!! state hash mismatch: {frame_type}, sequence {sequence}")
             case "settings":
                 json_data = json.loads(data)
                 if google_stat_send:
@@ -317,11 +364,119 @@ async def message_handler(websocket: ServerConnection, client, client_id, client
                         settings_event.set_event_param(key, value)
                     await send_google_stat(tracker, settings_event)
                     logger.debug(f"{client_ip}:{chip_id} >>> settings analytics sent")
+            case "stats":
+                # alert latency percentiles in ms per stage: [count, p50, p99, max]
+                json_data = json.loads(data)
+                client["alert_latency"] = json_data.get("latency")
+                logger.debug(f"{client_ip}:{chip_id} >>> stats saved")
+                if google_stat_send and client["alert_latency"]:
+                    latency_event = tracker.create_new_event("latency")
+                    for stage, (count, p50, p99, max_latency) in client["alert_latency"].items():
+                        latency_event.set_event_param(f"{stage}_count", count)
+                        latency_event.set_event_param(f"{stage}_p50", p50)
+                        latency_event.set_event_param(f"{stage}_p99", p99)
+                        latency_event.set_event_param(f"{stage}_max", max_latency)
+                    await send_google_stat(tracker, latency_event)
             case _:
                 logger.debug(f"{client_ip}:{chip_id} !!! unknown data request")
 
 
-async def alerts_data(websocket: ServerConnection, client, client_id, client_ip, shared_data, alert_version):
+def parse_alerts_v2(alerts_v2):
+    alerts = []
+    for alert in json.loads(alerts_v2):
+        datetime_obj = datetime.datetime.fromisoformat(alert[1].replace("Z", "+00:00"))
+        datetime_obj_utc = datetime_obj.replace(tzinfo=datetime.UTC)
+        alerts.append([int(alert[0]), int(datetime_obj_utc.timestamp())])
+    return alerts
+
+
+def get_binary_values(shared_data, frame_type):
+    # values are parsed once per data change and shared by all clients
+    match frame_type:
+        case BinaryFrame.alerts:
+            source = shared_data.alerts_v2
+        case BinaryFrame.explosions:
+            source = shared_data.explosions_v1
+        case BinaryFrame.missiles:
+            source = shared_data.rockets_v1
+        case BinaryFrame.drones:
+            source = shared_data.drones_v1
+        case BinaryFrame.weather:
+            source = shared_data.weather_v1
+    cached = shared_data.binary_values.get(frame_type)
+    if cached and cached[0] == source:
+        return cached[1]
+    match frame_type:
+        case BinaryFrame.alerts:
+            values = [tuple(alert) for alert in parse_alerts_v2(source)]
+        case BinaryFrame.weather:
+            values = [(round(float(weather) * 10),) for weather in json.loads(source)]
+        case _:
+            values = [(int(value),) for value in json.loads(source)]
+    shared_data.binary_values[frame_type] = (source, values)
+    return values
+
+
+def fnv1a(data):
+    value = 2166136261
+    for byte in data:
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def pack_binary_records(frame_type, values, slots):
+    record_format = BinaryFrame.record_formats[frame_type]
+    return b"".join(struct.pack(record_format, slot, *values[slot]) for slot in slots)
+
+
+def pack_binary_frame(frame_type, sequence, records, count, snapshot, sent_time=None):
+    flags = BinaryFrame.flag_snapshot if snapshot else 0
+    if sent_time is not None:
+        flags |= BinaryFrame.flag_sent_time
+    frame = struct.pack(BinaryFrame.header_format, BinaryFrame.version, frame_type, flags, sequence, count)
+    if sent_time is not None:
+        frame += struct.pack(BinaryFrame.sent_time_format, sent_time)
+    return frame + records
+
+
+async def send_binary_updates(
+    websocket: ServerConnection, client_ip, chip_id, shared_data, binary_state, send_sent_time
+):
+    snapshot_due = time.monotonic() - binary_state["snapshot_time"] >= binary_snapshot_interval
+    for frame_type in BinaryFrame.types:
+        values = get_binary_values(shared_data, frame_type)
+        sent_values = binary_state["values"].get(frame_type)
+        snapshot = (
+            snapshot_due
+            or frame_type in binary_state["resync"]
+            or sent_values is None
+            or len(sent_values) != len(values)
+        )
+        if snapshot:
+            slots = list(range(len(values)))
+        else:
+            slots = [slot for slot, value in enumerate(values) if value != sent_values[slot]]
+            if not slots:
+                continue
+        sequence = binary_state["sequences"].get(frame_type, 0) + 1
+        records = pack_binary_records(frame_type, values, slots)
+        sent_time = time.time_ns() // 1_000_000 if send_sent_time else None
+        frame = pack_binary_frame(frame_type, sequence, records, len(slots), snapshot, sent_time)
+        await websocket.send(frame)
+        logger.debug(f"{client_ip}:{chip_id} <<< binary {frame_type}, sequence {sequence}, {len(slots)} records")
+        binary_state["values"][frame_type] = values
+        binary_state["sequences"][frame_type] = sequence
+        binary_state["resync"].discard(frame_type)
+        if snapshot:
+            # client answers snapshot with hash of its state, see "state_hash" message
+            binary_state["hashes"][frame_type] = (sequence, fnv1a(records))
+    if snapshot_due:
+        binary_state["snapshot_time"] = time.monotonic()
+
+
+async def alerts_data(
+    websocket: ServerConnection, client, client_id, client_ip, shared_data, binary_state, alert_version
+):
     while True:
         try:
             chip_id = await get_client_chip_id(client)
@@ -347,6 +502,9 @@ async def alerts_data(websocket: ServerConnection, client, client_id, client_ip,
                         await websocket.send(payload)
                         logger.debug(f"{client_ip}:{chip_id} <<< new alerts")
                         client["alerts"] = shared_data.alerts_v2
+                case AlertVersion.v3 if client["protocol"] >= BINARY_PROTOCOL_VERSION:
+                    send_sent_time = client["protocol"] >= BINARY_SENT_TIME_PROTOCOL_VERSION
+                    await send_binary_updates(websocket, client_ip, chip_id, shared_data, binary_state, send_sent_time)
                 case AlertVersion.v3:
                     if client["alerts"] != shared_data.alerts_v2:
                         alerts = []
@@ -371,18 +529,20 @@ async def alerts_data(websocket: ServerConnection, client, client_id, client_ip,
                         await websocket.send(payload)
                         logger.debug(f"{client_ip}:{chip_id} <<< new drones")
                         client["drones"] = shared_data.drones_v1
-            if client["explosions"] != shared_data.explosions_v1:
-                explosions = json.dumps([int(explosion) for explosion in json.loads(shared_data.explosions_v1)])
-                payload = '{"payload": "explosions", "explosions": %s}' % explosions
-                await websocket.send(payload)
-                logger.debug(f"{client_ip}:{chip_id} <<< new explosions")
-                client["explosions"] = shared_data.explosions_v1
-            if client["weather"] != shared_data.weather_v1:
-                weather = json.dumps([float(weather) for weather in json.loads(shared_data.weather_v1)])
-                payload = '{"payload":"weather","weather":%s}' % weather
-                await websocket.send(payload)
-                logger.debug(f"{client_ip}:{chip_id} <<< new weather")
-                client["weather"] = shared_data.weather_v1
+            # explosions and weather are sent in binary frames to binary protocol clients
+            if client["protocol"] < BINARY_PROTOCOL_VERSION:
+                if client["explosions"] != shared_data.explosions_v1:
+                    explosions = json.dumps([int(explosion) for explosion in json.loads(shared_data.explosions_v1)])
+                    payload = '{"payload": "explosions", "explosions": %s}' % explosions
+                    await websocket.send(payload)
+                    logger.debug(f"{client_ip}:{chip_id} <<< new explosions")
+                    client["explosions"] = shared_data.explosions_v1
+                if client["weather"] != shared_data.weather_v1:
+                    weather = json.dumps([float(weather) for weather in json.loads(shared_data.weather_v1)])
+                    payload = '{"payload":"weather","weather":%s}' % weather
+                    await websocket.send(payload)
+                    logger.debug(f"{client_ip}:{chip_id} <<< new weather")
+                    client["weather"] = shared_data.weather_v1
             if client["bins"] != shared_data.bins:
                 temp_bins = list(json.loads(shared_data.bins))
                 if firmware.startswith("3.") or firmware.startswith("2.") or firmware.startswith("1."):
@@ -473,7 +633,9 @@ async def echo(websocket: ServerConnection):
             "test_bins": "[]",
             "firmware": "unknown",
             "chip_id": "unknown",
+            "protocol": AlertVersion.v3,
             "latency": -1,
+            "alert_latency": None,
             "city": geo_ip_data["city"],
             "region": geo_ip_data["region"],
             "country": geo_ip_data["country"],
@@ -483,6 +645,9 @@ async def echo(websocket: ServerConnection):
             "secure_connection": secure_connection,
             "connect_time": datetime.datetime.now(tz=server_timezone).strftime("%Y-%m-%dT%H:%M:%S"),
         }
+        # last values, sequence numbers and state hashes sent to this client in binary frames,
+        # types requested by client for resync get a snapshot on next check
+        binary_state = {"values": {}, "sequences": {}, "hashes": {}, "resync": set(), "snapshot_time": 0}
         if google_stat_send:
             tracker = shared_data.trackers[f"{client_ip}_{client_id}"] = GtagMP(
                 api_secret=api_secret, measurement_id=measurement_id, client_id="temp_id"
@@ -491,19 +656,19 @@ async def echo(websocket: ServerConnection):
         match websocket.request.path:
             case "/data_v1":
                 producer_task = asyncio.create_task(
-                    alerts_data(websocket, client, client_id, client_ip, shared_data, AlertVersion.v1),
+                    alerts_data(websocket, client, client_id, client_ip, shared_data, binary_state, AlertVersion.v1),
                     name=f"alerts_data_{client_id}",
                 )
 
             case "/data_v2":
                 producer_task = asyncio.create_task(
-                    alerts_data(websocket, client, client_id, client_ip, shared_data, AlertVersion.v2),
+                    alerts_data(websocket, client, client_id, client_ip, shared_data, binary_state, AlertVersion.v2),
                     name=f"alerts_data_{client_id}",
                 )
 
             case "/data_v3":
                 producer_task = asyncio.create_task(
-                    alerts_data(websocket, client, client_id, client_ip, shared_data, AlertVersion.v3),
+                    alerts_data(websocket, client, client_id, client_ip, shared_data, binary_state, AlertVersion.v3),
                     name=f"alerts_data_{client_id}",
                 )
 
@@ -516,6 +681,7 @@ async def echo(websocket: ServerConnection):
                 client,
                 client_id,
                 client_ip,
+                binary_state,
                 geo_ip_data["country"],
                 geo_ip_data["region"],
                 geo_ip_data["city"],
@@ -0,0 +1,158 @@
+#include <Arduino.h>
+#include <FastLED.h>
+#include <ArduinoWebsockets.h>
+#include "JaamUtils.h"
+#include "JaamSettings.h"
+#include "JaamAlarms.h"
+#include "JaamPayloadParser.h"
+#include "JaamTraceBuffer.h"
+#include "JaamDeltaDecoder.h"
+#include "JaamMap.h"
+#include "JaamProfiler.h"
+#include "HostMap.h"
+#include "HostCommands.h"
+#include <chrono>
+
+// Same synthetic worst case as runRenderBenchmark() of the firmware: all regions in alert with all
+// notifications active in fade mode and 100 LEDs background strip. LED output and display are
+// hardware, so only map render, color pass and payload parsing are measured. Samples are in
+// nanoseconds of the host steady clock instead of CPU cycles.
+
+#define BENCHMARK_FRAMES PROFILER_SAMPLES_COUNT
+#define BENCHMARK_REGRESSION_PERCENT 10
+#define BENCHMARK_BG_LEDS_COUNT 100
+
+static uint32_t getHostNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// baseline has the same format as on device: comma separated p99 values for every stage
+static bool readBaseline(const char* path, uint32_t baseline[]) {
+  FILE* file = fopen(path, "r");
+  if (!file) return false;
+  char value[JaamProfiler::STAGES_COUNT * 11 + 1] = "";
+  bool read = fgets(value, sizeof(value), file) != nullptr;
+  fclose(file);
+  if (!read) return false;
+  const char* pos = value;
+  for (int stage = 0; stage < JaamProfiler::STAGES_COUNT; stage++) {
+    char* end;
+    baseline[stage] = strtoul(pos, &end, 10);
+    if (end == pos) return false;
+    pos = *end == ',' ? end + 1 : end;
+  }
+  return true;
+}
+
+static bool saveBaseline(const char* path, JaamProfiler& profiler) {
+  FILE* file = fopen(path, "w");
+  if (!file) return false;
+  for (int stage = 0; stage < JaamProfiler::STAGES_COUNT; stage++) {
+    fprintf(file, "%s%u", stage > 0 ? "," : "", profiler.getSummary((JaamProfiler::Stage) stage).p99);
+  }
+  fprintf(file, "\n");
+  fclose(file);
+  return true;
+}
+
+int runBenchmark(int argc, char** argv) {
+  int frames = BENCHMARK_FRAMES;
+  const char* baselinePath = nullptr;
+  const char* saveBaselinePath = nullptr;
+  for (int i = 0; i < argc; i++) {
+    if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frames = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+      baselinePath = argv[++i];
+    } else if (strcmp(argv[i], "--save-baseline") == 0 && i + 1 < argc) {
+      saveBaselinePath = argv[++i];
+    } else {
+      frames = 0;
+      break;
+    }
+  }
+  if (frames <= 0) {
+    fprintf(stderr, "usage: program benchmark [--frames N] [--baseline file] [--save-baseline file]\n");
+    return 2;
+  }
+
+  JaamSettings settings;
+  settings.init();
+  HostMap map;
+  if (!map.init(settings)) return 1;
+  RenderConfig config = map.getConfig();
+  config.notifyMode = 2;
+  config.enableExplosions = true;
+  config.enableMissiles = true;
+  config.enableDrones = true;
+  config.bgStripEnabled = true;
+  config.bgLedCount = BENCHMARK_BG_LEDS_COUNT;
+  long currentTime = 1700000000;
+  AlarmsState<MAIN_LEDS_COUNT> state;
+  for (int i = 0; i < MAIN_LEDS_COUNT; i++) {
+    state.alertState[i] = ALERT;
+    state.alertTime[i] = currentTime;
+    state.explosionTime[i] = currentTime;
+    state.missilesTime[i] = currentTime;
+    state.dronesTime[i] = currentTime;
+  }
+  char payload[40 + REGION_SLOTS_COUNT * 16];
+  int length = sprintf(payload, "{\"payload\":\"alerts\",\"alerts\":[");
+  for (int i = 0; i < REGION_SLOTS_COUNT; i++) {
+    length += sprintf(payload + length, "%s[1,%ld]", i > 0 ? "," : "", currentTime);
+  }
+  length += sprintf(payload + length, "]}");
+
+  JaamProfiler profiler;
+  CRGB strip[MAIN_LEDS_COUNT];
+  CRGB bgStrip[BENCHMARK_BG_LEDS_COUNT];
+  LedColor colors[MAIN_LEDS_COUNT];
+  uint32_t checksum = 0;
+  for (int frameIndex = 0; frameIndex < frames; frameIndex++) {
+    // fade phase moves as on device at 60 frames per second
+    int64_t frameTime = (int64_t) frameIndex * 16667;
+    uint32_t start = getHostNanos();
+    AlarmsFrame frame = getAlarmsFrame(config, currentTime, true, 0.05f, frameTime);
+    uint32_t colorsStart = getHostNanos();
+    getAlarmColors(config, frame, state, ALL_LEDS, ALL_LEDS, colors);
+    for (int led = 0; led < MAIN_LEDS_COUNT; led++) {
+      strip[led] = map.toColor(colors[led]);
+    }
+    profiler.add(JaamProfiler::PROCESS_ALARMS, getHostNanos() - colorsStart);
+    LedColor bgColor = getAlarmColor(config, frame, state.alertState[0], state.alertTime[0], state.explosionTime[0], state.missilesTime[0], state.dronesTime[0], true, true);
+    fill_solid(bgStrip, config.bgLedCount, map.toColor(bgColor));
+    profiler.add(JaamProfiler::MAP_ALARMS, getHostNanos() - start);
+    checksum += strip[frameIndex % MAIN_LEDS_COUNT].r + bgStrip[0].g;
+
+    start = getHostNanos();
+    uint8_t states[REGION_SLOTS_COUNT];
+    long times[REGION_SLOTS_COUNT];
+    JaamPayloadParser parser(payload, length);
+    if (parser.getPayload() == JaamPayloadParser::ALERTS) {
+      parser.readAlerts("alerts", states, times, REGION_SLOTS_COUNT);
+    }
+    profiler.add(JaamProfiler::WS_MESSAGE, getHostNanos() - start);
+    checksum += states[frameIndex % REGION_SLOTS_COUNT];
+  }
+
+  uint32_t baseline[JaamProfiler::STAGES_COUNT];
+  bool hasBaseline = baselinePath && readBaseline(baselinePath, baseline);
+  if (baselinePath && !hasBaseline) fprintf(stderr, "Can not read baseline %s\n", baselinePath);
+  bool regressed = false;
+  printf("benchmark: %d frames (checksum %u)\n", frames, checksum);
+  printf("%-18s %8s %10s %10s %10s %10s\n", "stage", "count", "min, ns", "p50, ns", "p99, ns", "max, ns");
+  for (int stage = 0; stage < JaamProfiler::STAGES_COUNT; stage++) {
+    JaamProfiler::Summary summary = profiler.getSummary((JaamProfiler::Stage) stage);
+    if (summary.count == 0) continue;
+    bool regression = hasBaseline && (uint64_t) summary.p99 * 100 > (uint64_t) baseline[stage] * (100 + BENCHMARK_REGRESSION_PERCENT);
+    regressed |= regression;
+    printf("%-18s %8u %10u %10u %10u %10u", JaamProfiler::getStageName((JaamProfiler::Stage) stage), summary.count, summary.min, summary.p50, summary.p99, summary.max);
+    if (hasBaseline) printf("  baseline %u%s", baseline[stage], regression ? " REGRESSION" : "");
+    printf("\n");
+  }
+  if (saveBaselinePath && !saveBaseline(saveBaselinePath, profiler)) {
+    fprintf(stderr, "Can not save baseline %s\n", saveBaselinePath);
+    return 1;
+  }
+  return regressed ? 1 : 0;
+}
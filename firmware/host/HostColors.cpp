@@ -0,0 +1,122 @@
+#include <Arduino.h>
+#include <FastLED.h>
+#include "JaamUtils.h"
+#include "JaamAlarms.h"
+#include "JaamPayloadParser.h"
+#include "JaamTraceBuffer.h"
+#include "HostCommands.h"
+#include <chrono>
+
+// Colors of all main LEDs are computed for every frame, as the render task does on full redraw.
+// Host CPU has fast float and rounding, ESP32 does floor/round and float divides in software or
+// with much higher latency, so the ratio on device is bigger than the one printed here.
+
+#define BRIGHTNESS_FACTOR 0.5f
+#define MIN_BRIGHTNESS 1
+
+// float HSV conversion as hue2rgb() did before the table, kept as reference
+static RGBColor hue2rgbFloat(int hue) {
+  float r, g, b;
+
+  float h = hue / 360.0;
+  float s = 1.0;
+  float v = 1.0;
+
+  int i = floor(h * 6);
+  float f = h * 6 - i;
+  float p = v * (1 - s);
+  float q = v * (1 - f * s);
+  float t = v * (1 - (1 - f) * s);
+
+  switch (i % 6) {
+    case 0: r = v, g = t, b = p; break;
+    case 1: r = q, g = v, b = p; break;
+    case 2: r = p, g = v, b = t; break;
+    case 3: r = p, g = q, b = v; break;
+    case 4: r = t, g = p, b = v; break;
+    case 5: r = v, g = p, b = q; break;
+    default: r = 1.0, g = 1.0, b = 1.0; break;
+  }
+  RGBColor rgb;
+  rgb.r = round(r * 255);
+  rgb.g = round(g * 255);
+  rgb.b = round(b * 255);
+  return rgb;
+}
+
+// fromHue() before fixed point brightness
+static CRGB fromHueFloat(int hue, float brightness) {
+  RGBColor rgb = hue2rgbFloat(hue);
+  int scaledBrightness = (brightness == 0.0f) ? 0 : round(max(brightness, MIN_BRIGHTNESS * 1.0f) * 255.0f / 100.0f * BRIGHTNESS_FACTOR);
+  return CRGB(rgb.r, rgb.g, rgb.b).nscale8_video(scaledBrightness);
+}
+
+static CRGB fromHueFixed(int hue, uint32_t brightness, uint32_t brightnessScale) {
+  RGBColor rgb = hue2rgb(hue);
+  return CRGB(rgb.r, rgb.g, rgb.b).nscale8_video(scaleBrightness(brightness, brightnessScale, MIN_BRIGHTNESS));
+}
+
+static int getDifference(CRGB first, CRGB second) {
+  return max(abs(first.r - second.r), max(abs(first.g - second.g), abs(first.b - second.b)));
+}
+
+int runColorsBenchmark(int argc, char** argv) {
+  int frames = argc > 0 ? atoi(argv[0]) : 100000;
+  if (frames <= 0) {
+    fprintf(stderr, "usage: program colors [frames]\n");
+    return 2;
+  }
+  uint32_t brightnessScale = lroundf(BRIGHTNESS_FACTOR * 255.0f / 10000.0f * 16777216.0f);
+
+  // every hue with every brightness step the firmware can produce (fading gives fractions of percent)
+  int maxDifference = 0;
+  int differentColors = 0;
+  int checkedColors = 0;
+  for (int hue = 0; hue <= 360; hue++) {
+    for (int brightness = 0; brightness <= 10000; brightness++) {
+      int difference = getDifference(fromHueFloat(hue, brightness / 100.0f), fromHueFixed(hue, brightness, brightnessScale));
+      maxDifference = max(maxDifference, difference);
+      if (difference > 0) differentColors++;
+      checkedColors++;
+    }
+  }
+
+  // inputs are prepared once, so both loops measure only color conversion
+  int hues[MAIN_LEDS_COUNT];
+  float brightnesses[MAIN_LEDS_COUNT];
+  uint32_t fixedBrightnesses[MAIN_LEDS_COUNT];
+  for (int led = 0; led < MAIN_LEDS_COUNT; led++) {
+    hues[led] = led * 360 / MAIN_LEDS_COUNT;
+    brightnesses[led] = 5.0f + led * 3.37f;
+    fixedBrightnesses[led] = toFixedBrightness(brightnesses[led]);
+  }
+  CRGB strip[MAIN_LEDS_COUNT];
+  uint32_t checksum = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int frame = 0; frame < frames; frame++) {
+    for (int led = 0; led < MAIN_LEDS_COUNT; led++) {
+      strip[led] = fromHueFloat((hues[led] + frame) % 360, brightnesses[led]);
+    }
+    checksum += strip[frame % MAIN_LEDS_COUNT].r;
+  }
+  auto floatDuration = std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  for (int frame = 0; frame < frames; frame++) {
+    for (int led = 0; led < MAIN_LEDS_COUNT; led++) {
+      strip[led] = fromHueFixed((hues[led] + frame) % 360, fixedBrightnesses[led], brightnessScale);
+    }
+    checksum += strip[frame % MAIN_LEDS_COUNT].r;
+  }
+  auto fixedDuration = std::chrono::steady_clock::now() - start;
+
+  double floatFrame = std::chrono::duration<double, std::nano>(floatDuration).count() / frames;
+  double fixedFrame = std::chrono::duration<double, std::nano>(fixedDuration).count() / frames;
+  printf("colors: %d frames of %d LEDs (checksum %u)\n", frames, MAIN_LEDS_COUNT, checksum);
+  printf("float HSV + float brightness: %.1f ns/frame\n", floatFrame);
+  printf("hue table + fixed brightness: %.1f ns/frame\n", fixedFrame);
+  printf("speedup: %.2fx\n", floatFrame / fixedFrame);
+  printf("max channel difference: %d (%d of %d colors differ)\n", maxDifference, differentColors, checkedColors);
+  return 0;
+}
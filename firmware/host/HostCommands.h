@@ -0,0 +1,14 @@
+// Commands of the host driver besides simulate, see main.cpp. Each one gets arguments after its name
+// and returns process exit code.
+// Expects JaamPayloadParser.h and JaamTraceBuffer.h to be included before.
+
+// loads trace or text file of frames, see main.cpp for formats
+bool loadTrace(const char* path, JaamTraceBuffer& trace);
+const char* getPayloadName(JaamPayloadParser::Payload payload);
+
+// compares table hue and fixed point brightness with the float color path they replaced
+int runColorsBenchmark(int argc, char** argv);
+// times map render stages on the synthetic worst case, exits with 1 if p99 regressed over baseline
+int runBenchmark(int argc, char** argv);
+// replays trace at recorded or scaled speed, reports latency of every message and peak heap
+int runReplay(int argc, char** argv);
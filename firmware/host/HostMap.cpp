@@ -0,0 +1,173 @@
+#include <Arduino.h>
+#include <FastLED.h>
+#include "JaamUtils.h"
+#include "JaamSettings.h"
+#include "JaamAlarms.h"
+#include "JaamPayloadParser.h"
+#include "JaamDeltaDecoder.h"
+#include "JaamMap.h"
+#include <ArduinoWebsockets.h>
+#include "HostMap.h"
+
+bool HostMap::init(JaamSettings& settings) {
+  loadRenderConfig(settings, config);
+  brightnessProfile = getBrightnessProfile(settings.getInt(LEGACY));
+  brightnessScale = getBrightnessScale(brightnessProfile.factor);
+  if (!loadLedLayout(settings, layout)) {
+    fprintf(stderr, "Unknown Kyiv district mode %d\n", settings.getInt(KYIV_DISTRICT_MODE));
+    return false;
+  }
+  homeDistrict = getHomeDistrict(layout, settings.getInt(HOME_DISTRICT));
+  fullRedraw = true;
+  return true;
+}
+
+void HostMap::updateLatestEventTime(const long times[]) {
+  for (int slot = 0; slot < REGION_SLOTS_COUNT; slot++) {
+    latestEventTime = max(latestEventTime, times[slot]);
+  }
+}
+
+void HostMap::requestResync(JaamDeltaDecoder::Type type) {
+  stats.resyncs++;
+  char resyncInfo[15];
+  sprintf(resyncInfo, "resync:%d", type);
+  client.send(resyncInfo);
+}
+
+void HostMap::reportStateHash(JaamDeltaDecoder& decoder) {
+  uint32_t hash;
+  if (!getStateHash(decoder, regions, &hash)) return;
+  stats.stateHashes++;
+  char hashInfo[45];
+  sprintf(hashInfo, "state_hash:%d,%u,%u", decoder.getType(), decoder.getSequence(), hash);
+  client.send(hashInfo);
+}
+
+// same steps as onDeltaFrame() of the firmware
+JaamPayloadParser::Payload HostMap::ingestDelta(JaamDeltaDecoder& decoder, uint32_t* changedSlots) {
+  switch (deltaSequence.check(decoder)) {
+    case JaamDeltaSequence::GAP:
+      requestResync(decoder.getType());
+      return JaamPayloadParser::UNKNOWN;
+    case JaamDeltaSequence::APPLY:
+      break;
+    default:
+      return JaamPayloadParser::UNKNOWN;
+  }
+  JaamPayloadParser::Payload payload = applyDeltaFrame(decoder, regions, changedSlots);
+  if (payload == JaamPayloadParser::UNKNOWN) return payload;
+  reportStateHash(decoder);
+  return payload;
+}
+
+JaamPayloadParser::Payload HostMap::ingest(const uint8_t* data, size_t length, uint32_t* changedSlots) {
+  *changedSlots = 0;
+  JaamPayloadParser::Payload payload = JaamPayloadParser::UNKNOWN;
+  JaamDeltaDecoder decoder(data, length);
+  if (decoder.isValid()) {
+    payload = ingestDelta(decoder, changedSlots);
+  } else {
+    JaamPayloadParser parser((const char*) data, length);
+    payload = applyJsonPayload(parser, regions, changedSlots);
+  }
+  switch (payload) {
+    case JaamPayloadParser::ALERTS:
+      updateLatestEventTime(regions.alertTime);
+      break;
+    case JaamPayloadParser::EXPLOSIONS:
+      updateLatestEventTime(regions.explosionTime);
+      break;
+    case JaamPayloadParser::MISSILES:
+      updateLatestEventTime(regions.missilesTime);
+      break;
+    case JaamPayloadParser::DRONES:
+      updateLatestEventTime(regions.dronesTime);
+      break;
+    default:
+      break;
+  }
+  if (payload == JaamPayloadParser::UNKNOWN) {
+    stats.skippedFrames++;
+  } else {
+    stats.frames++;
+  }
+  return payload;
+}
+
+// same as remap functions of the firmware render task
+void HostMap::remap(JaamPayloadParser::Payload payload, uint32_t changedSlots) {
+  switch (payload) {
+    case JaamPayloadParser::ALERTS:
+      if (changedSlots & homeDistrict.neighborSlots) bgStripDirty = true;
+      dirtyLeds |= remapAlerts(layout, regions, leds, changedSlots);
+      break;
+    case JaamPayloadParser::WEATHER:
+      dirtyLeds |= remapWeather(layout, regions, leds, changedSlots);
+      break;
+    case JaamPayloadParser::EXPLOSIONS:
+      dirtyLeds |= remapExplosions(layout, regions, leds, changedSlots);
+      break;
+    case JaamPayloadParser::MISSILES:
+      dirtyLeds |= remapMissiles(layout, regions, leds, changedSlots);
+      break;
+    case JaamPayloadParser::DRONES:
+      dirtyLeds |= remapDrones(layout, regions, leds, changedSlots);
+      break;
+    default:
+      break;
+  }
+}
+
+CRGB HostMap::toColor(const LedColor& color) {
+  RGBColor rgb = hue2rgb(color.hue);
+  return CRGB(rgb.r, rgb.g, rgb.b).nscale8_video(scaleBrightness(color.brightness, brightnessScale, brightnessProfile.minBrightness));
+}
+
+// same steps as mapAlarms() of the firmware for alarms map mode
+void HostMap::render(long unixTime, int64_t frameTime) {
+  AlarmsFrame frame = getAlarmsFrame(config, unixTime, isAlertInSlots(regions.alertState, homeDistrict.neighborSlots), brightnessProfile.minBlinkBrightness, frameTime);
+  AlarmsPass pass = getAlarmsPass(fullRedraw, dirtyLeds, animatedLeds, bgStripDirty, homeDistrict);
+  LedColor colors[MAIN_LEDS_COUNT];
+  animatedLeds = getAlarmColors(config, frame, leds, homeDistrict.leds, pass.ledsToRender, colors);
+  for (int led = 0; led < MAIN_LEDS_COUNT; led++) {
+    if ((pass.ledsToRender >> led) & 1) strip[led] = toColor(colors[led]);
+  }
+  if (config.bgStripEnabled && pass.renderBgStrip) {
+    LedColor color;
+    bgColor = getBgStripColor(config, frame, leds, homeDistrict, &color) ? toColor(color) : CRGB::Black;
+  }
+  stats.renderedFrames++;
+  stats.renderedLeds += __builtin_popcount(pass.ledsToRender);
+  dirtyLeds = 0;
+  bgStripDirty = false;
+  fullRedraw = false;
+}
+
+bool HostMap::isAnimated() {
+  return config.notifyMode == 2 && animatedLeds != 0;
+}
+
+long HostMap::getLatestEventTime() {
+  return latestEventTime;
+}
+
+const RenderConfig& HostMap::getConfig() {
+  return config;
+}
+
+const CRGB* HostMap::getStrip() {
+  return strip;
+}
+
+CRGB HostMap::getBgColor() {
+  return bgColor;
+}
+
+HostMap::Stats HostMap::getStats() {
+  return stats;
+}
+
+websockets::WebsocketsClient& HostMap::getClient() {
+  return client;
+}
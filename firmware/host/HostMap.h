@@ -0,0 +1,64 @@
+#include <stddef.h>
+#include <stdint.h>
+
+// Map pipeline of the firmware for host drivers: websocket frames are parsed into regions state,
+// remapped to LEDs and rendered into a strip in memory with the steps of JaamMap the firmware calls.
+// Task split, LED hardware and side effects of data (sounds, display, Home Assistant) stay in firmware.
+// Replies the firmware would send to the server (resync, state hash) go to the stub websocket client,
+// which only keeps them.
+// Expects JaamAlarms.h, JaamPayloadParser.h, JaamDeltaDecoder.h, JaamSettings.h, JaamMap.h, FastLED.h and
+// ArduinoWebsockets.h to be included before.
+class HostMap {
+
+public:
+    struct Stats {
+        uint32_t frames; // data frames applied
+        uint32_t skippedFrames; // frames that are not data or were rejected
+        uint32_t resyncs; // resync requests after delta gaps
+        uint32_t stateHashes; // state hash reports after snapshots
+        uint32_t renderedFrames;
+        uint32_t renderedLeds;
+    };
+    // reads LED layout, home district and render config from settings, returns false if layout is unknown
+    bool init(JaamSettings& settings);
+    // parses frame into regions state, returns UNKNOWN if frame has no applied data
+    JaamPayloadParser::Payload ingest(const uint8_t* data, size_t length, uint32_t* changedSlots);
+    // gathers changed region slots to LEDs
+    void remap(JaamPayloadParser::Payload payload, uint32_t changedSlots);
+    // renders changed LEDs and LEDs in transition, frame time (us) gives phase of fading
+    void render(long unixTime, int64_t frameTime);
+    // strip color of hue and brightness with brightness factor of the board
+    CRGB toColor(const LedColor& color);
+    // LEDs are in time based transition, so every frame differs
+    bool isAnimated();
+    // the newest time of the last applied data, 0 if there is no data yet
+    long getLatestEventTime();
+    const RenderConfig& getConfig();
+    const CRGB* getStrip();
+    CRGB getBgColor();
+    Stats getStats();
+    websockets::WebsocketsClient& getClient();
+
+private:
+    RenderConfig config;
+    LedLayout<MAIN_LEDS_COUNT> layout;
+    AlarmsState<REGION_SLOTS_COUNT> regions;
+    AlarmsState<MAIN_LEDS_COUNT> leds;
+    HomeDistrict homeDistrict = {0, -1, 0};
+    uint32_t dirtyLeds = ALL_LEDS;
+    uint32_t animatedLeds = 0;
+    bool fullRedraw = true;
+    bool bgStripDirty = true;
+    uint32_t brightnessScale = 0;
+    BrightnessProfile brightnessProfile;
+    JaamDeltaSequence deltaSequence;
+    long latestEventTime = 0;
+    CRGB strip[MAIN_LEDS_COUNT];
+    CRGB bgColor;
+    Stats stats = {};
+    websockets::WebsocketsClient client;
+    JaamPayloadParser::Payload ingestDelta(JaamDeltaDecoder& decoder, uint32_t* changedSlots);
+    void requestResync(JaamDeltaDecoder::Type type);
+    void reportStateHash(JaamDeltaDecoder& decoder);
+    void updateLatestEventTime(const long times[]);
+};
@@ -0,0 +1,164 @@
+#include <Arduino.h>
+#include <FastLED.h>
+#include <ArduinoWebsockets.h>
+#include "HostClock.h"
+#include "JaamUtils.h"
+#include "JaamSettings.h"
+#include "JaamAlarms.h"
+#include "JaamPayloadParser.h"
+#include "JaamDeltaDecoder.h"
+#include "JaamMap.h"
+#include "JaamTraceBuffer.h"
+#include "HostMap.h"
+#include "HostCommands.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+#include <vector>
+
+// Replays a trace through parse -> remap -> render as the device would get it and reports latency of
+// every message and heap used on the way. Message latency is wall clock time from the moment the
+// message is due (its trace time scaled by speed) until its frame is rendered, so it includes time
+// the replay spent behind schedule. Rendering on device waits for the next frame tick in addition.
+// Heap is tracked by global operator new and delete of this program, firmware modules allocate
+// only through them or through malloc at setup (trace buffer), which is done before replay starts.
+
+// every block has a header with its size, aligned so that the block keeps alignment of malloc
+struct alignas(alignof(max_align_t)) HeapHeader {
+  size_t size;
+};
+
+static std::atomic<size_t> heapUsed(0);
+static std::atomic<size_t> heapPeak(0);
+static std::atomic<uint32_t> heapAllocations(0);
+
+void* operator new(size_t size) {
+  HeapHeader* header = (HeapHeader*) malloc(sizeof(HeapHeader) + size);
+  if (!header) throw std::bad_alloc();
+  header->size = size;
+  size_t used = heapUsed += size;
+  size_t peak = heapPeak;
+  while (used > peak && !heapPeak.compare_exchange_weak(peak, used)) {}
+  heapAllocations++;
+  return header + 1;
+}
+
+void operator delete(void* block) noexcept {
+  if (!block) return;
+  HeapHeader* header = (HeapHeader*) block - 1;
+  heapUsed -= header->size;
+  free(header);
+}
+
+void operator delete(void* block, size_t) noexcept {
+  operator delete(block);
+}
+
+static uint32_t getPercentile(std::vector<uint32_t> values, int percent) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  return values[(values.size() - 1) * percent / 100];
+}
+
+static void printLatency(const char* name, const std::vector<uint32_t>& values) {
+  printf("%-8s %10u %10u %10u %10u\n", name, getPercentile(values, 0), getPercentile(values, 50), getPercentile(values, 99), getPercentile(values, 100));
+}
+
+static uint32_t getMicros(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+int runReplay(int argc, char** argv) {
+  if (argc < 1) {
+    fprintf(stderr, "usage: program replay <trace> [--speed N] [--verbose]\n");
+    return 2;
+  }
+  const char* tracePath = argv[0];
+  double speed = 1.0;
+  bool verbose = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+      speed = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--verbose") == 0) {
+      verbose = true;
+    } else {
+      fprintf(stderr, "usage: program replay <trace> [--speed N] [--verbose]\n");
+      return 2;
+    }
+  }
+
+  JaamSettings settings;
+  settings.init();
+  JaamTraceBuffer trace(1 << 24);
+  if (!trace.allocate() || !loadTrace(tracePath, trace)) return 1;
+  HostMap map;
+  if (!map.init(settings)) return 1;
+  std::vector<uint32_t> parseLatency;
+  std::vector<uint32_t> remapLatency;
+  std::vector<uint32_t> showLatency;
+  std::vector<uint32_t> messageLatency;
+  parseLatency.reserve(trace.getCount());
+  remapLatency.reserve(trace.getCount());
+  showLatency.reserve(trace.getCount());
+  messageLatency.reserve(trace.getCount());
+
+  size_t heapStart = heapUsed;
+  heapPeak = heapStart;
+  uint32_t allocationsStart = heapAllocations;
+  size_t offset = 0;
+  uint32_t time;
+  const uint8_t* data;
+  size_t length;
+  uint32_t traceStart = 0;
+  bool first = true;
+  long unixStart = 0;
+  uint32_t unixStartAt = 0;
+  auto replayStart = std::chrono::steady_clock::now();
+  while (trace.next(&offset, &time, &data, &length)) {
+    if (first) traceStart = time;
+    first = false;
+    auto due = replayStart;
+    if (speed > 0) {
+      due += std::chrono::microseconds((int64_t) ((time - traceStart) * 1000.0 / speed));
+      std::this_thread::sleep_until(due);
+    } else {
+      due = std::chrono::steady_clock::now();
+    }
+    // colors depend on the fake clock only, so they are the same at any speed
+    setHostTime((int64_t) (time - traceStart) * 1000);
+    uint32_t changedSlots;
+    auto start = std::chrono::steady_clock::now();
+    JaamPayloadParser::Payload payload = map.ingest(data, length, &changedSlots);
+    auto parsed = std::chrono::steady_clock::now();
+    if (payload == JaamPayloadParser::UNKNOWN) continue;
+    if (unixStart == 0) {
+      unixStart = map.getLatestEventTime();
+      unixStartAt = time;
+    }
+    map.remap(payload, changedSlots);
+    auto remapped = std::chrono::steady_clock::now();
+    map.render(unixStart + (time - unixStartAt) / 1000, getHostTime());
+    auto shown = std::chrono::steady_clock::now();
+    parseLatency.push_back(getMicros(parsed - start));
+    remapLatency.push_back(getMicros(remapped - parsed));
+    showLatency.push_back(getMicros(shown - remapped));
+    messageLatency.push_back(getMicros(shown - due));
+    if (verbose) {
+      printf("%u %s %u us, heap %zu\n", time, getPayloadName(payload), messageLatency.back(), heapUsed - heapStart);
+    }
+  }
+  auto replayDuration = std::chrono::steady_clock::now() - replayStart;
+
+  HostMap::Stats stats = map.getStats();
+  printf("replay: %d frames, %u applied, %u skipped, %u resyncs in %u ms\n",
+    trace.getCount(), stats.frames, stats.skippedFrames, stats.resyncs, getMicros(replayDuration) / 1000);
+  printf("%-8s %10s %10s %10s %10s\n", "stage", "min, us", "p50, us", "p99, us", "max, us");
+  printLatency("parse", parseLatency);
+  printLatency("remap", remapLatency);
+  printLatency("show", showLatency);
+  printLatency("message", messageLatency);
+  printf("peak heap: %zu bytes over start, %u allocations\n", heapPeak - heapStart, heapAllocations - allocationsStart);
+  return 0;
+}
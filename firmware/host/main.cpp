@@ -0,0 +1,235 @@
+#include <Arduino.h>
+#include <FastLED.h>
+#include <Preferences.h>
+#include <ArduinoWebsockets.h>
+#include "HostClock.h"
+#include "JaamUtils.h"
+#include "JaamSettings.h"
+#include "JaamAlarms.h"
+#include "JaamPayloadParser.h"
+#include "JaamDeltaDecoder.h"
+#include "JaamMap.h"
+#include "JaamTraceBuffer.h"
+#include "HostMap.h"
+#include "HostCommands.h"
+#include <string>
+#include <vector>
+
+// Host driver of firmware modules, built with "pio run -e native". Commands:
+//   simulate <trace> [--set key=value]... [--time unix] [--tail ms]
+//     feeds recorded frames through parse -> remap -> render against a fake clock and prints every
+//     frame that differs from the previous one, so output of the same trace is always the same.
+// Trace is a file downloaded from the device trace page (JTR1) or a text file with one frame per
+// line: "<ms> <JSON payload>" or "<ms> hex:<binary delta frame>", lines starting with # are skipped.
+//   colors [frames]
+//     times table hue and fixed point brightness against the float color path and checks they match.
+//   benchmark [--frames N] [--baseline file] [--save-baseline file]
+//     times render stages on the synthetic worst case of the device benchmark, regressions of p99
+//     by more than 10% over baseline are flagged and make exit code 1.
+//   replay <trace> [--speed N] [--verbose]
+//     replays trace at recorded speed multiplied by N (0 - as fast as possible) and reports latency
+//     of messages and peak heap.
+
+static const char* TRACE_SIGNATURE = "JTR1";
+
+static const char* PAYLOAD_NAMES[] = {"unknown", "ping", "alerts", "weather", "explosions", "missiles", "drones", "bins", "test_bins"};
+
+const char* getPayloadName(JaamPayloadParser::Payload payload) {
+  return PAYLOAD_NAMES[payload];
+}
+
+static void printUsage() {
+  fprintf(stderr, "usage: program simulate <trace> [--set key=value]... [--time unix] [--tail ms]\n");
+  fprintf(stderr, "       program colors [frames]\n");
+  fprintf(stderr, "       program benchmark [--frames N] [--baseline file] [--save-baseline file]\n");
+  fprintf(stderr, "       program replay <trace> [--speed N] [--verbose]\n");
+}
+
+static bool readFile(const char* path, std::string* content) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "Can not open %s\n", path);
+    return false;
+  }
+  char buffer[4096];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) content->append(buffer, read);
+  fclose(file);
+  return true;
+}
+
+static int hexDigit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static bool addTextFrame(JaamTraceBuffer& trace, const std::string& line, int lineNumber) {
+  size_t space = line.find(' ');
+  char* timeEnd;
+  unsigned long time = strtoul(line.c_str(), &timeEnd, 10);
+  if (space == std::string::npos || timeEnd != line.c_str() + space) {
+    fprintf(stderr, "Line %d: expected \"<ms> <payload>\"\n", lineNumber);
+    return false;
+  }
+  std::string payload = line.substr(space + 1);
+  if (payload.compare(0, 4, "hex:") == 0) {
+    std::string frame;
+    for (size_t i = 4; i + 1 < payload.size(); i += 2) {
+      int high = hexDigit(payload[i]);
+      int low = hexDigit(payload[i + 1]);
+      if (high < 0 || low < 0) {
+        fprintf(stderr, "Line %d: bad hex frame\n", lineNumber);
+        return false;
+      }
+      frame += (char) (high << 4 | low);
+    }
+    payload = frame;
+  }
+  return trace.add(time, (const uint8_t*) payload.data(), payload.size());
+}
+
+// trace file is taken as is, text file is converted to trace records
+bool loadTrace(const char* path, JaamTraceBuffer& trace) {
+  std::string content;
+  if (!readFile(path, &content)) return false;
+  if (content.compare(0, 4, TRACE_SIGNATURE) == 0) {
+    if (!trace.writeFile(0, (const uint8_t*) content.data(), content.size())) {
+      fprintf(stderr, "Can not load trace %s\n", path);
+      return false;
+    }
+    trace.finishFile();
+    return true;
+  }
+  size_t start = 0;
+  int lineNumber = 0;
+  while (start < content.size()) {
+    size_t end = content.find('\n', start);
+    if (end == std::string::npos) end = content.size();
+    std::string line = content.substr(start, end - start);
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    start = end + 1;
+    lineNumber++;
+    if (line.empty() || line[0] == '#') continue;
+    if (!addTextFrame(trace, line, lineNumber)) return false;
+  }
+  return true;
+}
+
+static bool applySetting(const char* assignment) {
+  const char* equals = strchr(assignment, '=');
+  if (!equals) return false;
+  std::string key(assignment, equals - assignment);
+  // every value is kept as text in the Preferences stub, so one put works for int, float and string settings
+  Preferences preferences;
+  preferences.begin("storage");
+  preferences.putString(key.c_str(), equals + 1);
+  preferences.end();
+  return true;
+}
+
+static void printStrip(uint32_t time, HostMap& map) {
+  printf("%u", time);
+  const CRGB* strip = map.getStrip();
+  for (int led = 0; led < MAIN_LEDS_COUNT; led++) {
+    printf(" %02x%02x%02x", strip[led].r, strip[led].g, strip[led].b);
+  }
+  if (map.getConfig().bgStripEnabled) {
+    CRGB bg = map.getBgColor();
+    printf(" bg %02x%02x%02x", bg.r, bg.g, bg.b);
+  }
+  printf("\n");
+}
+
+static int simulate(int argc, char** argv) {
+  if (argc < 1) {
+    printUsage();
+    return 2;
+  }
+  const char* tracePath = argv[0];
+  long unixStart = 0;
+  uint32_t unixStartAt = 0; // trace time of unixStart
+  uint32_t tail = 1000;
+  JaamSettings settings;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--set") == 0 && i + 1 < argc && applySetting(argv[i + 1])) {
+      i++;
+    } else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+      unixStart = atol(argv[++i]);
+    } else if (strcmp(argv[i], "--tail") == 0 && i + 1 < argc) {
+      tail = strtoul(argv[++i], nullptr, 10);
+    } else {
+      printUsage();
+      return 2;
+    }
+  }
+  settings.init();
+
+  JaamTraceBuffer trace(1 << 24);
+  if (!trace.allocate() || !loadTrace(tracePath, trace)) return 1;
+  if (trace.getCount() == 0) {
+    fprintf(stderr, "Trace has no frames\n");
+    return 1;
+  }
+
+  HostMap map;
+  if (!map.init(settings)) return 1;
+  int64_t framePeriod = 1000000 / max(map.getConfig().frameRate, 1);
+  size_t offset = 0;
+  uint32_t frameTime;
+  const uint8_t* data;
+  size_t length;
+  trace.next(&offset, &frameTime, &data, &length);
+  uint32_t traceStart = frameTime;
+  unixStartAt = traceStart;
+  bool hasFrame = true;
+  uint32_t lastFrameTime = frameTime;
+  std::string shown;
+  setHostTime(0);
+  for (;;) {
+    uint32_t now = traceStart + getHostTime() / 1000;
+    while (hasFrame && frameTime <= now) {
+      uint32_t changedSlots;
+      JaamPayloadParser::Payload payload = map.ingest(data, length, &changedSlots);
+      printf("# %u %s %08x\n", frameTime, getPayloadName(payload), changedSlots);
+      // unix time is not in the trace, so it starts from the newest event of the first data
+      if (unixStart == 0) {
+        unixStart = map.getLatestEventTime();
+        unixStartAt = frameTime;
+      }
+      map.remap(payload, changedSlots);
+      lastFrameTime = frameTime;
+      hasFrame = trace.next(&offset, &frameTime, &data, &length);
+    }
+    if (!hasFrame && now > lastFrameTime + tail) break;
+    if (unixStart > 0) {
+      map.render(unixStart + (now - unixStartAt) / 1000, getHostTime());
+      std::string frame((const char*) map.getStrip(), sizeof(CRGB) * MAIN_LEDS_COUNT);
+      CRGB bg = map.getBgColor();
+      frame.append((const char*) &bg, sizeof(bg));
+      if (frame != shown) {
+        printStrip(now, map);
+        shown = frame;
+      }
+    }
+    advanceHostTime(framePeriod);
+  }
+
+  HostMap::Stats stats = map.getStats();
+  printf("# frames %u, skipped %u, resyncs %u, state hashes %u, rendered frames %u, rendered leds %u\n",
+    stats.frames, stats.skippedFrames, stats.resyncs, stats.stateHashes, stats.renderedFrames, stats.renderedLeds);
+  for (const std::string& message : map.getClient().getSentMessages()) {
+    printf("# sent %s\n", message.c_str());
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc >= 2 && strcmp(argv[1], "simulate") == 0) return simulate(argc - 2, argv + 2);
+  if (argc >= 2 && strcmp(argv[1], "colors") == 0) return runColorsBenchmark(argc - 2, argv + 2);
+  if (argc >= 2 && strcmp(argv[1], "benchmark") == 0) return runBenchmark(argc - 2, argv + 2);
+  if (argc >= 2 && strcmp(argv[1], "replay") == 0) return runReplay(argc - 2, argv + 2);
+  printUsage();
+  return 2;
+}
@@ -0,0 +1,60 @@
+#include "Arduino.h"
+#include "HostClock.h"
+
+HardwareSerial Serial;
+
+static int64_t hostTime = 0;
+static bool hostLogEnabled = false;
+static uint32_t randomState = 1;
+
+int64_t getHostTime() {
+  return hostTime;
+}
+
+void setHostTime(int64_t time) {
+  hostTime = time;
+}
+
+void advanceHostTime(int64_t duration) {
+  hostTime += duration;
+}
+
+void setHostLogEnabled(bool enabled) {
+  hostLogEnabled = enabled;
+}
+
+unsigned long millis() {
+  return hostTime / 1000;
+}
+
+unsigned long micros() {
+  return hostTime;
+}
+
+void delay(unsigned long ms) {
+  hostTime += (int64_t) ms * 1000;
+}
+
+// fixed seed, random effects are the same in every run
+long random(long max) {
+  randomState = randomState * 1103515245 + 12345;
+  return max > 0 ? (randomState >> 8) % max : 0;
+}
+
+long random(long min, long max) {
+  return min + random(max - min);
+}
+
+int64_t esp_timer_get_time() {
+  return hostTime;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (hostLogEnabled) fputc(c, stdout);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  if (hostLogEnabled) fwrite(buffer, 1, size, stdout);
+  return size;
+}
@@ -0,0 +1,42 @@
+#pragma once
+// Arduino core for the host build: only what hardware independent firmware modules use.
+// Time comes from a fake clock, which is moved forward by simulation drivers (see HostClock.h).
+#include <algorithm>
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Print.h"
+#include "WString.h"
+
+#define PROGMEM
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define pgm_read_byte(address) (*(const uint8_t*) (address))
+#define constrain(value, low, high) ((value) < (low) ? (low) : ((value) > (high) ? (high) : (value)))
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+// moves fake clock, never sleeps
+void delay(unsigned long ms);
+long random(long max);
+long random(long min, long max);
+
+// log output goes to stdout
+class HardwareSerial : public Print {
+
+public:
+    void begin(unsigned long) {}
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
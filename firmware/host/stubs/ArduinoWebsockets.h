@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "WString.h"
+
+// Websocket client of the host build: there is no server, frames are fed to firmware modules by
+// the driver and messages sent back are only collected, so driver can report them.
+namespace websockets {
+
+class WebsocketsClient {
+
+public:
+    bool send(const char* data) { sentMessages.push_back(data); return true; }
+    bool send(const String& data) { return send(data.c_str()); }
+    bool available() { return false; }
+    void close() {}
+    const std::vector<std::string>& getSentMessages() { return sentMessages; }
+
+private:
+    std::vector<std::string> sentMessages;
+};
+
+}
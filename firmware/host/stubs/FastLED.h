@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+
+// FastLED pixel type with the same scaling math, strips are kept in memory only
+struct CRGB {
+    enum HTMLColorCode {
+        Black = 0x000000
+    };
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    CRGB() : r(0), g(0), b(0) {}
+    CRGB(uint8_t r, uint8_t g, uint8_t b) : r(r), g(g), b(b) {}
+    CRGB(HTMLColorCode code) : r((code >> 16) & 0xFF), g((code >> 8) & 0xFF), b(code & 0xFF) {}
+    // same as FastLED nscale8x3_video: non zero channels stay non zero
+    CRGB& nscale8_video(uint8_t scale) {
+        uint8_t nonZeroScale = scale != 0 ? 1 : 0;
+        r = r == 0 ? 0 : ((r * scale) >> 8) + nonZeroScale;
+        g = g == 0 ? 0 : ((g * scale) >> 8) + nonZeroScale;
+        b = b == 0 ? 0 : ((b * scale) >> 8) + nonZeroScale;
+        return *this;
+    }
+    bool operator==(const CRGB& other) const { return r == other.r && g == other.g && b == other.b; }
+    bool operator!=(const CRGB& other) const { return !(*this == other); }
+};
+
+inline void fill_solid(CRGB* leds, int count, const CRGB& color) {
+    for (int i = 0; i < count; i++) leds[i] = color;
+}
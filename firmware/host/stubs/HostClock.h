@@ -0,0 +1,10 @@
+#pragma once
+#include <stdint.h>
+
+// Fake monotonic clock behind millis(), micros() and esp_timer_get_time() of the host build.
+// It starts at 0 and is moved only by the driver, so every run of the same input gives the same output.
+int64_t getHostTime(); // us
+void setHostTime(int64_t time);
+void advanceHostTime(int64_t duration);
+// log of firmware modules is dropped, so driver output is not mixed with it
+void setHostLogEnabled(bool enabled);
@@ -0,0 +1,31 @@
+#pragma once
+#include <map>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "WString.h"
+
+// NVS replacement: values live in memory of the process, all namespaces share one map
+class Preferences {
+
+public:
+    bool begin(const char* name, bool = false) { this->name = name; return true; }
+    void end() {}
+    bool isKey(const char* key) { return storage().count(path(key)) > 0; }
+    bool remove(const char* key) { return storage().erase(path(key)) > 0; }
+    int getInt(const char* key, int defaultValue = 0) { return isKey(key) ? atoi(storage()[path(key)].c_str()) : defaultValue; }
+    float getFloat(const char* key, float defaultValue = 0.0f) { return isKey(key) ? atof(storage()[path(key)].c_str()) : defaultValue; }
+    String getString(const char* key, const String& defaultValue = String()) { return isKey(key) ? String(storage()[path(key)]) : defaultValue; }
+    size_t putInt(const char* key, int value) { storage()[path(key)] = std::to_string(value); return sizeof(value); }
+    size_t putFloat(const char* key, float value) { storage()[path(key)] = std::to_string(value); return sizeof(value); }
+    size_t putString(const char* key, const char* value) { storage()[path(key)] = value; return strlen(value); }
+    size_t putString(const char* key, const String& value) { return putString(key, value.c_str()); }
+
+private:
+    std::string name;
+    std::string path(const char* key) { return name + "/" + key; }
+    static std::map<std::string, std::string>& storage() {
+        static std::map<std::string, std::string> values;
+        return values;
+    }
+};
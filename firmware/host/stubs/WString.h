@@ -0,0 +1,41 @@
+#pragma once
+#include <stdlib.h>
+#include <string>
+
+// Arduino String on top of std::string, only what firmware core and ArduinoJson adapters use
+class String {
+
+public:
+    String() {}
+    String(const char* value) : value(value ? value : "") {}
+    String(const std::string& value) : value(value) {}
+    String(int value) : value(std::to_string(value)) {}
+    String(unsigned int value) : value(std::to_string(value)) {}
+    String(long value) : value(std::to_string(value)) {}
+    String(unsigned long value) : value(std::to_string(value)) {}
+    const char* c_str() const { return value.c_str(); }
+    size_t length() const { return value.size(); }
+    bool isEmpty() const { return value.empty(); }
+    void reserve(size_t size) { value.reserve(size); }
+    bool concat(const char* text) { value += text; return true; }
+    bool concat(char c) { value += c; return true; }
+    String& operator+=(const String& other) { value += other.value; return *this; }
+    String& operator+=(const char* text) { value += text; return *this; }
+    String& operator+=(char c) { value += c; return *this; }
+    char operator[](size_t index) const { return value[index]; }
+    bool operator==(const String& other) const { return value == other.value; }
+    bool operator==(const char* text) const { return value == text; }
+    bool operator!=(const String& other) const { return value != other.value; }
+    bool operator!=(const char* text) const { return value != text; }
+    int toInt() const { return atoi(value.c_str()); }
+    float toFloat() const { return atof(value.c_str()); }
+
+private:
+    std::string value;
+};
+
+class StringSumHelper : public String {
+
+public:
+    StringSumHelper(const String& value) : String(value) {}
+};
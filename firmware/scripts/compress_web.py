@@ -0,0 +1,18 @@
+# PlatformIO pre script: gzips web app into data dir, which is packed into SPIFFS image by "pio run -t buildfs"
+import gzip
+import os
+
+Import("env")  # noqa: F821
+
+project_dir = env["PROJECT_DIR"]  # noqa: F821
+source = os.path.join(project_dir, "web", "index.html")
+target = os.path.join(project_dir, "data", "index.html.gz")
+
+os.makedirs(os.path.dirname(target), exist_ok=True)
+with open(source, "rb") as source_file:
+    content = source_file.read()
+# mtime is fixed, so the same page gives the same file and the same ETag on device
+with open(target, "wb") as target_file:
+    with gzip.GzipFile(filename="", mode="wb", fileobj=target_file, compresslevel=9, mtime=0) as gzip_file:
+        gzip_file.write(content)
+print(f"Web app compressed: {len(content)} -> {os.path.getsize(target)} bytes")
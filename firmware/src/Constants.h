@@ -316,6 +316,21 @@ static SettingListItem ALERT_NOTIFY_OPTIONS[ALERT_NOTIFY_OPTIONS_COUNT] = {
   {2, "Колір + зміна яскравості", false}
 };
 
+#define FRAME_RATE_OPTIONS_COUNT 3
+static SettingListItem FRAME_RATE_OPTIONS[FRAME_RATE_OPTIONS_COUNT] = {
+  {30, "30 кадрів/с", false},
+  {60, "60 кадрів/с", false},
+  {120, "120 кадрів/с", false}
+};
+
+#define REPLAY_SPEED_OPTIONS_COUNT 4
+static SettingListItem REPLAY_SPEED_OPTIONS[REPLAY_SPEED_OPTIONS_COUNT] = {
+  {1, "Як у записі", false},
+  {10, "x10", false},
+  {100, "x100", false},
+  {0, "Максимальна", false}
+};
+
 #define DISPLAY_MODEL_OPTIONS_COUNT 4
 static SettingListItem DISPLAY_MODEL_OPTIONS[DISPLAY_MODEL_OPTIONS_COUNT] = {
   {0, "Без дисплея", false},
@@ -338,4 +353,3 @@ static SettingListItem LEGACY_OPTIONS[LEGACY_OPTIONS_COUNT] = {
   {3, "Плата JAAM 2.x", false}
 };
 
-static const size_t MAX_JSON_SIZE = 6000; // 6KB
@@ -0,0 +1,143 @@
+#include "JaamAlarms.h"
+#include <math.h>
+#include <algorithm>
+
+// same values as CLEAR and ALERT in Constants.h, which can not be used without Arduino
+static const int STATE_CLEAR = 0;
+static const int STATE_ALERT = 1;
+
+static LedColor color(int hue, uint32_t brightness) {
+  LedColor result;
+  result.hue = hue;
+  result.brightness = brightness;
+  return result;
+}
+
+static float mapRange(float value, float istart, float istop, float ostart, float ostop) {
+  return ostart + (ostop - ostart) * ((value - istart) / (istop - istart));
+}
+
+LedColor getAlarmColor(const RenderConfig& config, const AlarmsFrame& frame, int state, long time, long expTime, long missilesTime, long dronesTime, bool isHomeDistrict, bool isBgStrip) {
+  long currentTime = frame.currentTime;
+  bool notify = config.notifyMode > 0;
+
+  // explosions has highest priority
+  if (config.enableExplosions && expTime > 0 && currentTime - expTime < config.explosionPeriod && notify) {
+    return color(config.colorExplosion, frame.notificationBrightness);
+  }
+
+  // missiles has second priority
+  if (config.enableMissiles && missilesTime > 0 && currentTime - missilesTime < config.explosionPeriod && notify) {
+    return color(config.colorMissiles, frame.notificationBrightness);
+  }
+
+  // drones has third priority
+  if (config.enableDrones && dronesTime > 0 && currentTime - dronesTime < config.explosionPeriod && notify) {
+    return color(config.colorDrones, frame.notificationBrightness);
+  }
+
+  switch (state) {
+    case STATE_ALERT:
+      if (currentTime - time < config.alertOnPeriod && notify) {
+        return color(config.colorNewAlert, frame.newAlertBrightness);
+      }
+      return color(config.colorAlert, isBgStrip ? config.bgBrightness : config.alertBrightness);
+    case STATE_CLEAR:
+      if (currentTime - time < config.alertOffPeriod && notify) {
+        return color(config.colorAlertOver, frame.alertOverBrightness);
+      }
+      if (isBgStrip && frame.neighborAlert) {
+        return color(config.colorBgNeighborAlert, config.bgBrightness);
+      }
+      if (isHomeDistrict) {
+        return color(config.colorHomeDistrict, isBgStrip ? config.bgBrightness : config.homeDistrictBrightness);
+      }
+      return color(config.colorClear, isBgStrip ? config.bgBrightness : config.clearBrightness);
+  }
+  return color(0, 0);
+}
+
+bool isInTransition(const RenderConfig& config, int state, long time, long expTime, long missilesTime, long dronesTime, long currentTime) {
+  if (config.notifyMode == 0) return false;
+  if (expTime > 0 && currentTime - expTime < config.explosionPeriod) return true;
+  if (missilesTime > 0 && currentTime - missilesTime < config.explosionPeriod) return true;
+  if (dronesTime > 0 && currentTime - dronesTime < config.explosionPeriod) return true;
+  long transitionPeriod = state == STATE_ALERT ? config.alertOnPeriod : config.alertOffPeriod;
+  return currentTime - time < transitionPeriod;
+}
+
+float getFadeInFadeOutBrightness(float maxBrightness, float minBlinkBrightness, long fadeTime, int64_t frameTime) {
+  float fixedMaxBrightness = (maxBrightness > 0.0f && maxBrightness < minBlinkBrightness) ? minBlinkBrightness : maxBrightness;
+  float minBrightness = fixedMaxBrightness * 0.01f;
+  int progress = frameTime % ((int64_t) fadeTime * 1000);
+  int halfBlinkTime = fadeTime * 500;
+  float blinkBrightness;
+  if (progress < halfBlinkTime) {
+    blinkBrightness = mapRange(progress, 0, halfBlinkTime, minBrightness, fixedMaxBrightness);
+  } else {
+    blinkBrightness = mapRange(progress, halfBlinkTime + 1, halfBlinkTime * 2, fixedMaxBrightness, minBrightness);
+  }
+  return blinkBrightness;
+}
+
+int processWeather(const RenderConfig& config, float temp) {
+  float minTemp = config.weatherMinTemp;
+  float maxTemp = config.weatherMaxTemp;
+  float normalizedValue = float(temp - minTemp) / float(maxTemp - minTemp);
+  if (normalizedValue > 1) {
+    normalizedValue = 1;
+  }
+  if (normalizedValue < 0) {
+    normalizedValue = 0;
+  }
+  int hue = round(275 + normalizedValue * (0 - 275));
+  hue %= 360;
+  return hue;
+}
+
+uint32_t toFixedBrightness(float brightness) {
+  if (brightness == 0.0f) return 0;
+  return std::max(lroundf(brightness * 100.0f), 1L);
+}
+
+AlarmsFrame getAlarmsFrame(const RenderConfig& config, long currentTime, bool neighborAlert, float minBlinkBrightness, int64_t frameTime) {
+  float blinkBrightness = config.currentBrightness / 100.0f;
+  float notificationBrightness = config.currentBrightness / 100.0f;
+  if (config.notifyMode == 2) {
+    blinkBrightness = getFadeInFadeOutBrightness(blinkBrightness, minBlinkBrightness, config.blinkTime, frameTime);
+    notificationBrightness = getFadeInFadeOutBrightness(notificationBrightness, minBlinkBrightness, config.blinkTime / 2, frameTime);
+  }
+  AlarmsFrame frame;
+  frame.currentTime = currentTime;
+  frame.neighborAlert = neighborAlert;
+  frame.newAlertBrightness = toFixedBrightness(blinkBrightness * config.brightnessNewAlert);
+  frame.alertOverBrightness = toFixedBrightness(blinkBrightness * config.brightnessAlertOver);
+  frame.notificationBrightness = toFixedBrightness(notificationBrightness * config.brightnessExplosion);
+  return frame;
+}
+
+bool isAlertInSlots(const uint8_t alertState[], uint32_t slots) {
+  for (; slots != 0; slots &= slots - 1) {
+    if (alertState[__builtin_ctz(slots)] != STATE_CLEAR) return true;
+  }
+  return false;
+}
+
+std::pair<int, long> alertsCombiModeHandler(std::pair<int, long> kyiv, std::pair<int, long> kyivObl) {
+  // if state of Kyiv and Kyiv Oblast are 'alert', return oldest by time
+  if (kyiv.first == STATE_ALERT && kyivObl.first == STATE_ALERT) return kyiv.second <= kyivObl.second ? kyiv : kyivObl;
+  // if states of Kyiv and Kyiv Oblast are 'clear', return nearest by time
+  if (kyiv.first == STATE_CLEAR && kyivObl.first == STATE_CLEAR) return kyiv.second >= kyivObl.second ? kyiv : kyivObl;
+  // if one of the states is 0, return another
+  return kyiv.first == STATE_CLEAR ? kyivObl : kyiv;
+}
+
+float weatherCombiModeHandler(float kyiv, float kyivObl) {
+  // return average value of Kyiv and Kyiv Oblast
+  return (kyiv + kyivObl) / 2.0f;
+}
+
+long expMisDroneCombiModeHandler(long kyiv, long kyivObl) {
+  // return nearest by time
+  return kyiv > kyivObl ? kyiv : kyivObl;
+}
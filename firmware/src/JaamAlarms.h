@@ -0,0 +1,224 @@
+#include <stdint.h>
+#include <utility>
+
+// Alarm map rendering rules. Nothing here touches hardware, settings storage or clocks:
+// current time is passed in by the caller, so the same code runs in firmware and off-device.
+// Region values are gathered to LEDs by remap functions and turned into colors by getAlarmColors().
+// snapshot of settings used by map rendering, rebuilt by firmware only when settings generation changes
+struct RenderConfig {
+    uint32_t generation;
+    int mapMode;
+    int alarmsAutoSwitch;
+    int homeDistrict;
+    int notifyMode;
+    bool enableExplosions;
+    bool enableMissiles;
+    bool enableDrones;
+    long explosionPeriod; // seconds
+    long alertOnPeriod; // seconds
+    long alertOffPeriod; // seconds
+    long blinkTime; // milliseconds
+    int frameRate; // frames per second
+    int currentBrightness;
+    bool bgStripEnabled;
+    int bgLedCount;
+    int colorAlert;
+    int colorClear;
+    int colorNewAlert;
+    int colorAlertOver;
+    int colorExplosion;
+    int colorMissiles;
+    int colorDrones;
+    int colorHomeDistrict;
+    int colorBgNeighborAlert;
+    int brightnessNewAlert;
+    int brightnessAlertOver;
+    int brightnessExplosion;
+    int brightnessBg;
+    // steady state brightness in 1/100 of percent, current brightness is already applied
+    uint32_t alertBrightness;
+    uint32_t clearBrightness;
+    uint32_t homeDistrictBrightness;
+    uint32_t bgBrightness;
+    uint32_t fullBrightness;
+    int weatherMinTemp;
+    int weatherMaxTemp;
+    int lampR;
+    int lampG;
+    int lampB;
+    int lampBrightness;
+};
+
+// values that change with time and are shared by all LEDs of one alarms frame
+struct AlarmsFrame {
+    long currentTime; // unix time in seconds
+    bool neighborAlert;
+    uint32_t newAlertBrightness;
+    uint32_t alertOverBrightness;
+    uint32_t notificationBrightness;
+};
+
+struct LedColor {
+    int hue;
+    uint32_t brightness; // in 1/100 of percent
+};
+
+LedColor getAlarmColor(const RenderConfig& config, const AlarmsFrame& frame, int state, long time, long expTime, long missilesTime, long dronesTime, bool isHomeDistrict, bool isBgStrip);
+// LED color depends on current time while it shows new alert, alert over or notification
+bool isInTransition(const RenderConfig& config, int state, long time, long expTime, long missilesTime, long dronesTime, long currentTime);
+// phase is taken from monotonic frame time in microseconds
+float getFadeInFadeOutBrightness(float maxBrightness, float minBlinkBrightness, long fadeTime, int64_t frameTime);
+int processWeather(const RenderConfig& config, float temp);
+// brightness in percents as float is rounded to 1/100 of percent, result may differ from float scaling by 1 step at most
+uint32_t toFixedBrightness(float brightness);
+// frame values for current time, phase of fading is taken from monotonic frame time in microseconds
+AlarmsFrame getAlarmsFrame(const RenderConfig& config, long currentTime, bool neighborAlert, float minBlinkBrightness, int64_t frameTime);
+// true if any slot of the mask is not clear
+bool isAlertInSlots(const uint8_t alertState[], uint32_t slots);
+
+/**
+* Structure-of-arrays storage for alarms state.
+* @tparam N Number of entries (region slots or LEDs)
+*/
+template <int N>
+struct AlarmsState {
+    uint8_t alertState[N] = {};
+    long    alertTime[N] = {};
+    float   temperature[N] = {};
+    long    explosionTime[N] = {};
+    long    missilesTime[N] = {};
+    long    dronesTime[N] = {};
+};
+
+// Region slot shown by every LED. In combined mode Kyiv LED shows Kyiv and Kyiv Oblast together.
+template <int LEDS>
+struct LedLayout {
+    int8_t ledSlots[LEDS]; // -1 if LED is not used
+    bool combiMode;
+    int kyivSlot;
+    int kyivOblSlot;
+};
+
+std::pair<int, long> alertsCombiModeHandler(std::pair<int, long> kyiv, std::pair<int, long> kyivObl);
+float weatherCombiModeHandler(float kyiv, float kyivObl);
+long expMisDroneCombiModeHandler(long kyiv, long kyivObl);
+
+/**
+* Gathers region values to LEDs.
+* @param regionValues Values by region slot
+* @param ledValues Values by LED position
+* @param combiModeHandler Function that combines Kyiv and Kyiv Oblast values for the Kyiv LED in combined mode
+* @param changedSlots Bit mask of changed region slots, unused LEDs are reset only if it is equal to allSlots
+* @return Bit mask of LEDs whose value was changed
+*/
+template <int LEDS, typename V>
+uint32_t remapValues(const LedLayout<LEDS>& layout, const V regionValues[], V ledValues[], V (*combiModeHandler)(V kyiv, V kyivObl), uint32_t changedSlots, uint32_t allSlots) {
+    bool combiMode = layout.combiMode && combiModeHandler;
+    if (combiMode && (changedSlots >> layout.kyivOblSlot) & 1) {
+        changedSlots |= 1UL << layout.kyivSlot;
+    }
+    bool fullRemap = changedSlots == allSlots;
+    uint32_t changedLeds = 0;
+    for (int led = 0; led < LEDS; led++) {
+        int slot = layout.ledSlots[led];
+        V value;
+        if (slot < 0) {
+            // unused LEDs are reset on full remap only
+            if (!fullRemap) continue;
+            value = V();
+        } else {
+            if (!((changedSlots >> slot) & 1)) continue;
+            value = regionValues[slot];
+            if (combiMode && slot == layout.kyivSlot) {
+                value = combiModeHandler(value, regionValues[layout.kyivOblSlot]);
+            }
+        }
+        if (ledValues[led] != value) {
+            ledValues[led] = value;
+            changedLeds |= 1UL << led;
+        }
+    }
+    return changedLeds;
+}
+
+// alert state and time are combined together, so they are gathered as a pair
+template <int LEDS, int SLOTS>
+uint32_t remapAlerts(const LedLayout<LEDS>& layout, const AlarmsState<SLOTS>& regions, AlarmsState<LEDS>& leds, uint32_t changedSlots) {
+    if (layout.combiMode && (changedSlots >> layout.kyivOblSlot) & 1) {
+        changedSlots |= 1UL << layout.kyivSlot;
+    }
+    bool fullRemap = changedSlots == (1UL << SLOTS) - 1;
+    uint32_t changedLeds = 0;
+    for (int led = 0; led < LEDS; led++) {
+        int slot = layout.ledSlots[led];
+        std::pair<int, long> alert;
+        if (slot < 0) {
+            // unused LEDs are reset on full remap only
+            if (!fullRemap) continue;
+            alert = std::make_pair(0, 0L);
+        } else {
+            if (!((changedSlots >> slot) & 1)) continue;
+            alert = std::make_pair(regions.alertState[slot], regions.alertTime[slot]);
+            if (layout.combiMode && slot == layout.kyivSlot) {
+                alert = alertsCombiModeHandler(alert, std::make_pair(regions.alertState[layout.kyivOblSlot], regions.alertTime[layout.kyivOblSlot]));
+            }
+        }
+        if (leds.alertState[led] != alert.first || leds.alertTime[led] != alert.second) {
+            leds.alertState[led] = alert.first;
+            leds.alertTime[led] = alert.second;
+            changedLeds |= 1UL << led;
+        }
+    }
+    return changedLeds;
+}
+
+template <int LEDS, int SLOTS>
+uint32_t remapWeather(const LedLayout<LEDS>& layout, const AlarmsState<SLOTS>& regions, AlarmsState<LEDS>& leds, uint32_t changedSlots) {
+    return remapValues(layout, regions.temperature, leds.temperature, weatherCombiModeHandler, changedSlots, (1UL << SLOTS) - 1);
+}
+
+template <int LEDS, int SLOTS>
+uint32_t remapExplosions(const LedLayout<LEDS>& layout, const AlarmsState<SLOTS>& regions, AlarmsState<LEDS>& leds, uint32_t changedSlots) {
+    return remapValues(layout, regions.explosionTime, leds.explosionTime, expMisDroneCombiModeHandler, changedSlots, (1UL << SLOTS) - 1);
+}
+
+template <int LEDS, int SLOTS>
+uint32_t remapMissiles(const LedLayout<LEDS>& layout, const AlarmsState<SLOTS>& regions, AlarmsState<LEDS>& leds, uint32_t changedSlots) {
+    return remapValues(layout, regions.missilesTime, leds.missilesTime, expMisDroneCombiModeHandler, changedSlots, (1UL << SLOTS) - 1);
+}
+
+template <int LEDS, int SLOTS>
+uint32_t remapDrones(const LedLayout<LEDS>& layout, const AlarmsState<SLOTS>& regions, AlarmsState<LEDS>& leds, uint32_t changedSlots) {
+    return remapValues(layout, regions.dronesTime, leds.dronesTime, expMisDroneCombiModeHandler, changedSlots, (1UL << SLOTS) - 1);
+}
+
+// bit mask of LEDs that show the region slot, in combined mode Kyiv Oblast is shown on the Kyiv LED
+template <int LEDS>
+uint32_t getSlotLeds(const LedLayout<LEDS>& layout, int slot) {
+    if (slot < 0) return 0;
+    int combinedSlot = layout.combiMode && slot == layout.kyivOblSlot ? layout.kyivSlot : slot;
+    uint32_t leds = 0;
+    for (int led = 0; led < LEDS; led++) {
+        if (layout.ledSlots[led] == slot || layout.ledSlots[led] == combinedSlot) leds |= 1UL << led;
+    }
+    return leds;
+}
+
+/**
+* Computes colors of main strip LEDs.
+* @param homeDistrictLeds Bit mask of LEDs that show home district
+* @param ledsToRender Bit mask of LEDs to compute, colors of other LEDs are not written
+* @return Bit mask of computed LEDs in transition (see isInTransition)
+*/
+template <int LEDS>
+uint32_t getAlarmColors(const RenderConfig& config, const AlarmsFrame& frame, const AlarmsState<LEDS>& leds, uint32_t homeDistrictLeds, uint32_t ledsToRender, LedColor colors[]) {
+    uint32_t transitionLeds = 0;
+    for (int led = 0; led < LEDS; led++) {
+        if (!((ledsToRender >> led) & 1)) continue;
+        colors[led] = getAlarmColor(config, frame, leds.alertState[led], leds.alertTime[led], leds.explosionTime[led], leds.missilesTime[led], leds.dronesTime[led], (homeDistrictLeds >> led) & 1, false);
+        if (isInTransition(config, leds.alertState[led], leds.alertTime[led], leds.explosionTime[led], leds.missilesTime[led], leds.dronesTime[led], frame.currentTime)) {
+            transitionLeds |= 1UL << led;
+        }
+    }
+    return transitionLeds;
+}
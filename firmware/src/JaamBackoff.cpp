@@ -0,0 +1,39 @@
+#include "JaamBackoff.h"
+
+JaamBackoff::JaamBackoff(uint32_t minDelay, uint32_t maxDelay) {
+  this->minDelay = minDelay;
+  this->maxDelay = maxDelay;
+  attempts = 0;
+  state = 2463534242UL;
+}
+
+void JaamBackoff::seed(uint32_t seed) {
+  // xorshift state should never be zero
+  state = seed ? seed : 2463534242UL;
+}
+
+uint32_t JaamBackoff::nextDelay() {
+  uint32_t step = minDelay;
+  for (uint32_t i = 0; i < attempts && step < maxDelay; i++) {
+    step *= 2;
+  }
+  if (step > maxDelay) step = maxDelay;
+  attempts++;
+  uint32_t half = step / 2;
+  return half + random() % (step - half + 1);
+}
+
+void JaamBackoff::reset() {
+  attempts = 0;
+}
+
+uint32_t JaamBackoff::getAttempts() {
+  return attempts;
+}
+
+uint32_t JaamBackoff::random() {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
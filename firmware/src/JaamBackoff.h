@@ -0,0 +1,22 @@
+#include <stdint.h>
+
+// Capped exponential backoff with random jitter. Every delay is picked between a half and a full
+// exponential step, so devices that lost connection at the same moment spread their retries.
+class JaamBackoff {
+
+public:
+    JaamBackoff(uint32_t minDelay, uint32_t maxDelay);
+    // different seed on every device gives different retry moments
+    void seed(uint32_t seed);
+    // returns delay before the next attempt in ms and counts the attempt
+    uint32_t nextDelay();
+    void reset();
+    uint32_t getAttempts();
+
+private:
+    uint32_t minDelay;
+    uint32_t maxDelay;
+    uint32_t attempts;
+    uint32_t state;
+    uint32_t random();
+};
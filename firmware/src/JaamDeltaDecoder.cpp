@@ -0,0 +1,162 @@
+#include "JaamDeltaDecoder.h"
+
+#define DELTA_PROTOCOL_VERSION 1
+#define DELTA_HEADER_SIZE 8
+#define DELTA_FLAG_SNAPSHOT 0x01
+#define DELTA_FLAG_SENT_TIME 0x02
+#define DELTA_SENT_TIME_SIZE 8
+#define FNV_OFFSET_BASIS 2166136261UL
+#define FNV_PRIME 16777619UL
+
+static uint32_t readUint32(const uint8_t* pos) {
+  return (uint32_t) pos[0] | ((uint32_t) pos[1] << 8) | ((uint32_t) pos[2] << 16) | ((uint32_t) pos[3] << 24);
+}
+
+static int16_t readInt16(const uint8_t* pos) {
+  return (int16_t) ((uint16_t) pos[0] | ((uint16_t) pos[1] << 8));
+}
+
+static uint32_t hashByte(uint32_t hash, uint8_t value) {
+  return (hash ^ value) * FNV_PRIME;
+}
+
+static uint32_t hashUint32(uint32_t hash, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    hash = hashByte(hash, (value >> (i * 8)) & 0xFF);
+  }
+  return hash;
+}
+
+JaamDeltaDecoder::JaamDeltaDecoder(const uint8_t* data, size_t length) {
+  this->data = data;
+  this->length = length;
+  // JSON frames start with '{', so they never pass version check
+  valid = length >= DELTA_HEADER_SIZE && data[0] == DELTA_PROTOCOL_VERSION && getRecordSize(getType()) > 0
+    && length == getHeaderSize() + (size_t) data[7] * getRecordSize(getType());
+}
+
+size_t JaamDeltaDecoder::getHeaderSize() {
+  return DELTA_HEADER_SIZE + (data[2] & DELTA_FLAG_SENT_TIME ? DELTA_SENT_TIME_SIZE : 0);
+}
+
+bool JaamDeltaDecoder::isValid() {
+  return valid;
+}
+
+JaamDeltaDecoder::Type JaamDeltaDecoder::getType() {
+  if (length < DELTA_HEADER_SIZE || data[1] >= TYPES_COUNT) return UNKNOWN;
+  return (Type) data[1];
+}
+
+bool JaamDeltaDecoder::isSnapshot() {
+  return valid && (data[2] & DELTA_FLAG_SNAPSHOT);
+}
+
+uint32_t JaamDeltaDecoder::getSequence() {
+  return valid ? readUint32(data + 3) : 0;
+}
+
+int JaamDeltaDecoder::getCount() {
+  return valid ? data[7] : 0;
+}
+
+uint64_t JaamDeltaDecoder::getSentTime() {
+  if (!valid || !(data[2] & DELTA_FLAG_SENT_TIME)) return 0;
+  return readUint32(data + DELTA_HEADER_SIZE) | ((uint64_t) readUint32(data + DELTA_HEADER_SIZE + 4) << 32);
+}
+
+int JaamDeltaDecoder::getRecordSize(Type type) {
+  switch (type) {
+    case ALERTS:
+      return 6;
+    case EXPLOSIONS:
+    case MISSILES:
+    case DRONES:
+      return 5;
+    case WEATHER:
+      return 3;
+    default:
+      return 0;
+  }
+}
+
+const uint8_t* JaamDeltaDecoder::getRecord(int index) {
+  return data + getHeaderSize() + index * getRecordSize(getType());
+}
+
+uint32_t JaamDeltaDecoder::applyAlerts(uint8_t states[], long times[], int size) {
+  if (!valid || getType() != ALERTS) return 0;
+  uint32_t changed = 0;
+  for (int i = 0; i < getCount(); i++) {
+    const uint8_t* record = getRecord(i);
+    int slot = record[0];
+    if (slot >= size) continue;
+    uint8_t state = record[1];
+    long time = (long) readUint32(record + 2);
+    if (states[slot] != state || times[slot] != time) changed |= 1UL << slot;
+    states[slot] = state;
+    times[slot] = time;
+  }
+  return changed;
+}
+
+uint32_t JaamDeltaDecoder::applyTimes(long times[], int size) {
+  Type type = getType();
+  if (!valid || (type != EXPLOSIONS && type != MISSILES && type != DRONES)) return 0;
+  uint32_t changed = 0;
+  for (int i = 0; i < getCount(); i++) {
+    const uint8_t* record = getRecord(i);
+    int slot = record[0];
+    if (slot >= size) continue;
+    long time = (long) readUint32(record + 1);
+    if (times[slot] != time) changed |= 1UL << slot;
+    times[slot] = time;
+  }
+  return changed;
+}
+
+uint32_t JaamDeltaDecoder::applyTemperatures(float temperatures[], int size) {
+  if (!valid || getType() != WEATHER) return 0;
+  uint32_t changed = 0;
+  for (int i = 0; i < getCount(); i++) {
+    const uint8_t* record = getRecord(i);
+    int slot = record[0];
+    if (slot >= size) continue;
+    float temperature = readInt16(record + 1) / 10.0f;
+    if (temperatures[slot] != temperature) changed |= 1UL << slot;
+    temperatures[slot] = temperature;
+  }
+  return changed;
+}
+
+uint32_t JaamDeltaDecoder::hashAlerts(const uint8_t states[], const long times[], int size) {
+  uint32_t hash = FNV_OFFSET_BASIS;
+  for (int slot = 0; slot < size; slot++) {
+    hash = hashByte(hash, slot);
+    hash = hashByte(hash, states[slot]);
+    hash = hashUint32(hash, (uint32_t) times[slot]);
+  }
+  return hash;
+}
+
+uint32_t JaamDeltaDecoder::hashTimes(const long times[], int size) {
+  uint32_t hash = FNV_OFFSET_BASIS;
+  for (int slot = 0; slot < size; slot++) {
+    hash = hashByte(hash, slot);
+    hash = hashUint32(hash, (uint32_t) times[slot]);
+  }
+  return hash;
+}
+
+uint32_t JaamDeltaDecoder::hashTemperatures(const float temperatures[], int size) {
+  uint32_t hash = FNV_OFFSET_BASIS;
+  for (int slot = 0; slot < size; slot++) {
+    // temperature came from 1/10 degree record, rounding restores exact record value
+    float scaled = temperatures[slot] * 10.0f;
+    uint16_t value = (uint16_t) (int16_t) (scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+    hash = hashByte(hash, slot);
+    hash = hashByte(hash, value & 0xFF);
+    hash = hashByte(hash, value >> 8);
+  }
+  return hash;
+}
@@ -0,0 +1,51 @@
+#include <stddef.h>
+#include <stdint.h>
+
+// Allocation-free decoder of binary delta frames (data protocol 4, see websocket_server.py).
+// Frame layout, little endian:
+//   [0] version, [1] type, [2] flags, [3..6] sequence number, [7] records count,
+//   [8..15] server send time in unix ms (only with sent time flag, data protocol 5), records...
+// Records are 6 bytes for alerts (slot, state, unix time), 5 bytes for explosions, missiles and
+// drones (slot, unix time) and 3 bytes for weather (slot, temperature in 1/10 °C).
+// Flags: bit 0 - snapshot, bit 1 - frame has server send time.
+// Delta frames carry only changed slots, snapshot frames carry all slots.
+// Sequence numbers grow by one per frame of the same type, so a gap means a lost frame.
+class JaamDeltaDecoder {
+
+public:
+    enum Type {
+        UNKNOWN,
+        ALERTS,
+        EXPLOSIONS,
+        MISSILES,
+        DRONES,
+        WEATHER,
+        TYPES_COUNT
+    };
+    JaamDeltaDecoder(const uint8_t* data, size_t length);
+    // false for JSON and malformed frames
+    bool isValid();
+    Type getType();
+    bool isSnapshot();
+    uint32_t getSequence();
+    int getCount();
+    // server send time in unix ms, 0 if frame has no sent time
+    uint64_t getSentTime();
+    // Each apply method writes records into caller arrays and returns mask of slots whose value was changed.
+    // Records with slot out of size are skipped.
+    uint32_t applyAlerts(uint8_t states[], long times[], int size);
+    uint32_t applyTimes(long times[], int size);
+    uint32_t applyTemperatures(float temperatures[], int size);
+    // FNV-1a of slots 0..size-1 encoded as snapshot records, same as server computes for sent values
+    static uint32_t hashAlerts(const uint8_t states[], const long times[], int size);
+    static uint32_t hashTimes(const long times[], int size);
+    static uint32_t hashTemperatures(const float temperatures[], int size);
+
+private:
+    const uint8_t* data;
+    size_t length;
+    bool valid;
+    size_t getHeaderSize();
+    const uint8_t* getRecord(int index);
+    static int getRecordSize(Type type);
+};
@@ -2,9 +2,10 @@
 #include "JaamUtils.h"
 #include <WiFiManager.h>
 #include <ESPAsyncWebServer.h>
+#include <AsyncJson.h>
 #include <StreamString.h>
 #include <ESPmDNS.h>
-#include <async.h>
+#include <SPIFFS.h>
 #include <ArduinoJson.h>
 #include <NTPtime.h>
 #if ARDUINO_OTA_ENABLED
@@ -23,11 +24,27 @@
 #include "JaamClimateSensor.h"
 #include "JaamButton.h"
 #include "JaamSettings.h"
+#include "JaamPayloadParser.h"
+#include "JaamAlarms.h"
+#include "JaamProfiler.h"
+#include "JaamSpscQueue.h"
+#include "JaamFrameQueue.h"
+#include "JaamScheduler.h"
+#include "JaamFrameClock.h"
+#include "JaamBackoff.h"
+#include "JaamDeltaDecoder.h"
+#include "JaamMap.h"
+#include "JaamStateStore.h"
+#include "JaamTraceBuffer.h"
+#include "JaamLatencyStats.h"
+#include "JaamPageWriter.h"
+#include "JaamJsonItemReader.h"
 #if BUZZER_ENABLED
 #include <melody_player.h>
 #include <melody_factory.h>
 #endif
 #include <esp_task_wdt.h>
+#include <mutex>
 
 const PROGMEM char* VERSION = "4.3-b100";
 
@@ -42,11 +59,44 @@ using namespace websockets;
 
 WiFiManager       wm;
 WiFiClient        client;
-WebsocketsClient  client_websocket;
+
+#define WS_CONNECT_TIMEOUT 3000 // ms
+#define WS_RECONNECT_MIN_DELAY 2000 // ms
+#define WS_RECONNECT_MAX_DELAY 60000 // ms
+#define WS_DNS_CACHE_TIME 600000 // ms, server address is resolved again after this time
+#define WS_DNS_MAX_FAILURES 3 // connection failures after which cached address is dropped
+#define WS_PROTOCOL_VERSION 5 // binary delta frames with server send time are accepted, see JaamDeltaDecoder.h
+
+// TCP client for websocket that connects to cached server address with bounded timeout.
+// Handshake still uses host name, so Host header is not changed.
+class CachedDnsTcpClient : public WSDefaultTcpClient {
+public:
+  void setServerIp(IPAddress ip) {
+    serverIp = ip;
+    serverIpValid = true;
+  }
+  void clearServerIp() {
+    serverIpValid = false;
+  }
+  bool hasServerIp() {
+    return serverIpValid;
+  }
+  bool connect(const WSString& host, const int port) override {
+    bool connected = serverIpValid ? client.connect(serverIp, port, WS_CONNECT_TIMEOUT) : client.connect(host.c_str(), port, WS_CONNECT_TIMEOUT);
+    client.setNoDelay(true);
+    return connected;
+  }
+private:
+  IPAddress serverIp;
+  bool serverIpValid = false;
+};
+
+std::shared_ptr<CachedDnsTcpClient> websocketTcpClient = std::make_shared<CachedDnsTcpClient>();
+WebsocketsClient  client_websocket(websocketTcpClient);
 AsyncWebServer    webserver(80);
 NTPtime           timeClient(2);
 DSTime            dst(3, 0, 7, 3, 10, 0, 7, 4); //https://en.wikipedia.org/wiki/Eastern_European_Summer_Time
-Async             asyncEngine = Async(20);
+JaamScheduler     scheduler(micros);
 JaamDisplay       display;
 JaamLightSensor   lightSensor;
 JaamClimateSensor climate;
@@ -85,30 +135,214 @@ struct ServiceMessage {
 
 ServiceMessage serviceMessage;
 
+// config is rebuilt into the spare buffer and published by index, so a frame that is being drawn
+// keeps reading a consistent config while settings are changed from other tasks
+RenderConfig renderConfigs[2];
+std::atomic<int> renderConfigIndex(-1);
+std::mutex renderConfigMutex;
+
 CRGB strip[MAIN_LEDS_COUNT];
 CRGB bg_strip[100];
 CRGB service_strip[5];
 int service_strip_update_index = 0;
 
-std::map<int, std::pair<int, long>> id_to_alerts; //regionId to alert state and time
-std::map<int, std::pair<int, long>> led_to_alerts; // ledPosition to alert state and time
-std::map<int, float>                id_to_weather; //regionId to temperature
-std::map<int, float>                led_to_weather; // ledPosition to temperature
-std::map<int, long>                 id_to_explosions; //regionId to explosion time
-std::map<int, long>                 led_to_explosions; // ledPosition to explosion time
-std::map<int, long>                 id_to_missiles; //regionId to missiles time
-std::map<int, long>                 led_to_missiles; // ledPosition to missils time
-std::map<int, long>                 id_to_drones; //regionId to missiles time
-std::map<int, long>                 led_to_drones; // ledPosition to missils time
-std::map<int, int>                  led_to_flag_color; // ledPosition to flag color
-std::pair<int, int*>                homeDistrictMapping; // id to ledPosition home district mapping
+AlarmsState<REGION_SLOTS_COUNT>     regionsState; // region slot to alarms state, updated by network task
+AlarmsState<REGION_SLOTS_COUNT>     renderRegionsState; // copy of regionsState owned by render task
+AlarmsState<MAIN_LEDS_COUNT>        ledsState; // ledPosition to alarms state
+int                                 ledFlagColor[MAIN_LEDS_COUNT]; // ledPosition to flag color
+LedLayout<MAIN_LEDS_COUNT>          ledLayout; // ledPosition to region slot
+HomeDistrict                        homeDistrict = {0, -1, 0}; // home district ledPositions and neighboring region slots
+uint32_t                            dirtyLeds = ALL_LEDS; // bit mask of ledPositions changed since last render
+uint32_t                            animatedLeds = 0; // bit mask of ledPositions in time based transition (new alert, alert over, notifications)
+bool                                bgStripDirty = true; // home district neighbors changed since last render
+
+static_assert(MAIN_LEDS_COUNT < 32 && REGION_SLOTS_COUNT < 32, "LEDs and region slots should fit into 32 bit masks");
+
+// Tasks:
+// - render task (core 1) owns LED strips, ledsState and renderRegionsState, draws frames on frameClock ticks (FRAME_RATE
+//   setting) and skips frames when nothing is changed or animated
+// - network task (core 0) runs WiFi manager, OTA, MQTT and websocket, websocket callback only queues received
+//   frames into frameQueue, they are parsed into regionsState after the socket is drained
+// - Arduino loop task (core 1, low priority) is used for housekeeping: scheduler jobs, buttons and side effects
+//   of applied data (sounds, display messages, alert pins), requested with regionsDataApplied flag
+// Parsed data goes from network to render task through regionsUpdates queue, other tasks
+// only ask render task to redraw with mapRedrawRequested flag.
+#define RENDER_TASK_CORE 1
+#define RENDER_TASK_PRIORITY 3
+#define RENDER_TASK_STACK_SIZE 4096
+#define MAP_CYCLE_TIME 1000 // ms, map is redrawn with this period if there are no changes
+#define NETWORK_TASK_CORE 0
+#define NETWORK_TASK_PRIORITY 2
+#define NETWORK_TASK_STACK_SIZE 8192
+#define NETWORK_TASK_DELAY 5 // ms
+
+// last applied data, restored on boot and shown until fresh data arrives, see JaamStateStore.h
+#define WARM_START_VERSION 1 // change when WarmStartState layout is changed
+#define WARM_START_FLASH_INTERVAL 900000 // ms, flash copy is written not more often than this
+#define WARM_START_MAX_AGE 3600 // s, older restored state is dropped once time is synced
+
+struct WarmStartState {
+  uint32_t savedAt; // unix time
+  uint32_t alertTime[REGION_SLOTS_COUNT];
+  uint32_t explosionTime[REGION_SLOTS_COUNT];
+  uint32_t missilesTime[REGION_SLOTS_COUNT];
+  uint32_t dronesTime[REGION_SLOTS_COUNT];
+  int16_t  temperature[REGION_SLOTS_COUNT]; // 1/10 °C
+  uint8_t  alertState[REGION_SLOTS_COUNT];
+};
+
+static_assert(sizeof(WarmStartState) <= STATE_STORE_MAX_SIZE, "Warm start state should fit into state store");
+
+struct RegionsUpdate {
+  JaamPayloadParser::Payload payload;
+  uint32_t changedSlots;
+  // for alert latency stats, receivedAt is 0 for replayed data and data republished after full queue
+  int64_t receivedAt; // us
+  int64_t parsedAt; // us
+  int32_t networkLatency; // us, -1 if server send time is unknown
+  uint8_t alertState[REGION_SLOTS_COUNT];
+  union {
+    long times[REGION_SLOTS_COUNT];
+    float temperature[REGION_SLOTS_COUNT];
+  };
+};
+
+TaskHandle_t                        mainLoopTaskHandle = NULL; // task that runs setup() and the scheduler
+TaskHandle_t                        renderTaskHandle = NULL;
+TaskHandle_t                        networkTaskHandle = NULL;
+#define REGIONS_UPDATES_SIZE 8
+JaamSpscQueue<RegionsUpdate, REGIONS_UPDATES_SIZE>     regionsUpdates; // network task -> render task
+uint32_t                            unpublishedSlots[JaamPayloadParser::TEST_BINS + 1]; // changed slots by payload type that did not fit into regionsUpdates
+std::atomic<bool>                   mapRedrawRequested(false);
+std::atomic<bool>                   homeDistrictChanged(false);
+std::atomic<bool>                   ledMappingChanged(false);
+std::atomic<bool>                   renderPauseRequested(false);
+std::atomic<bool>                   renderPaused(false);
+std::atomic<bool>                   regionsDataApplied(false); // network task -> loop task
+
+// last rendered state, used to skip recomputation and FastLED.show() when nothing changed
+int       renderedMapMode = -1;
+uint32_t  renderedSettingsGeneration = 0;
+bool      stripsShown = false;
+CRGB      shownStrip[MAIN_LEDS_COUNT];
+CRGB      shownBgStrip[100];
+CRGB      shownServiceStrip[5];
+
+JaamProfiler  profiler; // render loop stages timing during normal work
+JaamProfiler  benchmarkProfiler; // results of the last synthetic benchmark
+// Every task records stages through its own pointer, so a swapped profiler gets samples of a stage from one task
+// only: loop task swaps its pointer for benchmark, network task swaps its own and render task pointers for replay.
+// Other tasks (web server, mqtt) do not record.
+std::atomic<JaamProfiler*> loopTaskProfiler(&profiler);
+std::atomic<JaamProfiler*> renderTaskProfiler(&profiler);
+std::atomic<JaamProfiler*> networkTaskProfiler(&profiler);
+JaamFrameClock frameClock; // owned by render task
+bool          benchmarkRequested = false;
+
+// Alert latency from server send time to shown frame. Network task stamps received frames, render task
+// stamps remapped and shown ones and adds all stages to latencyStats.
+#define LATENCY_REPORT_INTERVAL 300000 // ms, stats are sent to server with this period
+struct PendingLatency {
+  int64_t receivedAt; // us
+  int64_t parsedAt; // us
+  int64_t remappedAt; // us
+  int32_t networkLatency; // us, -1 if unknown
+};
+JaamLatencyStats  latencyStats; // written by render task
+PendingLatency    pendingLatencies[REGIONS_UPDATES_SIZE]; // remapped alerts not shown yet, owned by render task
+int               pendingLatenciesCount = 0;
+int64_t           frameReceivedAt = 0; // us, receive time of frame being ingested by network task
+int32_t           frameNetworkLatency = -1; // us
+unix_t            unixClockSecond = 0; // last seen second of NTP time, see updateUnixClock()
+unsigned long     unixClockSecondStart = 0; // millis() when it started
+unsigned long     latencyReportTime = 0;
+
+// Received frames wait here until the apply stage, a full state frame (JSON data or binary snapshot) supersedes
+// queued older frames of the same payload type, so a burst of alerts is applied once.
+#define FRAME_QUEUE_FRAMES 16
+#define FRAME_QUEUE_SIZE 8192 // bytes
+struct FrameMeta {
+  int64_t receivedAt; // us
+  int32_t networkLatency; // us, -1 if server send time is unknown
+};
+typedef JaamFrameQueue<FrameMeta, FRAME_QUEUE_FRAMES, FRAME_QUEUE_SIZE> FrameQueue;
+FrameQueue        frameQueue; // websocket callback -> apply stage, both are run by network task
+uint32_t          frameQueueOverflows = 0; // frames that did not fit and were applied right in the callback
+
+#define BENCHMARK_FRAMES PROFILER_SAMPLES_COUNT
+#define BENCHMARK_REGRESSION_PERCENT 10
+
+// profiler of the calling task, NULL if the task does not record stages
+JaamProfiler* getTaskProfiler() {
+  TaskHandle_t task = xTaskGetCurrentTaskHandle();
+  if (task == mainLoopTaskHandle) return loopTaskProfiler;
+  if (task == renderTaskHandle) return renderTaskProfiler;
+  if (task == networkTaskHandle) return networkTaskProfiler;
+  return NULL;
+}
 
+void addStageSample(JaamProfiler::Stage stage, uint32_t cycles) {
+  JaamProfiler* taskProfiler = getTaskProfiler();
+  if (taskProfiler) taskProfiler->add(stage, cycles);
+}
 
-std::pair<int, int*> (*ledMapping)(int key);
+// measures time from creation to the end of the scope
+struct StageTimer {
+  JaamProfiler::Stage stage;
+  uint32_t start;
+  StageTimer(JaamProfiler::Stage stage) : stage(stage), start(ESP.getCycleCount()) {}
+  ~StageTimer() { addStageSample(stage, ESP.getCycleCount() - start); }
+};
 
 bool      isFirstDataFetchCompleted = false;
 
+JaamStateStore          stateStore("state", WARM_START_VERSION, WARM_START_FLASH_INTERVAL); // written by network task
+JaamStateStore::Source  warmStartSource = JaamStateStore::NONE;
+long                    warmStartTime = 0; // unix time when restored state was saved
+bool                    provisionalState = false; // restored state is shown, fresh data did not arrive yet
+
+// Trace of websocket frames for ingest debugging: captured frames can be downloaded, uploaded back and replayed
+// through the same parse -> remap -> render path. Buffer is changed by network task only, web server sends
+// commands through traceCommand and accesses buffer itself only while trace is idle.
+#define TRACE_BUFFER_SIZE 32768 // bytes, allocated on first capture or upload
+#define TRACE_REPLAY_BATCH 8 // max frames replayed per network loop iteration
+enum TraceMode {
+  TRACE_IDLE,
+  TRACE_CAPTURE,
+  TRACE_REPLAY
+};
+static const char* TRACE_MODE_NAMES[] = {
+  "Зупинено",
+  "Запис",
+  "Відтворення"
+};
+enum TraceCommand {
+  TRACE_NONE,
+  TRACE_START_CAPTURE,
+  TRACE_START_REPLAY,
+  TRACE_STOP
+};
+struct ReplayStats {
+  uint32_t frames;
+  uint32_t duration; // ms
+  uint32_t peakHeap; // bytes allocated above the heap usage at replay start
+  int speed; // 0 - as fast as possible
+};
+JaamTraceBuffer             traceBuffer(TRACE_BUFFER_SIZE);
+std::atomic<TraceMode>      traceMode(TRACE_IDLE);
+std::atomic<TraceCommand>   traceCommand(TRACE_NONE);
+int                         replaySpeed = 1; // set by web server before TRACE_START_REPLAY
+ReplayStats                 replayStats = {};
+size_t                      replayOffset = 0;
+uint32_t                    replayStartTime = 0;
+uint32_t                    replayFirstFrameTime = 0;
+uint32_t                    replayStartHeap = 0;
+uint32_t                    replayStartMinHeap = 0;
+bool                        traceUploadFailed = false;
+JaamProfiler                replayProfiler; // stage timings of the last replay
+
 float     brightnessFactor = 0.5f;
+uint32_t  brightnessScale = 213910; // brightnessFactor * 255 / 10000 in Q24 fixed point, see updateBrightnessScale()
 int       minBrightness = 1;
 float     minBlinkBrightness = 0.05f;
 
@@ -116,6 +350,21 @@ bool    shouldWifiReconnect = false;
 bool    websocketReconnect = false;
 bool    isDaylightSaving = false;
 time_t  websocketLastPingTime = 0;
+enum WebsocketState {
+  WS_WAITING,
+  WS_RESOLVING,
+  WS_CONNECTING,
+  WS_CONNECTED
+};
+WebsocketState  websocketState = WS_WAITING;
+unsigned long   websocketNextAttemptTime = 0;
+unsigned long   websocketServerIpTime = 0;
+int             websocketFailures = 0;
+JaamBackoff     websocketBackoff(WS_RECONNECT_MIN_DELAY, WS_RECONNECT_MAX_DELAY);
+// delta frames are applied only on top of a snapshot received in the same connection
+JaamDeltaSequence deltaSequence;
+uint32_t        deltaGaps = 0;
+uint32_t        deltaResyncs = 0;
 bool    initUpdate = false;
 #if FW_UPDATE_ENABLED
 bool    fwUpdateAvailable = false;
@@ -191,15 +440,68 @@ bool isAnalogLightSensorEnabled() {
   return settings.getInt(LIGHT_SENSOR_PIN) > -1;
 }
 
+void updateBrightnessScale() {
+  brightnessScale = getBrightnessScale(brightnessFactor);
+}
+
+/**
+* Converts brightness to nscale8 value without float math.
+* @param brightness Brightness in 1/100 of percent (0 - 10000)
+*/
+uint8_t scaleBrightness(uint32_t brightness) {
+  // use brightnessFactor (as Q24 brightnessScale) as a multiplier to get scaled brightness
+  return scaleBrightness(brightness, brightnessScale, minBrightness);
+}
+
+CRGB fromRgbFixed(int r, int g, int b, uint32_t brightness) {
+  return CRGB(r, g, b).nscale8_video(scaleBrightness(brightness));
+}
+
+CRGB fromHueFixed(int hue, uint32_t brightness) {
+  RGBColor rgb = hue2rgb(hue);
+  return CRGB(rgb.r, rgb.g, rgb.b).nscale8_video(scaleBrightness(brightness));
+}
+
 CRGB fromRgb(int r, int g, int b, float brightness) {
-  // use brightnessFactor as a multiplier to get scaled brightness
-  int scaledBrightness = (brightness == 0.0f) ? 0 : round(max(brightness, minBrightness * 1.0f) * 255.0f / 100.0f * brightnessFactor);
-  return CRGB().setRGB(r, g, b).nscale8_video(scaledBrightness);
+  return fromRgbFixed(r, g, b, toFixedBrightness(brightness));
 }
 
 CRGB fromHue(int hue, float brightness) {
-  RGBColor rgb = hue2rgb(hue);
-  return fromRgb(rgb.r, rgb.g, rgb.b, brightness);
+  return fromHueFixed(hue, toFixedBrightness(brightness));
+}
+
+const RenderConfig& getRenderConfig() {
+  uint32_t generation = settings.getGeneration();
+  int index = renderConfigIndex;
+  if (index >= 0 && renderConfigs[index].generation == generation) return renderConfigs[index];
+
+  std::lock_guard<std::mutex> lock(renderConfigMutex);
+  // another task could publish it while we waited
+  index = renderConfigIndex;
+  if (index >= 0 && renderConfigs[index].generation == generation) return renderConfigs[index];
+  int spareIndex = index == 0 ? 1 : 0;
+  RenderConfig& config = renderConfigs[spareIndex];
+  loadRenderConfig(settings, config);
+  // generation read before the values, so a change made meanwhile rebuilds config on the next call
+  config.generation = generation;
+  renderConfigIndex = spareIndex;
+  return config;
+}
+
+// sends framebuffer to the strips only if it differs from the last shown one
+void showStrips() {
+  if (stripsShown
+      && memcmp(strip, shownStrip, sizeof(strip)) == 0
+      && memcmp(bg_strip, shownBgStrip, sizeof(bg_strip)) == 0
+      && memcmp(service_strip, shownServiceStrip, sizeof(service_strip)) == 0) {
+    return;
+  }
+  memcpy(shownStrip, strip, sizeof(strip));
+  memcpy(shownBgStrip, bg_strip, sizeof(bg_strip));
+  memcpy(shownServiceStrip, service_strip, sizeof(service_strip));
+  stripsShown = true;
+  StageTimer timer(JaamProfiler::LEDS_SHOW);
+  FastLED.show();
 }
 
 const char* getNameById(SettingListItem list[], int id, int size) {
@@ -257,6 +559,7 @@ void rebootDevice(int time = 2000, bool async = false) {
     return;
   }
   showServiceMessage("Перезавантаження..", "", time);
+  settings.commit();
   delay(time);
   display.clearDisplay();
   display.display();
@@ -425,7 +728,11 @@ void servicePin(ServiceLed type, uint8_t status, bool force) {
       digitalWrite(pin, status);
     }
     if (isServiceStripEnabled() && settings.getInt(LEGACY) == 3) {
-      FastLED.show();
+      if (renderTaskHandle) {
+        mapRedrawRequested = true;
+      } else {
+        showStrips();
+      }
     }
   }
 }
@@ -545,6 +852,7 @@ void saveConfigCallback() {
 
 #if ARDUINO_OTA_ENABLED
 void showOtaUpdateErrorMessage(ota_error_t error) {
+  resumeRendering();
   switch (error) {
     case OTA_AUTH_ERROR:
       showServiceMessage("Авторизація", "Помилка оновлення:", 5000);
@@ -596,7 +904,7 @@ void mapUpdate(float percents) {
       service_strip_update_index++;
     }
   }
-  FastLED.show();
+  showStrips();
 }
 
 #if FW_UPDATE_ENABLED || ARDUINO_OTA_ENABLED
@@ -609,6 +917,10 @@ void showUpdateProgress(size_t progress, size_t total) {
 }
 
 void showUpdateStart() {
+  // device reboots right after update, pending settings should not be lost
+  settings.commit();
+  // update progress is drawn on the map from update task
+  pauseRendering();
   showServiceMessage("Починаємо!", "Оновлення:");
   delay(1000);
 }
@@ -652,17 +964,28 @@ void initBroadcast() {
   LOG.println();
 }
 
+int getRegionAlertState(int regionId) {
+  int slot = regionSlot(regionId);
+  return slot < 0 ? CLEAR : regionsState.alertState[slot];
+}
+
+long getRegionAlertTime(int regionId) {
+  int slot = regionSlot(regionId);
+  return slot < 0 ? 0 : regionsState.alertTime[slot];
+}
+
+float getRegionTemperature(int regionId) {
+  int slot = regionSlot(regionId);
+  return slot < 0 ? 0.0f : regionsState.temperature[slot];
+}
+
+long getRegionExplosionTime(int regionId) {
+  int slot = regionSlot(regionId);
+  return slot < 0 ? 0 : regionsState.explosionTime[slot];
+}
+
 bool isAlertInNeighboringDistricts() {
-  int regionId = settings.getInt(HOME_DISTRICT);
-  auto neighborsPair = NEIGHBORING_DISTRICS[regionId];
-  int count = neighborsPair.first;
-  int* neighbors = neighborsPair.second;
-  for (int i = 0; i < count; i++) {
-    if (id_to_alerts[neighbors[i]].first != 0) {
-      return true;
-    }
-  }
-  return false;
+  return isAlertInSlots(regionsState.alertState, homeDistrict.neighborSlots);
 }
 
 int getCurrentMapMode() {
@@ -673,7 +996,7 @@ int getCurrentMapMode() {
   if (alarmMode == 1 && isAlertInNeighboringDistricts()) {
     return 1; // alerts mode
   }
-  if (alarmMode >= 1 && id_to_alerts[homeRegionId].first != 0) {
+  if (alarmMode >= 1 && getRegionAlertState(homeRegionId) != 0) {
     return 1; // alerts mode
   }
   return isMapOff ? 0 : settings.getInt(MAP_MODE);
@@ -693,6 +1016,9 @@ void onMqttStateChanged(bool haStatus) {
 
 // Forward declarations
 void mapCycle();
+void mapFlag();
+void requestMapRedraw();
+void requestLedMappingUpdate();
 
 bool saveMapMode(int newMapMode) {
   if (newMapMode == settings.getInt(MAP_MODE)) return false;
@@ -708,7 +1034,7 @@ bool saveMapMode(int newMapMode) {
   ha.setMapModeCurrent(mapModeName);
   showServiceMessage(mapModeName, "Режим мапи:");
   // update to selected mapMode
-  mapCycle();
+  requestMapRedraw();
   return true;
 }
 
@@ -804,6 +1130,7 @@ void handleUpdateStatus(t_httpUpdate_return ret, bool isSpiffsUpdate) {
   switch (ret) {
     case HTTP_UPDATE_FAILED:
       LOG.printf("Error Occurred. Error (%d): %s\n", httpUpdate.getLastError(), httpUpdate.getLastErrorString().c_str());
+      resumeRendering();
       break;
     case HTTP_UPDATE_NO_UPDATES:
       LOG.println("HTTP_UPDATE_NO_UPDATES");
@@ -948,7 +1275,7 @@ bool saveNightMode(bool newState) {
   }
   showServiceMessage(nightMode ? "Увімкнено" : "Вимкнено", "Нічний режим:");
   autoBrightnessUpdate();
-  mapCycle();
+  requestMapRedraw();
   reportSettingsChange("nightMode", nightMode ? "true" : "false");
   LOG.print("nightMode: ");
   LOG.println(nightMode ? "true" : "false");
@@ -973,7 +1300,7 @@ void handleClick(int event, JaamButton::Action action) {
     case 3:
       isMapOff = !isMapOff;
       showServiceMessage(!isMapOff ? "Увімкнено" : "Вимкнено", "Мапу:");
-      mapCycle();
+      requestMapRedraw();
       break;
     // toggle display
     case 4:
@@ -990,7 +1317,7 @@ void handleClick(int event, JaamButton::Action action) {
         isDisplayOff = !isDisplayOff;
       }
       showServiceMessage(!isMapOff ? "Увімкнено" : "Вимкнено", "Дисплей та мапу:");
-      mapCycle();
+      requestMapRedraw();
       break;
     // toggle night mode
     case 6:
@@ -1061,7 +1388,7 @@ bool saveLampBrightness(int newBrightness, bool saveToSettings, bool checkPrevBr
     ha.setLampBrightness(newBrightness);
   }
 
-  mapCycle();
+  requestMapRedraw();
   return true;
 }
 
@@ -1166,55 +1493,38 @@ void distributeBrightnessLevels() {
 }
 
 void remapFlag() {
-  led_to_flag_color =  mapLeds(ledMapping, FLAG_COLORS);
-}
-
-std::pair<int, long> alertsCombiModeHandler(std::pair<int, long> kyiv, std::pair<int, long> kyivObl) {
-  // if state of Kyiv and Kyiv Oblast are 'alert', return oldest by time
-  if (kyiv.first == 1 && kyivObl.first == 1) return kyiv.second <= kyivObl.second ? kyiv : kyivObl;
-  // if states of Kyiv and Kyiv Oblast are 'clear', return nearest by time
-  if (kyiv.first == 0 && kyivObl.first == 0) return kyiv.second >= kyivObl.second ? kyiv : kyivObl;
-  // if one of the states is 0, return another
-  return kyiv.first == 0 ? kyivObl : kyiv;
-}
-
-void remapAlerts() {
-  auto combiHandler = settings.getInt(KYIV_DISTRICT_MODE) == 4 ? alertsCombiModeHandler : NULL;
-  led_to_alerts = mapLeds(ledMapping, id_to_alerts, combiHandler);
-}
-
-float weatherCombiModeHandler(float kyiv, float kyivObl) {
-  // return average value of Kyiv and Kyiv Oblast
-  return (kyiv + kyivObl) / 2.0f;
+  for (int led = 0; led < MAIN_LEDS_COUNT; led++) {
+    int slot = ledLayout.ledSlots[led];
+    auto flagColor = slot < 0 ? FLAG_COLORS.end() : FLAG_COLORS.find(mapIndexToRegionId(slot));
+    ledFlagColor[led] = flagColor == FLAG_COLORS.end() ? 0 : flagColor->second;
+  }
 }
 
-void remapWeather() {
-  auto combiHandler = settings.getInt(KYIV_DISTRICT_MODE) == 4 ? weatherCombiModeHandler : NULL;
-  led_to_weather = mapLeds(ledMapping, id_to_weather, combiHandler);
+void remapAlerts(uint32_t changedSlots) {
+  if (changedSlots & homeDistrict.neighborSlots) {
+    bgStripDirty = true;
+  }
+  dirtyLeds |= remapAlerts(ledLayout, renderRegionsState, ledsState, changedSlots);
 }
 
-long expMisDroneCombiModeHandler(long kyiv, long kyivObl) {
-  // return nearest by time
-  return max(kyiv, kyivObl);
+void remapWeather(uint32_t changedSlots) {
+  dirtyLeds |= remapWeather(ledLayout, renderRegionsState, ledsState, changedSlots);
 }
 
-void remapExplosions() {
-  auto combiHandler = settings.getInt(KYIV_DISTRICT_MODE) == 4 ? expMisDroneCombiModeHandler : NULL;
-  led_to_explosions = mapLeds(ledMapping, id_to_explosions, combiHandler);
+void remapExplosions(uint32_t changedSlots) {
+  dirtyLeds |= remapExplosions(ledLayout, renderRegionsState, ledsState, changedSlots);
 }
 
-void remapMissiles() {
-  auto combiHandler = settings.getInt(KYIV_DISTRICT_MODE) == 4 ? expMisDroneCombiModeHandler : NULL;
-  led_to_missiles = mapLeds(ledMapping, id_to_missiles, combiHandler);
+void remapMissiles(uint32_t changedSlots) {
+  dirtyLeds |= remapMissiles(ledLayout, renderRegionsState, ledsState, changedSlots);
 }
 
-void remapDrones() {
-  auto combiHandler = settings.getInt(KYIV_DISTRICT_MODE) == 4 ? expMisDroneCombiModeHandler : NULL;
-  led_to_drones = mapLeds(ledMapping, id_to_drones, combiHandler);
+void remapDrones(uint32_t changedSlots) {
+  dirtyLeds |= remapDrones(ledLayout, renderRegionsState, ledsState, changedSlots);
 }
 
 void remapHomeDistrict() {
-  homeDistrictMapping = ledMapping(settings.getInt(HOME_DISTRICT));
+  homeDistrict = getHomeDistrict(ledLayout, settings.getInt(HOME_DISTRICT));
 }
 
 bool saveBrightness(int newBrightness) {
@@ -1290,7 +1600,7 @@ bool saveLampRgb(int r, int g, int b) {
   sprintf(rgbHex, "#%02x%02x%02x", settings.getInt(HA_LIGHT_R), settings.getInt(HA_LIGHT_G), settings.getInt(HA_LIGHT_B));
   reportSettingsChange("ha_light_rgb", rgbHex);
   ha.setLampColor(settings.getInt(HA_LIGHT_R), settings.getInt(HA_LIGHT_G), settings.getInt(HA_LIGHT_B));
-  mapCycle();
+  requestMapRedraw();
   return true;
 }
 
@@ -1303,7 +1613,7 @@ bool saveHomeDistrict(int newHomeDistrict) {
   ha.setHomeDistrict(homeDistrictName);
   ha.setMapModeCurrent(getNameById(MAP_MODES, getCurrentMapMode(), MAP_MODES_COUNT));
   showServiceMessage(homeDistrictName, "Домашній регіон:", 2000);
-  remapHomeDistrict();
+  homeDistrictChanged = true;
   return true;
 }
 
@@ -1344,7 +1654,7 @@ void showHomeAlertInfo() {
   }
   char message[15];
   int regionId = settings.getInt(HOME_DISTRICT);
-  fillFromTimer(message, timeClient.unixGMT() - id_to_alerts[regionId].second);
+  fillFromTimer(message, timeClient.unixGMT() - getRegionAlertTime(regionId));
 
   displayMessage(message, title);
 }
@@ -1364,7 +1674,7 @@ void showClock() {
 void showTemp() {
   int regionId = settings.getInt(HOME_DISTRICT);
   char message[10];
-  sprintf(message, "%.1f%cC", id_to_weather[regionId], (char)128);
+  sprintf(message, "%.1f%cC", getRegionTemperature(regionId), (char)128);
   displayMessage(message, getNameById(DISTRICTS, settings.getInt(HOME_DISTRICT), DISTRICTS_COUNT));
 }
 
@@ -1574,6 +1884,7 @@ void showNewFirmwareNotification() {
 
 void displayCycle() {
   if (!display.isDisplayAvailable()) return;
+  StageTimer timer(JaamProfiler::DISPLAY_CYCLE);
 
   updateDisplayBrightness();
 
@@ -1684,58 +1995,37 @@ void disableAlertAndClearPins() {
   disableClearPin();
 }
 
-void initLedMapping() {
-  if (settings.getInt(LEGACY) == 1) {
-    switch (settings.getInt(KYIV_DISTRICT_MODE)) {
-    case 1:
-      ledMapping = mapTranscarpatiaStart1;
-      LOG.println("Transcarpatia district mode 1");
-      break;
-    case 2:
-      ledMapping = mapTranscarpatiaStart2;
-      LOG.println("Transcarpatia district mode 2");
-      break;
-    case 3:
-      ledMapping = mapTranscarpatiaStart3;
-      LOG.println("Transcarpatia district mode 3");
-      break;
-    case 4:
-      ledMapping = mapTranscarpatiaStart4;
-      LOG.println("Transcarpatia district mode 4");
-      break;
-    default:
-      LOG.printf("Unknown Kyiv district mode: %d\n", settings.getInt(KYIV_DISTRICT_MODE));
-      throw std::runtime_error("Unknown Kyiv district mode");
-    }
-  } else {
-    switch (settings.getInt(KYIV_DISTRICT_MODE)) {
-    case 1:
-      ledMapping = mapOdessaStart1;
-      LOG.println("Odessa district mode 1");
-      break;
-    case 2:
-      ledMapping = mapOdessaStart2;
-      LOG.println("Odessa district mode 2");
-      break;
-    case 3:
-      ledMapping = mapOdessaStart3;
-      LOG.println("Odessa district mode 3");
-      break;
-    case 4:
-      ledMapping = mapOdessaStart4;
-      LOG.println("Odessa district mode 4");
-      break;
-    default:
-      LOG.printf("Unknown Kyiv district mode: %d\n", settings.getInt(KYIV_DISTRICT_MODE));
-      throw std::runtime_error("Unknown Kyiv district mode");
-    }
+// restores data applied before reboot, it is shown from the first frame until fresh data arrives
+void initWarmStart() {
+  WarmStartState state;
+  warmStartSource = stateStore.restore(&state, sizeof(state));
+  if (warmStartSource == JaamStateStore::NONE) {
+    LOG.println("No state to restore");
+    return;
   }
+  for (int slot = 0; slot < REGION_SLOTS_COUNT; slot++) {
+    regionsState.alertState[slot] = state.alertState[slot];
+    regionsState.alertTime[slot] = state.alertTime[slot];
+    regionsState.temperature[slot] = state.temperature[slot] / 10.0f;
+    regionsState.explosionTime[slot] = state.explosionTime[slot];
+    regionsState.missilesTime[slot] = state.missilesTime[slot];
+    regionsState.dronesTime[slot] = state.dronesTime[slot];
+  }
+  // render task is not started yet, so its copy is filled here too
+  renderRegionsState = regionsState;
+  warmStartTime = state.savedAt;
+  provisionalState = true;
+  LOG.printf("State restored from %s, saved at %u\n", JaamStateStore::getSourceName(warmStartSource), state.savedAt);
+}
+
+void initLedMapping() {
+  if (!loadLedLayout(settings, ledLayout)) throw std::runtime_error("Unknown Kyiv district mode");
   remapFlag();
-  remapAlerts();
-  remapWeather();
-  remapExplosions();
-  remapMissiles();
-  remapDrones();
+  remapAlerts(ALL_REGION_SLOTS);
+  remapWeather(ALL_REGION_SLOTS);
+  remapExplosions(ALL_REGION_SLOTS);
+  remapMissiles(ALL_REGION_SLOTS);
+  remapDrones(ALL_REGION_SLOTS);
   remapHomeDistrict();
 }
 
@@ -1746,337 +2036,391 @@ int sliderIndex = 1;
 int selectIndex = 1;
 int inputFieldIndex = 1;
 
-void addCheckbox(AsyncResponseStream* response, const char* name, bool isChecked, const char* label, const char* onChanges = NULL, bool disabled = false) {
-  response->print("<div class='form-group form-check'>");
-  response->print("<input name='");
-  response->print(name);
-  response->print("' type='checkbox' class='form-check-input' id='chb");
-  response->print(checkboxIndex);
-  if (onChanges) {
-    response->print("'");
-    response->print(" onchange='");
-    response->print(onChanges);
-  }
-  response->print("'");
-  if (isChecked) response->print(" checked");
-  if (disabled) response->print(" disabled");
-  response->print("/>");
-  response->print(label);
-  response->println("</div>");
-  checkboxIndex++;
+// Static parts of the pages, {N} is replaced by N-th argument of JaamPageWriter::fill
+static const char CHECKBOX_FRAGMENT[] PROGMEM =
+  "<div class='form-group form-check'>"
+  "<input name='{0}' type='checkbox' class='form-check-input' id='chb{1}' onchange='{2}'{3}{4}/>{5}"
+  "</div>\n";
+static const char SLIDER_LABEL_FRAGMENT[] PROGMEM = "{0}: <span id='sv{1}'>{2}</span>{3}";
+static const char COLOR_SLIDER_LABEL_FRAGMENT[] PROGMEM =
+  "{0}: <span id='sv{1}'>{2}</span>{3}"
+  "</br><div class='color-box' id='cb{1}' style='background-color: rgb({4}, {5}, {6});'></div>";
+static const char SLIDER_FRAGMENT[] PROGMEM =
+  "<input type='range' name='{0}' class='form-control-range' id='s{1}' min='{2}' max='{3}' step='{4}' value='{5}'"
+  " oninput='window.updateVal(\"sv{1}\", this.value);'{6}/></br>\n";
+static const char COLOR_SLIDER_FRAGMENT[] PROGMEM =
+  "<input type='range' name='{0}' class='form-control-range' id='s{1}' min='{2}' max='{3}' step='{4}' value='{5}'"
+  " oninput='window.updateColAndVal(\"cb{1}\", \"sv{1}\", this.value);'{6}/></br>\n";
+static const char SELECT_FRAGMENT[] PROGMEM = "{0}: <select name='{1}' class='form-control' id='sb{2}' onchange='{3}'{4}>";
+static const char OPTION_FRAGMENT[] PROGMEM = "<option value='{0}'{1}>{2}</option>";
+static const char SELECT_END_FRAGMENT[] PROGMEM = "</select></br>\n";
+static const char INPUT_TEXT_FRAGMENT[] PROGMEM = "{0}: <input type='{1}' name='{2}' class='form-control'{3} id='if{4}' value='{5}'></br>\n";
+static const char CARD_FRAGMENT[] PROGMEM =
+  "<div class='col-auto mb-2'>"
+  "<div class='card' style='width: 15rem; height: 9rem;'>"
+  "<div class='card-header d-flex'>{0}</div>"
+  "<div class='card-body d-flex'><h{1} class='card-title m-auto'>{2}{3}</h{1}></div>"
+  "</div>"
+  "</div>";
+
+const char* formatValue(char* buffer, const char* value, int precision) {
+  return value;
 }
 
 template <typename V>
-
-void addSlider(AsyncResponseStream* response, const char* name, const char* label, V value, V min, V max, V step = 1, const char* unitOfMeasurement = "", bool disabled = false, bool needColorBox = false) {
-  response->print(label);
-  response->print(": <span id='sv");
-  response->print(sliderIndex);
-  response->print("'>");
-  if (std::is_same<V, float>::value) {
-    char stringValue[10];
-    sprintf(stringValue, "%.1f", value);
-    response->print(stringValue);
+typename std::enable_if<std::is_arithmetic<V>::value, const char*>::type formatValue(char* buffer, V value, int precision) {
+  if (std::is_floating_point<V>::value) {
+    sprintf(buffer, "%.*f", precision, (double) value);
   } else {
-    response->print(value);
+    sprintf(buffer, "%d", (int) value);
   }
-  response->print("</span>");
-  response->print(unitOfMeasurement);
+  return buffer;
+}
+
+void addCheckbox(JaamPageWriter* response, const char* name, bool isChecked, const char* label, const char* onChanges = NULL, bool disabled = false) {
+  char index[12];
+  sprintf(index, "%d", checkboxIndex++);
+  response->fill(CHECKBOX_FRAGMENT, {name, index, onChanges ? onChanges : "", isChecked ? " checked" : "", disabled ? " disabled" : "", label});
+}
+
+template <typename V>
+
+void addSlider(JaamPageWriter* response, const char* name, const char* label, V value, V min, V max, V step = 1, const char* unitOfMeasurement = "", bool disabled = false, bool needColorBox = false) {
+  char index[12];
+  char shownValue[16];
+  sprintf(index, "%d", sliderIndex++);
+  formatValue(shownValue, value, 1);
   if (needColorBox) {
-    response->print("</br><div class='color-box' id='cb");
-    response->print(sliderIndex);
     RGBColor valueColor = hue2rgb((int) value);
-    response->print("' style='background-color: rgb(");
-    response->print(valueColor.r);
-    response->print(", ");
-    response->print(valueColor.g);
-    response->print(", ");
-    response->print(valueColor.b);
-    response->print(");'></div>");
-  }
-  response->print("<input type='range' name='");
-  response->print(name);
-  response->print("' class='form-control-range' id='s");
-  response->print(sliderIndex);
-  response->print("' min='");
-  response->print(min);
-  response->print("' max='");
-  response->print(max);
-  response->print("' step='");
-  response->print(step);
-  response->print("' value='");
-  response->print(value);
-  response->print("'");
-  if (needColorBox) {
-    response->print(" oninput='window.updateColAndVal(\"cb");
-    response->print(sliderIndex);
-    response->print("\", \"sv");
+    char r[4], g[4], b[4];
+    sprintf(r, "%d", valueColor.r);
+    sprintf(g, "%d", valueColor.g);
+    sprintf(b, "%d", valueColor.b);
+    response->fill(COLOR_SLIDER_LABEL_FRAGMENT, {label, index, shownValue, unitOfMeasurement, r, g, b});
   } else {
-    response->print(" oninput='window.updateVal(\"sv");
+    response->fill(SLIDER_LABEL_FRAGMENT, {label, index, shownValue, unitOfMeasurement});
   }
-  response->print(sliderIndex);
-  response->print("\", this.value);'");
-  if (disabled) response->print(" disabled");
-  response->print("/>");
-  response->println("</br>");
-  sliderIndex++;
-}
-
-void addSelectBox(AsyncResponseStream* response, const char* name, const char* label, int setting, SettingListItem options[], int optionsCount, bool disabled = false, const char* onChanges = NULL) {
-  response->print(label);
-  response->print(": <select name='");
-  response->print(name);
-  response->print("' class='form-control' id='sb");
-  response->print(selectIndex);
-  if (onChanges) {
-    response->print("'");
-    response->print(" onchange='");
-    response->print(onChanges);
-  }
-  response->print("'");
-  if (disabled) response->print(" disabled");
-  response->print(">");
+  char minValue[16], maxValue[16], stepValue[16], inputValue[16];
+  formatValue(minValue, min, 2);
+  formatValue(maxValue, max, 2);
+  formatValue(stepValue, step, 2);
+  formatValue(inputValue, value, 2);
+  response->fill(needColorBox ? COLOR_SLIDER_FRAGMENT : SLIDER_FRAGMENT, {name, index, minValue, maxValue, stepValue, inputValue, disabled ? " disabled" : ""});
+}
+
+void addSelectBox(JaamPageWriter* response, const char* name, const char* label, int setting, SettingListItem options[], int optionsCount, bool disabled = false, const char* onChanges = NULL) {
+  char index[12];
+  sprintf(index, "%d", selectIndex++);
+  response->fill(SELECT_FRAGMENT, {label, name, index, onChanges ? onChanges : "", disabled ? " disabled" : ""});
   for (int i = 0; i < optionsCount; i++) {
     if (options[i].ignore) continue;
-    int index = options[i].id;
-    response->print("<option value='");
-    response->print(index);
-    response->print("'");
-    if (setting == index) response->print(" selected");
-    response->print(">");
-    response->print(options[i].name);
-    response->print("</option>");
-  }
-  response->print("</select>");
-  response->println("</br>");
-  selectIndex++;
-}
-
-void addInputText(AsyncResponseStream* response, const char* name, const char* label, const char* type, const char* value, int maxLength = -1) {
-  response->print(label);
-  response->print(": <input type='");
-  response->print(type);
-  response->print("' name='");
-  response->print(name);
-  response->print("' class='form-control'");
-  if (maxLength >= 0) {
-    response->print(" maxlength='");
-    response->print(maxLength);
-    response->print("'");
-  }
-  response->print(" id='if");
-  response->print(inputFieldIndex);
-  response->print("' value='");
-  response->print(value);
-  response->print("'>");
-  response->println("</br>");
-  inputFieldIndex++;
+    char value[12];
+    sprintf(value, "%d", options[i].id);
+    response->fill(OPTION_FRAGMENT, {value, setting == options[i].id ? " selected" : "", options[i].name});
+  }
+  response->fill(SELECT_END_FRAGMENT);
+}
+
+void addInputText(JaamPageWriter* response, const char* name, const char* label, const char* type, const char* value, int maxLength = -1) {
+  char index[12];
+  char maxLengthAttribute[24] = "";
+  sprintf(index, "%d", inputFieldIndex++);
+  if (maxLength >= 0) sprintf(maxLengthAttribute, " maxlength='%d'", maxLength);
+  response->fill(INPUT_TEXT_FRAGMENT, {label, type, name, maxLengthAttribute, index, value});
 }
 
 template <typename V>
 
-void addCard(AsyncResponseStream* response, const char* title, V value, const char* unitOfMeasurement = "", int size = 1, int precision = 1) {
-  response->print("<div class='col-auto mb-2'>");
-  response->print("<div class='card' style='width: 15rem; height: 9rem;'>");
-  response->print("<div class='card-header d-flex'>");
+void addCard(JaamPageWriter* response, const char* title, V value, const char* unitOfMeasurement = "", int size = 1, int precision = 1) {
+  char sizeStr[4];
+  char valueStr[16];
+  sprintf(sizeStr, "%d", size);
+  response->fill(CARD_FRAGMENT, {title, sizeStr, formatValue(valueStr, value, precision), unitOfMeasurement});
+}
+
+bool readBenchmarkBaseline(uint32_t baseline[]);
+void saveBenchmarkBaseline();
+
+void addProfilerTable(JaamPageWriter* response, const char* title, JaamProfiler& stageProfiler, uint32_t baseline[] = NULL) {
+  float cyclesPerMicro = getCpuFrequencyMhz();
+  response->print("<div class='col-md-12 mt-2'><b>");
   response->print(title);
-  response->print("</div>");
-  response->print("<div class='card-body d-flex'>");
-  response->print("<h");
-  response->print(size);
-  response->print(" class='card-title m-auto'>");
-  if (std::is_same<V, float>::value) {
-    char valueStr[10];
-    sprintf(valueStr, "%.*f", precision, value);
-    response->print(valueStr);
-  } else if (std::is_same<V, int>::value) {
-    char valueStr[10];
-    sprintf(valueStr, "%d", value);
-    response->print(valueStr);
-  } else {
-    response->print(value);
-  }
-  response->print(unitOfMeasurement);
-  response->print("</h");
-  response->print(size);
-  response->print(">");
-  response->print("</div>");
-  response->print("</div>");
-  response->print("</div>");
-}
-
-void addHeader(AsyncResponseStream* response) {
-  response->println("<!DOCTYPE html>");
-  response->println("<html lang='uk'>");
-  response->println("<head>");
-  response->println("<meta charset='UTF-8'>");
-  response->println("<meta name='viewport' content='width=device-width, initial-scale=1.0'>");
-  response->print("<title>");
-  response->print(settings.getString(DEVICE_NAME));
-  response->println("</title>");
-  // To prevent favicon request
-  response->println("<link rel='icon' href='data:image/png;base64,iVBORw0KGgo='>");
-  response->println("<link rel='stylesheet' href='https://cdn.jsdelivr.net/npm/bootstrap@4.6.2/dist/css/bootstrap.min.css' integrity='sha384-xOolHFLEh07PJGoPkLv1IbcEPTNtaed2xpHsD9ESMhqIYd0nLMwNLD69Npy4HI+N' crossorigin='anonymous'>");
-  response->print("<link rel='stylesheet' href='https://");
-  response->print(settings.getString(WS_SERVER_HOST));
-  response->println("/static/jaam_v1.css'>");
-  response->println("</head>");
-  response->println("<body>");
-  response->println("<div class='container mt-3'  id='accordion'>");
-  response->print("<h2 class='text-center'>");
-  response->print(settings.getString(DEVICE_DESCRIPTION));
-  response->print(" ");
-  response->print(currentFwVersion);
-  response->println("</h2>");
-  response->println("<div class='row justify-content-center'>");
+  response->println("</b>");
+  response->println("<table class='table table-sm'><tr><th>Етап</th><th>Кількість</th><th>min, мкс</th><th>p50, мкс</th><th>p99, мкс</th><th>max, мкс</th></tr>");
+  char row[160];
+  for (int stage = 0; stage < JaamProfiler::STAGES_COUNT; stage++) {
+    // values change between renders, so every row is a fragment
+    if (!response->beginFragment()) continue;
+    JaamProfiler::Summary summary = stageProfiler.getSummary((JaamProfiler::Stage) stage);
+    bool regression = baseline && summary.count > 0 && (uint64_t) summary.p99 * 100 > (uint64_t) baseline[stage] * (100 + BENCHMARK_REGRESSION_PERCENT);
+    sprintf(row, "<tr%s><td>%s%s</td><td>%u</td><td>%.1f</td><td>%.1f</td><td>%.1f</td><td>%.1f</td></tr>",
+      regression ? " class='text-danger'" : "",
+      JaamProfiler::getStageName((JaamProfiler::Stage) stage),
+      regression ? " (регресія)" : "",
+      (unsigned int) summary.count,
+      summary.min / cyclesPerMicro,
+      summary.p50 / cyclesPerMicro,
+      summary.p99 / cyclesPerMicro,
+      summary.max / cyclesPerMicro
+    );
+    response->println(row);
+  }
+  response->beginFragment();
+  response->println("</table>");
+  response->println("</div>");
+}
+
+void addSchedulerTable(JaamPageWriter* response) {
+  response->println("<div class='col-md-12 mt-2'><b>Фонові задачі</b>");
+  response->print("<table class='table table-sm'><tr><th>Задача</th><th>Період, мс</th><th>Пріоритет</th><th>Запусків</th><th>Пропущено</th><th>max запізнення, мс</th><th>avg, мкс</th><th>max, мкс</th><th>Розподіл тривалості (");
+  for (int bucket = 0; bucket < SCHEDULER_HISTOGRAM_BUCKETS - 1; bucket++) {
+    response->printf("&lt;%u / ", (unsigned int) JaamScheduler::getHistogramBound(bucket));
+  }
+  response->println("більше, мкс)</th></tr>");
+  char row[200];
+  // jobs are taken once per page, so rows do not shift when one-shot jobs come and go between chunks
+  uint32_t jobs = response->snapshot(scheduler.getJobsMask());
+  for (int id = 0; id < SCHEDULER_MAX_JOBS; id++) {
+    if (!((jobs >> id) & 1)) continue;
+    if (!response->beginFragment()) continue;
+    JaamScheduler::JobStats stats;
+    // row of a job removed after the first chunk stays empty
+    if (!scheduler.getJobStats(id, &stats)) continue;
+    sprintf(row, "<tr%s><td>%s</td><td>%u%s</td><td>%s</td><td>%u</td><td>%u</td><td>%.1f</td><td>%u</td><td>%u</td><td>",
+      stats.missed > 0 ? " class='text-danger'" : "",
+      stats.name,
+      (unsigned int) stats.period,
+      stats.repeat ? "" : " (одноразово)",
+      JaamScheduler::getPriorityName(stats.priority),
+      (unsigned int) stats.runs,
+      (unsigned int) stats.missed,
+      stats.maxLateness / 1000.0,
+      (unsigned int) (stats.runs > 0 ? stats.totalRunTime / stats.runs : 0),
+      (unsigned int) stats.maxRunTime
+    );
+    response->print(row);
+    for (int bucket = 0; bucket < SCHEDULER_HISTOGRAM_BUCKETS; bucket++) {
+      if (bucket > 0) response->print(" / ");
+      response->print((unsigned int) stats.histogram[bucket]);
+    }
+    response->println("</td></tr>");
+  }
+  response->beginFragment();
+  response->println("</table>");
+  response->println("</div>");
+}
+
+void addLatencyTable(JaamPageWriter* response) {
+  response->println("<div class='col-md-12 mt-2'><b>Затримка оновлення тривог</b>");
+  response->print("<table class='table table-sm'><tr><th>Етап</th><th>Кількість</th><th>p50, мс</th><th>p99, мс</th><th>max, мс</th><th>Розподіл (");
+  for (int bucket = 0; bucket < LATENCY_BUCKETS_COUNT - 1; bucket++) {
+    response->printf("&lt;%g / ", JaamLatencyStats::getBucketBound(bucket) / 1000.0);
+  }
+  response->println("більше, мс)</th></tr>");
+  char row[120];
+  for (int stage = 0; stage < JaamLatencyStats::STAGES_COUNT; stage++) {
+    if (!response->beginFragment()) continue;
+    JaamLatencyStats::Summary summary = latencyStats.getSummary((JaamLatencyStats::Stage) stage);
+    sprintf(row, "<tr><td>%s</td><td>%u</td><td>%.1f</td><td>%.1f</td><td>%.1f</td><td>",
+      JaamLatencyStats::getStageName((JaamLatencyStats::Stage) stage),
+      (unsigned int) summary.count,
+      summary.p50 / 1000.0,
+      summary.p99 / 1000.0,
+      summary.max / 1000.0
+    );
+    response->print(row);
+    for (int bucket = 0; bucket < LATENCY_BUCKETS_COUNT; bucket++) {
+      if (bucket > 0) response->print(" / ");
+      response->print((unsigned int) latencyStats.getBucketCount((JaamLatencyStats::Stage) stage, bucket));
+    }
+    response->println("</td></tr>");
+  }
+  response->beginFragment();
+  response->println("</table>");
+  response->println("</div>");
+}
+
+void addTraceSection(JaamPageWriter* response) {
+  TraceMode mode = (TraceMode) response->snapshot(traceMode);
+  response->println("<div class='row justify-content-center' data-parent='#accordion'>");
   response->println("<div class='by col-md-9 mt-2'>");
-  response->print("<img class='full-screen-img' src='https://");
-  response->print(settings.getString(WS_SERVER_HOST));
-  response->print("/");
-  switch (getCurrentMapMode()) {
-    case 0:
-      response->print("off_map.png");
-      break;
-    case 2:
-      response->print("weather_map.png");
-      break;
-    case 3:
-      response->print("flag_map.png");
-      break;
-    case 4:
-      response->print("random_map.png");
-      break;
-    case 5:
-      response->print("lamp_map.png");
-      break;
-    default:
-      response->print("alerts_map.png");
+  response->println("<b><p class='text'>Запис даних від сервера тривог. Записаний потік можна завантажити, відновити на будь-якій мапі та відтворити, щоб заміряти швидкість обробки. Під час відтворення нові дані від сервера не застосовуються.</p></b>");
+  response->println("<div class='row'>");
+  addCard(response, "Стан", TRACE_MODE_NAMES[mode], "", 2);
+  addCard(response, "Кадрів у записі", traceBuffer.getCount());
+  addCard(response, "Відкинуто кадрів", (int) traceBuffer.getDroppedFrames());
+  addCard(response, "Заповнено буфер", traceBuffer.getUsed() * 100.0f / traceBuffer.getCapacity(), "%");
+  if (response->snapshot(replayStats.frames > 0)) {
+    addCard(response, "Відтворено кадрів", (int) replayStats.frames);
+    addCard(response, "Тривалість відтворення", (int) replayStats.duration, "мс");
+    addCard(response, "Пікове використання памʼяті", replayStats.peakHeap / 1024.0f, "кБ");
+  }
+  addProfilerTable(response, "Тривалість етапів під час відтворення", replayProfiler);
+  response->println("</div>");
+  if (mode == TRACE_IDLE) {
+    response->println("<form action='/traceCapture' method='POST' class='d-inline'><button type='submit' class='btn btn-info'>Почати запис</button></form>");
+    response->println("<a href='/trace' target='_blank' class='btn btn-info'>Завантажити запис</a>");
+    response->println("<form id='form_trace' action='/traceUpload' method='POST' enctype='multipart/form-data' class='d-inline'>");
+    response->println("<label for='trace' class='btn btn-primary mb-0'>Відновити запис</label>");
+    response->println("<input id='trace' name='trace' type='file' style='visibility:hidden;width:0;' onchange='javascript:document.getElementById(\"form_trace\").submit();' accept='.bin'/>");
+    response->println("</form>");
+    response->println("<form action='/traceReplay' method='POST' class='mt-2'>");
+    addSelectBox(response, "replay_speed", "Швидкість відтворення", replaySpeed, REPLAY_SPEED_OPTIONS, REPLAY_SPEED_OPTIONS_COUNT);
+    response->println("<button type='submit' class='btn btn-primary'>Відтворити запис</button>");
+    response->println("</form>");
+  } else {
+    response->println("<form action='/traceStop' method='POST' class='d-inline'><button type='submit' class='btn btn-danger'>Зупинити</button></form>");
   }
-  response->println("'>");
   response->println("</div>");
   response->println("</div>");
+}
+
+// favicon is inlined to prevent favicon request
+static const char HEADER_FRAGMENT[] PROGMEM =
+  "<!DOCTYPE html>\n"
+  "<html lang='uk'>\n"
+  "<head>\n"
+  "<meta charset='UTF-8'>\n"
+  "<meta name='viewport' content='width=device-width, initial-scale=1.0'>\n"
+  "<title>{0}</title>\n"
+  "<link rel='icon' href='data:image/png;base64,iVBORw0KGgo='>\n"
+  "<link rel='stylesheet' href='https://cdn.jsdelivr.net/npm/bootstrap@4.6.2/dist/css/bootstrap.min.css' integrity='sha384-xOolHFLEh07PJGoPkLv1IbcEPTNtaed2xpHsD9ESMhqIYd0nLMwNLD69Npy4HI+N' crossorigin='anonymous'>\n"
+  "<link rel='stylesheet' href='https://{1}/static/jaam_v1.css'>\n"
+  "</head>\n"
+  "<body>\n"
+  "<div class='container mt-3'  id='accordion'>\n"
+  "<h2 class='text-center'>{2} {3}</h2>\n"
+  "<div class='row justify-content-center'>\n"
+  "<div class='by col-md-9 mt-2'>\n"
+  "<svg id='map-preview' class='full-screen-img' style='background:#1e1e1e;border-radius:8px'></svg>\n"
+  "<script src='/map.js'></script>\n"
+  "<script>jaamMap(document.getElementById('map-preview'));</script>\n"
+  "</div>\n"
+  "</div>\n";
+static const char FW_UPDATE_FRAGMENT[] PROGMEM =
+  "<div class='row justify-content-center'>\n"
+  "<div class='by col-md-9 mt-2'>\n"
+  "<div class='alert alert-success text-center'>\n"
+  "Доступна нова версія прошивки - <b>{0}</b></br>Для оновлення перейдіть в розділ <b><a href='/firmware'>Прошивка</a></b></h8>\n"
+  "</div>\n"
+  "<div class='alert alert-info text-rigth' id='release-notes' data-version='{0}'>Завантажити опис оновлення?</div>\n"
+  "<div class='text-center'><button class='btn btn-info' onclick='fetchReleaseNotes()'>Отримати опис оновлення</button></div><br>\n"
+  "</div>\n"
+  "</div>\n";
+static const char DEVICE_INFO_FRAGMENT[] PROGMEM =
+  "<div class='row justify-content-center'>\n"
+  "<div class='by col-md-9 mt-2'>\n"
+  "Локальна IP-адреса: <b>{0}</b>\n";
+static const char DEVICE_INFO_ITEM_FRAGMENT[] PROGMEM = "</br>{0}: <b>{1}</b>\n";
+static const char ROW_END_FRAGMENT[] PROGMEM =
+  "</div>\n"
+  "</div>\n";
+static const char LINKS_FRAGMENT[] PROGMEM =
+  "<div class='row justify-content-center'>\n"
+  "<div class='by col-md-9 mt-2'>\n"
+  "<a href='/brightness' class='btn btn-success'>Яскравість</a>\n"
+  "<a href='/colors' class='btn btn-success'>Кольори</a>\n"
+  "<a href='/modes' class='btn btn-success'>Режими</a>\n"
+  "{0}"
+  "<a href='/telemetry' class='btn btn-primary'>Телеметрія</a>\n"
+  "<a href='/dev' class='btn btn-warning'>DEV</a>\n"
+  "{1}"
+  "</div>\n"
+  "</div>\n";
+static const char FOOTER_FRAGMENT[] PROGMEM =
+  "<div class='position-fixed bottom-0 right-0 p-3' style='z-index: 5; right: 0; bottom: 0;'>\n"
+  "<div id='saved-toast' class='toast hide' role='alert' aria-live='assertive' aria-atomic='true' data-delay='2000'>\n"
+  "<div class='toast-body'>\n"
+  "💾 Налаштування збережено!\n"
+  "</div>\n"
+  "</div>\n"
+  "<div id='reboot-toast' class='toast hide' role='alert' aria-live='assertive' aria-atomic='true' data-delay='2000'>\n"
+  "<div class='toast-body'>\n"
+  "💾 Налаштування збережено! Перезавантаження...\n"
+  "</div>\n"
+  "</div>\n"
+  "<div id='restore-toast' class='toast hide' role='alert' aria-live='assertive' aria-atomic='true' data-delay='2000'>\n"
+  "<div class='toast-body'>\n"
+  "✅ Налаштування відновлено! Перезавантаження...\n"
+  "</div>\n"
+  "</div>\n"
+  "<div id='restore-error-toast' class='toast hide' role='alert' aria-live='assertive' aria-atomic='true' data-delay='2000'>\n"
+  "<div class='toast-body'>\n"
+  "🚫 Помилка відновлення налаштувань!\n"
+  "</div>\n"
+  "</div>\n"
+  "</div>\n"
+  "</div>\n"
+  "<script src='https://cdn.jsdelivr.net/npm/jquery@3.5.1/dist/jquery.slim.min.js' integrity='sha384-DfXdz2htPH0lsSSs5nCTpuj/zy4C+OGpamoFVy38MVBnE+IbbVYUew+OrCXaRkfj' crossorigin='anonymous'></script>\n"
+  "<script src='https://cdn.jsdelivr.net/npm/bootstrap@4.6.2/dist/js/bootstrap.bundle.min.js' integrity='sha384-Fy6S3B9q64WdZWQUiU+q4/2Lc9npb8tCaSX9FK7E8HnRr0Jz8D6OP9dO5Vg3Q9ct' crossorigin='anonymous'></script>\n"
+  "<script src='https://cdn.jsdelivr.net/npm/js-cookie@3.0.5/dist/js.cookie.min.js'></script>\n"
+  "{0}"
+  "<script src='https://{1}/static/jaam_v1.js'></script>\n"
+  "<script src='https://{1}/static/jaam_v2.js'></script>\n"
+  "</body>\n"
+  "</html>\n";
+
+void addHeader(JaamPageWriter* response) {
+  response->fill(HEADER_FRAGMENT, {settings.getString(DEVICE_NAME), settings.getString(WS_SERVER_HOST), settings.getString(DEVICE_DESCRIPTION), currentFwVersion});
 #if FW_UPDATE_ENABLED
-  if (fwUpdateAvailable) {
-    response->println("<div class='row justify-content-center'>");
-    response->println("<div class='by col-md-9 mt-2'>");
-    response->println("<div class='alert alert-success text-center'>");
-    response->print("Доступна нова версія прошивки - <b>");
-    response->print(newFwVersion);
-    response->println("</b></br>Для оновлення перейдіть в розділ <b><a href='/firmware'>Прошивка</a></b></h8>");
-    response->println("</div>");
-    response->print("<div class='alert alert-info text-rigth' id='release-notes' data-version='");
-    response->print(newFwVersion);
-    response->println("'>Завантажити опис оновлення?</div>");
-    response->print("<div class='text-center'><button class='btn btn-info' onclick='fetchReleaseNotes()'>Отримати опис оновлення</button></div><br>");
-    response->println("</div>");
-    response->println("</div>");
-  }
+  if (response->snapshot(fwUpdateAvailable)) response->fill(FW_UPDATE_FRAGMENT, {newFwVersion});
 #endif
-  response->println("<div class='row justify-content-center'>");
-  response->println("<div class='by col-md-9 mt-2'>");
-  response->print("Локальна IP-адреса: <b>");
-  response->print(getLocalIP());
-  response->println("</b>");
+  response->fill(DEVICE_INFO_FRAGMENT, {getLocalIP()});
   if (display.isDisplayEnabled()) {
-    response->println("</br>Дисплей: <b>");
-    if (display.isDisplayAvailable()) {
-      response->print(display.getDisplayModel());
-      response->print(" (128x");
-      response->print(display.height());
-      response->print(")");
-    } else {
-      response->print("Немає");
-    }
-    response->println("</b>");
+    char displayInfo[40] = "Немає";
+    if (display.isDisplayAvailable()) sprintf(displayInfo, "%s (128x%d)", display.getDisplayModel().c_str(), display.height());
+    response->fill(DEVICE_INFO_ITEM_FRAGMENT, {"Дисплей", displayInfo});
   }
   if (lightSensor.isLightSensorEnabled()) {
-    response->println("</br>Сенсор освітлення: <b>");
-    response->print(lightSensor.getSensorModel());
-    response->println("</b>");
+    response->fill(DEVICE_INFO_ITEM_FRAGMENT, {"Сенсор освітлення", lightSensor.getSensorModel().c_str()});
   }
   if (climate.isAnySensorEnabled()) {
-    response->println("</br>Сенсор клімату: <b>");
-    response->print(climate.getSensorModel());
-    response->println("</b>");
+    response->fill(DEVICE_INFO_ITEM_FRAGMENT, {"Сенсор клімату", climate.getSensorModel().c_str()});
   }
-  response->println("</div>");
-  response->println("</div>");
+  response->fill(ROW_END_FRAGMENT);
 }
 
-void addLinks(AsyncResponseStream* response) {
-  response->println("<div class='row justify-content-center'>");
-  response->println("<div class='by col-md-9 mt-2'>");
-  response->println("<a href='/brightness' class='btn btn-success'>Яскравість</a>");
-  response->println("<a href='/colors' class='btn btn-success'>Кольори</a>");
-  response->println("<a href='/modes' class='btn btn-success'>Режими</a>");
+void addLinks(JaamPageWriter* response) {
+  const char* soundsLink = "";
+  const char* firmwareLink = "";
 #if BUZZER_ENABLED
-  if (isBuzzerEnabled()) {
-    response->println("<a href='/sounds' class='btn btn-success'>Звуки</a>");
-  }
+  if (isBuzzerEnabled()) soundsLink = "<a href='/sounds' class='btn btn-success'>Звуки</a>\n";
 #endif
-  response->println("<a href='/telemetry' class='btn btn-primary'>Телеметрія</a>");
-  response->println("<a href='/dev' class='btn btn-warning'>DEV</a>");
 #if FW_UPDATE_ENABLED
-  response->println("<a href='/firmware' class='btn btn-danger'>Прошивка</a>");
+  firmwareLink = "<a href='/firmware' class='btn btn-danger'>Прошивка</a>\n";
 #endif
-  response->println("</div>");
-  response->println("</div>");
+  response->fill(LINKS_FRAGMENT, {soundsLink, firmwareLink});
 }
 
-void addFooter(AsyncResponseStream* response) {
-  response->println("<div class='position-fixed bottom-0 right-0 p-3' style='z-index: 5; right: 0; bottom: 0;'>");
-  response->println("<div id='saved-toast' class='toast hide' role='alert' aria-live='assertive' aria-atomic='true' data-delay='2000'>");
-  response->println("<div class='toast-body'>");
-  response->println("💾 Налаштування збережено!");
-  response->println("</div>");
-  response->println("</div>");
-  response->println("<div id='reboot-toast' class='toast hide' role='alert' aria-live='assertive' aria-atomic='true' data-delay='2000'>");
-  response->println("<div class='toast-body'>");
-  response->println("💾 Налаштування збережено! Перезавантаження...");
-  response->println("</div>");
-  response->println("</div>");
-  response->println("<div id='restore-toast' class='toast hide' role='alert' aria-live='assertive' aria-atomic='true' data-delay='2000'>");
-  response->println("<div class='toast-body'>");
-  response->println("✅ Налаштування відновлено! Перезавантаження...");
-  response->println("</div>");
-  response->println("</div>");
-  response->println("<div id='restore-error-toast' class='toast hide' role='alert' aria-live='assertive' aria-atomic='true' data-delay='2000'>");
-  response->println("<div class='toast-body'>");
-  response->println("🚫 Помилка відновлення налаштувань!");
-  response->println("</div>");
-  response->println("</div>");
-  response->println("</div>");
-  response->println("</div>");
-  response->println("<script src='https://cdn.jsdelivr.net/npm/jquery@3.5.1/dist/jquery.slim.min.js' integrity='sha384-DfXdz2htPH0lsSSs5nCTpuj/zy4C+OGpamoFVy38MVBnE+IbbVYUew+OrCXaRkfj' crossorigin='anonymous'></script>");
-  response->println("<script src='https://cdn.jsdelivr.net/npm/bootstrap@4.6.2/dist/js/bootstrap.bundle.min.js' integrity='sha384-Fy6S3B9q64WdZWQUiU+q4/2Lc9npb8tCaSX9FK7E8HnRr0Jz8D6OP9dO5Vg3Q9ct' crossorigin='anonymous'></script>");
-  response->println("<script src='https://cdn.jsdelivr.net/npm/js-cookie@3.0.5/dist/js.cookie.min.js'></script>");
+void addFooter(JaamPageWriter* response) {
+  const char* releaseNotesScript = "";
 #if FW_UPDATE_ENABLED
-  if (fwUpdateAvailable) {
-    response->println("<script src='https://cdn.jsdelivr.net/npm/marked/marked.min.js'></script>");
-  }
+  if (response->snapshot(fwUpdateAvailable)) releaseNotesScript = "<script src='https://cdn.jsdelivr.net/npm/marked/marked.min.js'></script>\n";
 #endif
-  response->print("<script src='https://");
-  response->print(settings.getString(WS_SERVER_HOST));
-  response->println("/static/jaam_v1.js'></script>");
-  response->print("<script src='https://");
-  response->print(settings.getString(WS_SERVER_HOST));
-  response->println("/static/jaam_v2.js'></script>");
-  response->println("</body>");
-  response->println("</html>");
-}
-
-void handleBrightness(AsyncWebServerRequest* request) {
-  // reset indexes
-  checkboxIndex = 1;
-  sliderIndex = 1;
-  selectIndex = 1;
-  inputFieldIndex = 1;
-
-  AsyncResponseStream* response = request->beginResponseStream("text/html");
-
+  response->fill(FOOTER_FRAGMENT, {releaseNotesScript, settings.getString(WS_SERVER_HOST)});
+}
+
+// Page is rendered again for every chunk of the response, so a request keeps one chunk in memory
+// instead of the whole page
+void sendPage(AsyncWebServerRequest* request, void (*render)(JaamPageWriter*)) {
+  std::shared_ptr<JaamPageWriter> writer = std::make_shared<JaamPageWriter>();
+  request->send(request->beginChunkedResponse("text/html", [writer, render](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+    if (!writer->begin(buffer, maxLen)) return 0;
+    // reset indexes
+    checkboxIndex = 1;
+    sliderIndex = 1;
+    selectIndex = 1;
+    inputFieldIndex = 1;
+    render(writer.get());
+    return writer->end();
+  }));
+}
+
+void renderBrightness(JaamPageWriter* response) {
   addHeader(response);
   addLinks(response);
 
+  response->beginFragment();
   response->println("<form action='/saveBrightness' method='POST'>");
   response->println("<div class='row justify-content-center'>");
   response->println("<div class='by col-md-9 mt-2'>");
@@ -2117,20 +2461,13 @@ void handleBrightness(AsyncWebServerRequest* request) {
   response->println("</form>");
 
   addFooter(response);
-
-  response->setCode(200);
-  request->send(response);
 }
 
-void handleColors(AsyncWebServerRequest* request) {
-  // reset indexes
-  checkboxIndex = 1;
-  sliderIndex = 1;
-  selectIndex = 1;
-  inputFieldIndex = 1;
-
-  AsyncResponseStream* response = request->beginResponseStream("text/html");
+void handleBrightness(AsyncWebServerRequest* request) {
+  sendPage(request, renderBrightness);
+}
 
+void renderColors(JaamPageWriter* response) {
   addHeader(response);
   addLinks(response);
 
@@ -2154,20 +2491,13 @@ void handleColors(AsyncWebServerRequest* request) {
   response->println("</form>");
 
   addFooter(response);
-
-  response->setCode(200);
-  request->send(response);
 }
 
-void handleModes(AsyncWebServerRequest* request) {
-  // reset indexes
-  checkboxIndex = 1;
-  sliderIndex = 1;
-  selectIndex = 1;
-  inputFieldIndex = 1;
-
-  AsyncResponseStream* response = request->beginResponseStream("text/html");
+void handleColors(AsyncWebServerRequest* request) {
+  sendPage(request, renderColors);
+}
 
+void renderModes(JaamPageWriter* response) {
   addHeader(response);
   addLinks(response);
 
@@ -2224,6 +2554,7 @@ void handleModes(AsyncWebServerRequest* request) {
   addSlider(response, "alert_off_time", "Тривалість відображення відбою", settings.getInt(ALERT_OFF_TIME), 1, 10, 1, " хв.", settings.getInt(ALARMS_NOTIFY_MODE) == 0);
   addSlider(response, "explosion_time", "Тривалість відображення інформації про вибухи, ракети та БПЛА", settings.getInt(EXPLOSION_TIME), 1, 10, 1, " хв.", settings.getInt(ALARMS_NOTIFY_MODE) == 0);
   addSlider(response, "alert_blink_time", "Тривалість анімації зміни яскравості", settings.getInt(ALERT_BLINK_TIME), 1, 5, 1, " с.", settings.getInt(ALARMS_NOTIFY_MODE) != 2);
+  addSelectBox(response, "frame_rate", "Частота кадрів анімації", settings.getInt(FRAME_RATE), FRAME_RATE_OPTIONS, FRAME_RATE_OPTIONS_COUNT, settings.getInt(ALARMS_NOTIFY_MODE) != 2);
   addSelectBox(response, "alarms_auto_switch", "Перемикання мапи в режим тривоги у випадку тривоги у домашньому регіоні", settings.getInt(ALARMS_AUTO_SWITCH), AUTO_ALARM_MODES, AUTO_ALARM_MODES_COUNT);
   if (settings.getInt(LEGACY) == 0 || settings.getInt(LEGACY) == 3) {
     addCheckbox(response, "service_diodes_mode", settings.getInt(SERVICE_DIODES_MODE), "Ввімкнути сервісні діоди");
@@ -2236,20 +2567,13 @@ void handleModes(AsyncWebServerRequest* request) {
   response->println("</form>");
 
   addFooter(response);
-
-  response->setCode(200);
-  request->send(response);
 }
 
-void handleSounds(AsyncWebServerRequest* request) {
-  // reset indexes
-  checkboxIndex = 1;
-  sliderIndex = 1;
-  selectIndex = 1;
-  inputFieldIndex = 1;
-
-  AsyncResponseStream* response = request->beginResponseStream("text/html");
+void handleModes(AsyncWebServerRequest* request) {
+  sendPage(request, renderModes);
+}
 
+void renderSounds(JaamPageWriter* response) {
   addHeader(response);
   addLinks(response);
 
@@ -2277,20 +2601,13 @@ void handleSounds(AsyncWebServerRequest* request) {
 #endif
 
   addFooter(response);
-
-  response->setCode(200);
-  request->send(response);
 }
 
-void handleTelemetry(AsyncWebServerRequest* request) {
-  // reset indexes
-  checkboxIndex = 1;
-  sliderIndex = 1;
-  selectIndex = 1;
-  inputFieldIndex = 1;
-
-  AsyncResponseStream* response = request->beginResponseStream("text/html");
+void handleSounds(AsyncWebServerRequest* request) {
+  sendPage(request, renderSounds);
+}
 
+void renderTelemetry(JaamPageWriter* response) {
   addHeader(response);
   addLinks(response);
 
@@ -2303,11 +2620,21 @@ void handleTelemetry(AsyncWebServerRequest* request) {
   addCard(response, "Вільна памʼять", freeHeapSize, "кБ");
   addCard(response, "Використана памʼять", usedHeapSize, "кБ");
   addCard(response, "WiFi сигнал", wifiSignal, "dBm");
-  addCard(response, getNameById(DISTRICTS, settings.getInt(HOME_DISTRICT), DISTRICTS_COUNT), id_to_weather[settings.getInt(HOME_DISTRICT) ], "°C");
+  addCard(response, getNameById(DISTRICTS, settings.getInt(HOME_DISTRICT), DISTRICTS_COUNT), getRegionTemperature(settings.getInt(HOME_DISTRICT)), "°C");
   if (ha.isHaEnabled()) {
     addCard(response, "Home Assistant", haConnected ? "Підключено" : "Відключено", "", 2);
   }
   addCard(response, "Сервер тривог", client_websocket.available() ? "Підключено" : "Відключено", "", 2);
+  SettingsWriteStats writeStats = settings.getWriteStats();
+  addCard(response, "Записів налаштувань", (int) writeStats.committed);
+  addCard(response, "Уникнуто записів", (int) writeStats.avoided);
+  addCard(response, "Частота кадрів", frameClock.getAchievedFps(), "кадр/с");
+  addCard(response, "Пропущено кадрів", (int) frameClock.getDroppedFrames());
+  addCard(response, "Пропуски даних", (int) deltaGaps);
+  addCard(response, "Ресинхронізації", (int) deltaResyncs);
+  addCard(response, "Обʼєднано кадрів", (int) frameQueue.getSuperseded());
+  addCard(response, "Переповнення черги", (int) frameQueueOverflows);
+  addCard(response, "Відновлений стан", JaamStateStore::getSourceName(warmStartSource), "", 2);
   if (climate.isTemperatureAvailable()) {
     addCard(response, "Температура", climate.getTemperature(settings.getFloat(TEMP_CORRECTION)), "°C");
   }
@@ -2325,22 +2652,30 @@ void handleTelemetry(AsyncWebServerRequest* request) {
   response->println("</div>");
   response->println("</div>");
   response->println("</form>");
+  response->println("<div class='row justify-content-center' data-parent='#accordion'>");
+  response->println("<div class='by col-md-9 mt-2'>");
+  response->println("<div class='row'>");
+  addSchedulerTable(response);
+  addLatencyTable(response);
+  addProfilerTable(response, "Тривалість етапів рендерингу", profiler);
+  uint32_t baseline[JaamProfiler::STAGES_COUNT];
+  bool hasBaseline = readBenchmarkBaseline(baseline);
+  addProfilerTable(response, "Синтетичний тест (всі регіони в тривозі, всі сповіщення, 100 фонових світлодіодів)", benchmarkProfiler, hasBaseline ? baseline : NULL);
+  response->println("</div>");
+  response->println("<form action='/runBenchmark' method='POST' class='d-inline'><button type='submit' class='btn btn-info'>Запустити тест</button></form>");
+  response->println("<form action='/saveBenchmarkBaseline' method='POST' class='d-inline'><button type='submit' class='btn btn-primary float-right'>Зберегти як базовий</button></form>");
+  response->println("</div>");
+  response->println("</div>");
+  addTraceSection(response);
 
   addFooter(response);
-
-  response->setCode(200);
-  request->send(response);
 }
 
-void handleDev(AsyncWebServerRequest* request) {
-  // reset indexes
-  checkboxIndex = 1;
-  sliderIndex = 1;
-  selectIndex = 1;
-  inputFieldIndex = 1;
-
-  AsyncResponseStream* response = request->beginResponseStream("text/html");
+void handleTelemetry(AsyncWebServerRequest* request) {
+  sendPage(request, renderTelemetry);
+}
 
+void renderDev(JaamPageWriter* response) {
   addHeader(response);
   addLinks(response);
 
@@ -2374,6 +2709,7 @@ void handleDev(AsyncWebServerRequest* request) {
     addInputText(response, "button2pin", "Керуючий пін кнопки 2 (-1 - вимкнено)", "number", String(settings.getInt(BUTTON_2_PIN)).c_str());
     addCheckbox(response, "use_touch_button2", settings.getBool(USE_TOUCH_BUTTON_2), "Підтримка touch-кнопки TTP223 для кнопки 2");
   }
+  addInputText(response, "led_layout", "Власна розкладка лед-стрічки (ID регіонів для кожного пікселя через кому, -1 - піксель не використовується, порожньо - стандартна)", "text", settings.getString(LED_LAYOUT), 200);
   addSelectBox(response, "alert_clear_pin_mode", "Режим роботи пінів тривоги та відбою", settings.getInt(ALERT_CLEAR_PIN_MODE), ALERT_PIN_MODES_OPTIONS, ALERT_PIN_MODES_COUNT);
   addInputText(response, "alertpin", "Пін тривоги у домашньому регіоні (має бути output, -1 - вимкнено)", "number", String(settings.getInt(ALERT_PIN)).c_str());
   addInputText(response, "clearpin", "Пін відбою у домашньому регіоні (має бути output, лише для Імпульсного режиму, -1 - вимкнено)", "number", String(settings.getInt(CLEAR_PIN)).c_str());
@@ -2409,20 +2745,13 @@ void handleDev(AsyncWebServerRequest* request) {
   response->println("</div>");
 
   addFooter(response);
-
-  response->setCode(200);
-  request->send(response);
 }
 
-void handleFirmware(AsyncWebServerRequest* request) {
-  // reset indexes
-  checkboxIndex = 1;
-  sliderIndex = 1;
-  selectIndex = 1;
-  inputFieldIndex = 1;
-
-  AsyncResponseStream* response = request->beginResponseStream("text/html");
+void handleDev(AsyncWebServerRequest* request) {
+  sendPage(request, renderDev);
+}
 
+void renderFirmware(JaamPageWriter* response) {
   addHeader(response);
   addLinks(response);
 
@@ -2440,14 +2769,8 @@ void handleFirmware(AsyncWebServerRequest* request) {
   response->println("<select name='bin_name' class='form-control' id='sb16'>");
   const int count = settings.getInt(FW_UPDATE_CHANNEL) ? testBinsCount : binsCount;
   for (int i = 0; i < count; i++) {
-    String filename = String(settings.getInt(FW_UPDATE_CHANNEL) ? test_bin_list[i] : bin_list[i]);
-    response->print("<option value='");
-    response->print(filename);
-    response->print("'");
-    if (i == 0) response->print(" selected");
-    response->print(">");
-    response->print(filename);
-    response->println("</option>");
+    const char* filename = settings.getInt(FW_UPDATE_CHANNEL) ? test_bin_list[i] : bin_list[i];
+    response->fill(OPTION_FRAGMENT, {filename, i == 0 ? " selected" : "", filename});
   }
   response->println("</select>");
   response->println("</br>");
@@ -2458,27 +2781,74 @@ void handleFirmware(AsyncWebServerRequest* request) {
 #endif
 
   addFooter(response);
+}
 
-  response->setCode(200);
-  request->send(response);
+void handleFirmware(AsyncWebServerRequest* request) {
+  sendPage(request, renderFirmware);
 }
 
-void handleRoot(AsyncWebServerRequest* request) {
-  // reset indexes
-  checkboxIndex = 1;
-  sliderIndex = 1;
-  selectIndex = 1;
-  inputFieldIndex = 1;
+// Web app is a single gzipped page in SPIFFS (see firmware/web), it gets data from /api/* endpoints.
+// SPIFFS image is flashed separately from firmware, so without it the built-in pages are served.
+#define WEB_APP_PATH "/index.html.gz"
+
+bool webAppAvailable = false;
+char webAppETag[11]; // FNV-1a of the gzipped page in quotes
+
+void initWebApp() {
+  if (!SPIFFS.begin(false)) {
+    LOG.println("SPIFFS is not mounted, built-in pages are used");
+    return;
+  }
+  File file = SPIFFS.open(WEB_APP_PATH, "r");
+  if (!file) {
+    LOG.println("Web app is not found, built-in pages are used");
+    return;
+  }
+  uint32_t hash = 2166136261UL;
+  uint8_t buffer[256];
+  size_t length;
+  while ((length = file.read(buffer, sizeof(buffer))) > 0) {
+    for (size_t i = 0; i < length; i++) hash = (hash ^ buffer[i]) * 16777619UL;
+  }
+  LOG.printf("Web app found: %d bytes\n", file.size());
+  file.close();
+  sprintf(webAppETag, "\"%08x\"", hash);
+  webAppAvailable = true;
+}
+
+// answers 304 if client has the same version, so page is downloaded once per its change
+bool sendNotModified(AsyncWebServerRequest* request, const char* eTag) {
+  if (!request->hasHeader("If-None-Match") || request->header("If-None-Match") != eTag) return false;
+  AsyncWebServerResponse* response = request->beginResponse(304);
+  response->addHeader("ETag", eTag);
+  request->send(response);
+  return true;
+}
 
-  AsyncResponseStream* response = request->beginResponseStream("text/html");
+void handleWebApp(AsyncWebServerRequest* request) {
+  if (sendNotModified(request, webAppETag)) return;
+  AsyncWebServerResponse* response = request->beginResponse(SPIFFS, WEB_APP_PATH, "text/html");
+  response->addHeader("Content-Encoding", "gzip");
+  response->addHeader("ETag", webAppETag);
+  // browser keeps the page, but checks ETag on every load
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
+}
 
+void renderRoot(JaamPageWriter* response) {
   addHeader(response);
   addLinks(response);
 
   addFooter(response);
+}
 
-  response->setCode(200);
-  request->send(response);
+void handleRoot(AsyncWebServerRequest* request) {
+  // built-in pages are left for devices without web app in SPIFFS, "?legacy" opens them anyway
+  if (webAppAvailable && !request->hasParam("legacy")) {
+    handleWebApp(request);
+    return;
+  }
+  sendPage(request, renderRoot);
 }
 
 void saveInt(Type settingType, int newValue, const char* paramName) {
@@ -2577,6 +2947,18 @@ AsyncWebServerResponse* redirectResponce(AsyncWebServerRequest* request, const c
   return response;
 }
 
+void updateTimeZone() {
+  timeClient.setTimeZone(settings.getInt(TIME_ZONE));
+}
+
+void updateMelodyVolume() {
+#if BUZZER_ENABLED
+  if (isBuzzerEnabled()) {
+    player->setVolume(expMap(settings.getInt(MELODY_VOLUME), 0, 100, 0, 255));
+  }
+#endif
+}
+
 void handleSaveBrightness(AsyncWebServerRequest *request) {
   bool saved = false;
   saved = saveInt(request->getParam("brightness", true), BRIGHTNESS, saveBrightness) || saved;
@@ -2636,7 +3018,7 @@ void handleSaveModes(AsyncWebServerRequest* request) {
   saved = saveInt(request->getParam("button2_mode", true), BUTTON_2_MODE) || saved;
   saved = saveInt(request->getParam("button_mode_long", true), BUTTON_1_MODE_LONG) || saved;
   saved = saveInt(request->getParam("button2_mode_long", true), BUTTON_2_MODE_LONG) || saved;
-  saved = saveInt(request->getParam("kyiv_district_mode", true), KYIV_DISTRICT_MODE, NULL, initLedMapping) || saved;
+  saved = saveInt(request->getParam("kyiv_district_mode", true), KYIV_DISTRICT_MODE, NULL, requestLedMappingUpdate) || saved;
   saved = saveBool(request->getParam("home_alert_time", true), "home_alert_time", HOME_ALERT_TIME, saveShowHomeAlarmTime) || saved;
   saved = saveInt(request->getParam("alarms_notify_mode", true), ALARMS_NOTIFY_MODE) || saved;
   saved = saveBool(request->getParam("enable_explosions", true), "enable_explosions", ENABLE_EXPLOSIONS) || saved;
@@ -2646,13 +3028,12 @@ void handleSaveModes(AsyncWebServerRequest* request) {
   saved = saveInt(request->getParam("alert_off_time", true), ALERT_OFF_TIME) || saved;
   saved = saveInt(request->getParam("explosion_time", true), EXPLOSION_TIME) || saved;
   saved = saveInt(request->getParam("alert_blink_time", true), ALERT_BLINK_TIME) || saved;
+  saved = saveInt(request->getParam("frame_rate", true), FRAME_RATE) || saved;
   saved = saveInt(request->getParam("alarms_auto_switch", true), ALARMS_AUTO_SWITCH, saveAutoAlarmMode) || saved;
   saved = saveBool(request->getParam("service_diodes_mode", true), "service_diodes_mode", SERVICE_DIODES_MODE, NULL, checkServicePins) || saved;
   saved = saveBool(request->getParam("min_of_silence", true), "min_of_silence", MIN_OF_SILENCE) || saved;
   saved = saveBool(request->getParam("invert_display", true), "invert_display", INVERT_DISPLAY, NULL, updateInvertDisplayMode) || saved;
-  saved = saveInt(request->getParam("time_zone", true), TIME_ZONE, NULL, []() {
-    timeClient.setTimeZone(settings.getInt(TIME_ZONE));
-  }) || saved;
+  saved = saveInt(request->getParam("time_zone", true), TIME_ZONE, NULL, updateTimeZone) || saved;
 
   if (request->hasParam("color_lamp", true)) {
     int selectedHue = request->getParam("color_lamp", true)->value().toInt();
@@ -2676,13 +3057,7 @@ void handleSaveSounds(AsyncWebServerRequest* request) {
   saved = saveBool(request->getParam("sound_on_button_click", true), "sound_on_button_click", SOUND_ON_BUTTON_CLICK) || saved;
   saved = saveBool(request->getParam("mute_sound_on_night", true), "mute_sound_on_night", MUTE_SOUND_ON_NIGHT) || saved;
   saved = saveBool(request->getParam("ignore_mute_on_alert", true), "ignore_mute_on_alert",IGNORE_MUTE_ON_ALERT) || saved;
-  saved = saveInt(request->getParam("melody_volume", true), MELODY_VOLUME, NULL, []() {
-#if BUZZER_ENABLED
-  if (isBuzzerEnabled()) {
-    player->setVolume(expMap(settings.getInt(MELODY_VOLUME), 0, 100, 0, 255));
-  }
-#endif
-  }) || saved;
+  saved = saveInt(request->getParam("melody_volume", true), MELODY_VOLUME, NULL, updateMelodyVolume) || saved;
 
   request->send(redirectResponce(request, "/sounds", saved));
 }
@@ -2691,10 +3066,74 @@ void handleRefreshTelemetry(AsyncWebServerRequest* request) {
   request->send(redirectResponce(request, "/telemetry", false));
 }
 
-void handleSaveDev(AsyncWebServerRequest* request) {
-  bool reboot = false;
-  reboot = saveInt(request->getParam("legacy", true), LEGACY) || reboot;
-  reboot = saveInt(request->getParam("display_height", true), DISPLAY_HEIGHT) || reboot;
+void handleRunBenchmark(AsyncWebServerRequest* request) {
+  // benchmark drives LEDs and display, so it runs in main loop instead of web server task
+  benchmarkRequested = true;
+  request->send(redirectResponce(request, "/telemetry", false));
+}
+
+void handleSaveBenchmarkBaseline(AsyncWebServerRequest* request) {
+  saveBenchmarkBaseline();
+  request->send(redirectResponce(request, "/telemetry", true));
+}
+
+void handleTraceCapture(AsyncWebServerRequest* request) {
+  traceCommand = TRACE_START_CAPTURE;
+  request->send(redirectResponce(request, "/telemetry", false));
+}
+
+void handleTraceStop(AsyncWebServerRequest* request) {
+  traceCommand = TRACE_STOP;
+  request->send(redirectResponce(request, "/telemetry", false));
+}
+
+void handleTraceReplay(AsyncWebServerRequest* request) {
+  if (request->hasParam("replay_speed", true)) {
+    replaySpeed = request->getParam("replay_speed", true)->value().toInt();
+  }
+  traceCommand = TRACE_START_REPLAY;
+  request->send(redirectResponce(request, "/telemetry", false));
+}
+
+// buffer is read directly, so it is given only while network task does not change it
+void handleTraceDownload(AsyncWebServerRequest* request) {
+  if (traceMode != TRACE_IDLE) {
+    request->send(409, "text/plain", "Trace capture or replay is running");
+    return;
+  }
+  AsyncWebServerResponse* response = request->beginResponse("application/octet-stream", traceBuffer.getFileSize(), [](uint8_t* buffer, size_t maxLength, size_t index) -> size_t {
+    return traceBuffer.readFile(index, buffer, maxLength);
+  });
+  char filenameHeader[65];
+  sprintf(filenameHeader, "attachment; filename=\"jaam_trace_%s.bin\"", timeClient.unixToString("YYYY.MM.DD_hh-mm-ss").c_str());
+  response->addHeader("Content-Disposition", filenameHeader);
+  request->send(response);
+}
+
+void handleTraceUploadBody(AsyncWebServerRequest* request, String filename, size_t index, uint8_t* data, size_t len, bool final) {
+  if (index == 0) {
+    traceUploadFailed = traceMode != TRACE_IDLE || !traceBuffer.allocate();
+  }
+  if (traceUploadFailed) return;
+  if (!traceBuffer.writeFile(index, data, len)) {
+    LOG.println("Uploaded file is not a trace or it is too big");
+    traceUploadFailed = true;
+    traceBuffer.clear();
+    return;
+  }
+  if (final) {
+    LOG.printf("Trace uploaded: %d frames\n", traceBuffer.finishFile());
+  }
+}
+
+void handleTraceUpload(AsyncWebServerRequest* request) {
+  request->send(redirectResponce(request, "/telemetry", !traceUploadFailed));
+}
+
+void handleSaveDev(AsyncWebServerRequest* request) {
+  bool reboot = false;
+  reboot = saveInt(request->getParam("legacy", true), LEGACY) || reboot;
+  reboot = saveInt(request->getParam("display_height", true), DISPLAY_HEIGHT) || reboot;
   reboot = saveInt(request->getParam("display_model", true), DISPLAY_MODEL) || reboot;
   reboot = saveString(request->getParam("ha_brokeraddress", true), HA_BROKER_ADDRESS) || reboot;
   reboot = saveInt(request->getParam("ha_mqttport", true), HA_MQTT_PORT) || reboot;
@@ -2710,6 +3149,7 @@ void handleSaveDev(AsyncWebServerRequest* request) {
   reboot = saveInt(request->getParam("pixelpin", true), MAIN_LED_PIN) || reboot;
   reboot = saveInt(request->getParam("bg_pixelpin", true), BG_LED_PIN) || reboot;
   reboot = saveInt(request->getParam("bg_pixelcount", true), BG_LED_COUNT) || reboot;
+  reboot = saveString(request->getParam("led_layout", true), LED_LAYOUT) || reboot;
   reboot = saveInt(request->getParam("buttonpin", true), BUTTON_1_PIN) || reboot;
   reboot = saveInt(request->getParam("button2pin", true), BUTTON_2_PIN) || reboot;
   reboot = saveBool(request->getParam("use_touch_button1", true), "use_touch_button1", USE_TOUCH_BUTTON_1) || reboot;
@@ -2727,40 +3167,95 @@ void handleSaveDev(AsyncWebServerRequest* request) {
   request->send(redirectResponce(request, "/dev", false, reboot));
 }
 
+struct BackupDownload {
+  SettingsBackupCursor cursor;
+  String time;
+  StreamString part; // part that did not fit into the previous chunk
+  size_t sent = 0;
+};
+
+// backup is streamed part by part into chunks, so only one setting is kept in memory at a time
 void handleBackup(AsyncWebServerRequest* request) {
-  AsyncResponseStream* response = request->beginResponseStream("application/json");
-  settings.getSettingsBackup(response, VERSION, chipID, timeClient.unixToString("DD.MM.YYYY hh:mm:ss").c_str());
+  std::shared_ptr<BackupDownload> download = std::make_shared<BackupDownload>();
+  download->time = timeClient.unixToString("DD.MM.YYYY hh:mm:ss");
+  AsyncWebServerResponse* response = request->beginChunkedResponse("application/json", [download](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+    size_t used = 0;
+    while (used < maxLen) {
+      if (download->sent == download->part.length()) {
+        download->part.clear();
+        download->sent = 0;
+        if (!settings.getSettingsBackupPart(&download->part, download->cursor, VERSION, chipID, download->time.c_str())) break;
+        continue;
+      }
+      size_t count = min(maxLen - used, download->part.length() - download->sent);
+      memcpy(buffer + used, download->part.c_str() + download->sent, count);
+      used += count;
+      download->sent += count;
+    }
+    return used;
+  });
   char filenameHeader[65];
   sprintf(filenameHeader, "attachment; filename=\"jaam_backup_%s.json\"", timeClient.unixToString("YYYY.MM.DD_hh-mm-ss").c_str());
   response->addHeader("Content-Disposition", filenameHeader);
-  response->setCode(200);
   request->send(response);
 }
 
-StreamString jsonBody;
+// every upload keeps its own restore in request, so concurrent restores do not mix
+struct RestoreUpload {
+  JaamJsonItemReader reader{"settings"};
+  SettingsRestore* restore = settings.beginSettingsRestore();
+  bool failed = false;
+};
 
 void handleRestoreBody(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
-  LOG.println("Received restore json part...");
-  LOG.printf("Filename: %s\n", filename.c_str());
-  size_t totalSize = request->contentLength();
-  LOG.printf("File size: %d\n", totalSize);
-  LOG.printf("Part Size: %d\n", len);
-  if (totalSize > MAX_JSON_SIZE) {
-    LOG.println("File size is too big!");
-    return;
+  if (index == 0) {
+    LOG.printf("Restoring settings from: %s\n", filename.c_str());
+    if (request->_tempObject) {
+      // backup should be the only file of the upload
+      ((RestoreUpload*) request->_tempObject)->failed = true;
+      return;
+    }
+    RestoreUpload* upload = new RestoreUpload();
+    request->_tempObject = upload;
+    // upload that was not finished should not leak its restore
+    request->onDisconnect([request]() {
+      RestoreUpload* upload = (RestoreUpload*) request->_tempObject;
+      if (!upload) return;
+      settings.cancelSettingsRestore(upload->restore);
+      delete upload;
+      request->_tempObject = NULL;
+    });
+  }
+  RestoreUpload* upload = (RestoreUpload*) request->_tempObject;
+  if (!upload) return;
+  // entries are checked as soon as they are read, the rest of a failed upload is just dropped
+  while (len > 0 && !upload->failed) {
+    size_t consumed = upload->reader.read(data, len);
+    data += consumed;
+    len -= consumed;
+    if (upload->reader.hasItem() && !settings.addRestoredSetting(upload->restore, upload->reader.getItem())) upload->failed = true;
+    if (upload->reader.isFailed()) {
+      LOG.println("Settings backup is malformed or has too big entry!");
+      upload->failed = true;
+    }
   }
-  jsonBody.write(data, len);
 }
 
 void handleRestore(AsyncWebServerRequest *request) {
-  LOG.println("Restoring settings...");
-  const char* jsonString = jsonBody.c_str();
-  LOG.printf("JSON to restore: %s\n", jsonString);
-  bool restored = settings.restoreSettingsBackup(jsonString);
+  RestoreUpload* upload = (RestoreUpload*) request->_tempObject;
+  bool restored = false;
+  if (upload) {
+    if (upload->failed || !upload->reader.isFinished()) {
+      settings.cancelSettingsRestore(upload->restore);
+    } else {
+      restored = settings.finishSettingsRestore(upload->restore);
+    }
+    delete upload;
+    request->_tempObject = NULL;
+  }
   if (restored) {
     rebootDevice(3000, true);
   }
-  jsonBody.clear();
   LOG.printf("Setting restored: %s\n", restored ? "true" : "false");
   request->send(redirectResponce(request, "/dev", false, false, restored, !restored));
 }
@@ -2786,8 +3281,576 @@ void handlePlayTestSound(AsyncWebServerRequest* request) {
 }
 #endif
 
+#define API_MAX_BODY_SIZE 2048
+
+struct ApiOptions {
+  const char* name; // setting name
+  SettingListItem* items;
+  int count;
+};
+
+static const ApiOptions API_OPTIONS[] = {
+  {"brightness_auto", AUTO_BRIGHTNESS_MODES, AUTO_BRIGHTNESS_OPTIONS_COUNT},
+  {"kyiv_district_mode", KYIV_LED_MODE_OPTIONS, KYIV_LED_MODE_COUNT},
+  {"map_mode", MAP_MODES, MAP_MODES_COUNT},
+  {"display_mode", DISPLAY_MODES, DISPLAY_MODE_OPTIONS_MAX},
+  {"button_mode", SINGLE_CLICK_OPTIONS, SINGLE_CLICK_OPTIONS_MAX},
+  {"button_mode_long", LONG_CLICK_OPTIONS, LONG_CLICK_OPTIONS_MAX},
+  {"home_district", DISTRICTS, DISTRICTS_COUNT},
+  {"alarms_notify_mode", ALERT_NOTIFY_OPTIONS, ALERT_NOTIFY_OPTIONS_COUNT},
+  {"frame_rate", FRAME_RATE_OPTIONS, FRAME_RATE_OPTIONS_COUNT},
+  {"alarms_auto_switch", AUTO_ALARM_MODES, AUTO_ALARM_MODES_COUNT},
+#if BUZZER_ENABLED
+  {"melody", MELODY_NAMES, MELODIES_COUNT},
+#endif
+#if FW_UPDATE_ENABLED
+  {"fw_update_channel", FW_UPDATE_CHANNELS, FW_UPDATE_CHANNELS_COUNT},
+#endif
+};
+
+enum ApiSettingKind {
+  API_INT,
+  API_BOOL,
+  API_FLOAT
+};
+
+struct ApiSetting {
+  const char* name; // same as form field of the built-in settings pages
+  Type type;
+  ApiSettingKind kind;
+  bool (*saveFun)(int);
+  void (*additionalFun)(void);
+  const char* options; // name in API_OPTIONS of the list the value is chosen from
+};
+
+// settings of brightness, colors, modes, sounds and firmware pages, "color_lamp" is handled separately
+static const ApiSetting API_SETTINGS[] = {
+  {"brightness", BRIGHTNESS, API_INT, saveBrightness, NULL},
+  {"brightness_day", BRIGHTNESS_DAY, API_INT, saveDayBrightness, NULL},
+  {"brightness_night", BRIGHTNESS_NIGHT, API_INT, saveNightBrightness, NULL},
+  {"day_start", DAY_START, API_INT, NULL, NULL},
+  {"night_start", NIGHT_START, API_INT, NULL, NULL},
+  {"brightness_auto", BRIGHTNESS_MODE, API_INT, saveAutoBrightnessMode, NULL, "brightness_auto"},
+  {"brightness_alert", BRIGHTNESS_ALERT, API_INT, NULL, NULL},
+  {"brightness_clear", BRIGHTNESS_CLEAR, API_INT, NULL, NULL},
+  {"brightness_new_alert", BRIGHTNESS_NEW_ALERT, API_INT, NULL, NULL},
+  {"brightness_alert_over", BRIGHTNESS_ALERT_OVER, API_INT, NULL, NULL},
+  {"brightness_explosion", BRIGHTNESS_EXPLOSION, API_INT, NULL, NULL},
+  {"brightness_home_district", BRIGHTNESS_HOME_DISTRICT, API_INT, NULL, NULL},
+  {"brightness_bg", BRIGHTNESS_BG, API_INT, NULL, NULL},
+  {"brightness_service", BRIGHTNESS_SERVICE, API_INT, NULL, checkServicePins},
+  {"light_sensor_factor", LIGHT_SENSOR_FACTOR, API_FLOAT, NULL, NULL},
+  {"dim_display_on_night", DIM_DISPLAY_ON_NIGHT, API_BOOL, NULL, updateDisplayBrightness},
+  {"color_alert", COLOR_ALERT, API_INT, NULL, NULL},
+  {"color_clear", COLOR_CLEAR, API_INT, NULL, NULL},
+  {"color_new_alert", COLOR_NEW_ALERT, API_INT, NULL, NULL},
+  {"color_alert_over", COLOR_ALERT_OVER, API_INT, NULL, NULL},
+  {"color_explosion", COLOR_EXPLOSION, API_INT, NULL, NULL},
+  {"color_missiles", COLOR_MISSILES, API_INT, NULL, NULL},
+  {"color_drones", COLOR_DRONES, API_INT, NULL, NULL},
+  {"color_home_district", COLOR_HOME_DISTRICT, API_INT, NULL, NULL},
+  {"color_bg_neighbor_alert", COLOR_BG_NEIGHBOR_ALERT, API_INT, NULL, NULL},
+  {"map_mode", MAP_MODE, API_INT, saveMapMode, NULL, "map_mode"},
+  {"brightness_lamp", HA_LIGHT_BRIGHTNESS, API_INT, saveLampBrightness, NULL},
+  {"display_mode", DISPLAY_MODE, API_INT, saveDisplayMode, NULL, "display_mode"},
+  {"home_district", HOME_DISTRICT, API_INT, saveHomeDistrict, NULL, "home_district"},
+  {"display_mode_time", DISPLAY_MODE_TIME, API_INT, NULL, NULL},
+  {"toggle_mode_weather", TOGGLE_MODE_WEATHER, API_BOOL, NULL, NULL},
+  {"toggle_mode_temp", TOGGLE_MODE_TEMP, API_BOOL, NULL, NULL},
+  {"toggle_mode_hum", TOGGLE_MODE_HUM, API_BOOL, NULL, NULL},
+  {"toggle_mode_press", TOGGLE_MODE_PRESS, API_BOOL, NULL, NULL},
+  {"temp_correction", TEMP_CORRECTION, API_FLOAT, NULL, climateSensorCycle},
+  {"hum_correction", HUM_CORRECTION, API_FLOAT, NULL, climateSensorCycle},
+  {"pressure_correction", PRESSURE_CORRECTION, API_FLOAT, NULL, climateSensorCycle},
+  {"weather_min_temp", WEATHER_MIN_TEMP, API_INT, NULL, NULL},
+  {"weather_max_temp", WEATHER_MAX_TEMP, API_INT, NULL, NULL},
+  {"button_mode", BUTTON_1_MODE, API_INT, NULL, NULL, "button_mode"},
+  {"button2_mode", BUTTON_2_MODE, API_INT, NULL, NULL, "button_mode"},
+  {"button_mode_long", BUTTON_1_MODE_LONG, API_INT, NULL, NULL, "button_mode_long"},
+  {"button2_mode_long", BUTTON_2_MODE_LONG, API_INT, NULL, NULL, "button_mode_long"},
+  {"kyiv_district_mode", KYIV_DISTRICT_MODE, API_INT, NULL, requestLedMappingUpdate, "kyiv_district_mode"},
+  {"home_alert_time", HOME_ALERT_TIME, API_BOOL, [](int value) { return saveShowHomeAlarmTime(value); }, NULL},
+  {"alarms_notify_mode", ALARMS_NOTIFY_MODE, API_INT, NULL, NULL, "alarms_notify_mode"},
+  {"enable_explosions", ENABLE_EXPLOSIONS, API_BOOL, NULL, NULL},
+  {"enable_missiles", ENABLE_MISSILES, API_BOOL, NULL, NULL},
+  {"enable_drones", ENABLE_DRONES, API_BOOL, NULL, NULL},
+  {"alert_on_time", ALERT_ON_TIME, API_INT, NULL, NULL},
+  {"alert_off_time", ALERT_OFF_TIME, API_INT, NULL, NULL},
+  {"explosion_time", EXPLOSION_TIME, API_INT, NULL, NULL},
+  {"alert_blink_time", ALERT_BLINK_TIME, API_INT, NULL, NULL},
+  {"frame_rate", FRAME_RATE, API_INT, NULL, NULL, "frame_rate"},
+  {"alarms_auto_switch", ALARMS_AUTO_SWITCH, API_INT, saveAutoAlarmMode, NULL, "alarms_auto_switch"},
+  {"service_diodes_mode", SERVICE_DIODES_MODE, API_BOOL, NULL, checkServicePins},
+  {"min_of_silence", MIN_OF_SILENCE, API_BOOL, NULL, NULL},
+  {"invert_display", INVERT_DISPLAY, API_BOOL, NULL, updateInvertDisplayMode},
+  {"time_zone", TIME_ZONE, API_INT, NULL, updateTimeZone},
+  {"sound_on_min_of_sl", SOUND_ON_MIN_OF_SL, API_BOOL, NULL, NULL},
+  {"sound_on_alert", SOUND_ON_ALERT, API_BOOL, NULL, NULL},
+  {"melody_on_alert", MELODY_ON_ALERT, API_INT, NULL, NULL, "melody"},
+  {"sound_on_alert_end", SOUND_ON_ALERT_END, API_BOOL, NULL, NULL},
+  {"melody_on_alert_end", MELODY_ON_ALERT_END, API_INT, NULL, NULL, "melody"},
+  {"sound_on_explosion", SOUND_ON_EXPLOSION, API_BOOL, NULL, NULL},
+  {"melody_on_explosion", MELODY_ON_EXPLOSION, API_INT, NULL, NULL, "melody"},
+  {"sound_on_every_hour", SOUND_ON_EVERY_HOUR, API_BOOL, NULL, NULL},
+  {"sound_on_button_click", SOUND_ON_BUTTON_CLICK, API_BOOL, NULL, NULL},
+  {"mute_sound_on_night", MUTE_SOUND_ON_NIGHT, API_BOOL, NULL, NULL},
+  {"ignore_mute_on_alert", IGNORE_MUTE_ON_ALERT, API_BOOL, NULL, NULL},
+  {"melody_volume", MELODY_VOLUME, API_INT, NULL, updateMelodyVolume},
+#if FW_UPDATE_ENABLED
+  {"new_fw_notification", NEW_FW_NOTIFICATION, API_BOOL, NULL, NULL},
+  {"fw_update_channel", FW_UPDATE_CHANNEL, API_INT, NULL, saveLatestFirmware, "fw_update_channel"},
+#endif
+};
+
+void sendJson(AsyncWebServerRequest* request, JsonDocument& doc, int code = 200) {
+  AsyncResponseStream* response = request->beginResponseStream("application/json");
+  response->addHeader("Cache-Control", "no-store");
+  serializeJson(doc, *response);
+  response->setCode(code);
+  request->send(response);
+}
+
+void sendApiError(AsyncWebServerRequest* request, int code, const char* error, const char* name = NULL) {
+  JsonDocument doc;
+  doc["error"] = error;
+  if (name) doc["name"] = name;
+  sendJson(request, doc, code);
+}
+
+const ApiSetting* findApiSetting(const char* name) {
+  for (const ApiSetting& setting : API_SETTINGS) {
+    if (strcmp(setting.name, name) == 0) return &setting;
+  }
+  return NULL;
+}
+
+const ApiOptions* findApiOptions(const char* name) {
+  for (const ApiOptions& options : API_OPTIONS) {
+    if (strcmp(options.name, name) == 0) return &options;
+  }
+  return NULL;
+}
+
+// value should be one of the shown options of select boxes and in range of the setting for sliders
+bool isApiValueValid(const ApiSetting& setting, JsonVariant value) {
+  switch (setting.kind) {
+    case API_BOOL:
+      return value.is<bool>() || (value.is<int>() && (value.as<int>() == 0 || value.as<int>() == 1));
+    case API_FLOAT:
+      return value.is<float>() && settings.isValidFloat(setting.type, value.as<float>());
+    case API_INT: {
+      if (!value.is<int>()) return false;
+      int newValue = value.as<int>();
+      const ApiOptions* options = setting.options ? findApiOptions(setting.options) : NULL;
+      if (options) {
+        bool found = false;
+        for (int i = 0; i < options->count; i++) {
+          if (options->items[i].id == newValue && !options->items[i].ignore) found = true;
+        }
+        if (!found) return false;
+      }
+      return settings.isValidInt(setting.type, newValue);
+    }
+  }
+  return false;
+}
+
+void fillApiSettings(JsonDocument& doc) {
+  for (const ApiSetting& setting : API_SETTINGS) {
+    switch (setting.kind) {
+      case API_INT:
+        doc[setting.name] = settings.getInt(setting.type);
+        break;
+      case API_BOOL:
+        doc[setting.name] = settings.getBool(setting.type);
+        break;
+      case API_FLOAT:
+        doc[setting.name] = settings.getFloat(setting.type);
+        break;
+    }
+  }
+  doc["color_lamp"] = rgb2hue(settings.getInt(HA_LIGHT_R), settings.getInt(HA_LIGHT_G), settings.getInt(HA_LIGHT_B));
+}
+
+bool saveApiSetting(const ApiSetting& setting, JsonVariant value) {
+  switch (setting.kind) {
+    case API_INT:
+    case API_BOOL: {
+      int newValue = setting.kind == API_BOOL ? value.as<bool>() : value.as<int>();
+      if (setting.saveFun) return setting.saveFun(newValue);
+      if (newValue == settings.getInt(setting.type)) return false;
+      settings.saveInt(setting.type, newValue);
+      if (setting.kind == API_BOOL) {
+        reportSettingsChange(setting.name, newValue ? "true" : "false");
+      } else {
+        reportSettingsChange(setting.name, newValue);
+      }
+      break;
+    }
+    case API_FLOAT: {
+      float newValue = value.as<float>();
+      if (newValue == settings.getFloat(setting.type)) return false;
+      settings.saveFloat(setting.type, newValue);
+      reportSettingsChange(setting.name, newValue);
+      break;
+    }
+  }
+  if (setting.additionalFun) setting.additionalFun();
+  return true;
+}
+
+void handleApiSettings(AsyncWebServerRequest* request) {
+  JsonDocument doc;
+  fillApiSettings(doc);
+  sendJson(request, doc);
+}
+
+// body is an object with changed settings only, unknown names or invalid values reject the whole request
+void handleApiSettingsPatch(AsyncWebServerRequest* request, JsonVariant& json) {
+  JsonObject changes = json.as<JsonObject>();
+  if (changes.isNull()) {
+    sendApiError(request, 400, "object expected");
+    return;
+  }
+  for (JsonPair change : changes) {
+    const char* name = change.key().c_str();
+    if (strcmp(name, "color_lamp") != 0 && !findApiSetting(name)) {
+      sendApiError(request, 400, "unknown setting", name);
+      return;
+    }
+    if (!change.value().is<int>() && !change.value().is<float>() && !change.value().is<bool>()) {
+      sendApiError(request, 400, "number or boolean expected", name);
+      return;
+    }
+    bool valid;
+    if (strcmp(name, "color_lamp") == 0) {
+      valid = change.value().is<int>() && change.value().as<int>() >= 0 && change.value().as<int>() <= 360;
+    } else {
+      valid = isApiValueValid(*findApiSetting(name), change.value());
+    }
+    if (!valid) {
+      sendApiError(request, 400, "invalid value", name);
+      return;
+    }
+  }
+  bool saved = false;
+  for (JsonPair change : changes) {
+    const char* name = change.key().c_str();
+    if (strcmp(name, "color_lamp") == 0) {
+      RGBColor rgb = hue2rgb(change.value().as<int>());
+      saved = saveLampRgb(rgb.r, rgb.g, rgb.b) || saved;
+      continue;
+    }
+    saved = saveApiSetting(*findApiSetting(name), change.value()) || saved;
+  }
+  if (saved) autoBrightnessUpdate();
+  JsonDocument doc;
+  fillApiSettings(doc);
+  sendJson(request, doc);
+}
+
+// option lists are a part of the firmware, so firmware version is their ETag
+void handleApiOptions(AsyncWebServerRequest* request) {
+  char eTag[30];
+  sprintf(eTag, "\"%s\"", currentFwVersion);
+  if (sendNotModified(request, eTag)) return;
+  JsonDocument doc;
+  for (const ApiOptions& options : API_OPTIONS) {
+    JsonArray items = doc[options.name].to<JsonArray>();
+    for (int i = 0; i < options.count; i++) {
+      if (options.items[i].ignore) continue;
+      JsonArray item = items.add<JsonArray>();
+      item.add(options.items[i].id);
+      item.add(options.items[i].name);
+    }
+  }
+  AsyncResponseStream* response = request->beginResponseStream("application/json");
+  response->addHeader("ETag", eTag);
+  response->addHeader("Cache-Control", "no-cache");
+  serializeJson(doc, *response);
+  request->send(response);
+}
+
+void handleApiState(AsyncWebServerRequest* request) {
+  JsonDocument doc;
+  doc["name"] = settings.getString(DEVICE_NAME);
+  doc["description"] = settings.getString(DEVICE_DESCRIPTION);
+  doc["version"] = currentFwVersion;
+  doc["ip"] = getLocalIP();
+  doc["server"] = settings.getString(WS_SERVER_HOST);
+  doc["uptime"] = millis() / 1000;
+  doc["free_heap"] = ESP.getFreeHeap();
+  doc["map_mode"] = getCurrentMapMode();
+  doc["brightness"] = settings.getInt(CURRENT_BRIGHTNESS);
+  doc["night_mode"] = getNightModeType();
+  doc["alarm_now"] = alarmNow;
+  doc["home_district"] = getNameById(DISTRICTS, settings.getInt(HOME_DISTRICT), DISTRICTS_COUNT);
+  doc["home_temperature"] = getRegionTemperature(settings.getInt(HOME_DISTRICT));
+  doc["server_connected"] = client_websocket.available();
+  if (ha.isHaEnabled()) doc["ha_connected"] = haConnected;
+#if FW_UPDATE_ENABLED
+  if (fwUpdateAvailable) doc["new_fw_version"] = newFwVersion;
+#endif
+  if (display.isDisplayAvailable()) doc["display_model"] = display.getDisplayModel();
+  if (lightSensor.isLightSensorEnabled()) doc["light_sensor_model"] = lightSensor.getSensorModel();
+  if (climate.isAnySensorEnabled()) doc["climate_sensor_model"] = climate.getSensorModel();
+  if (climate.isTemperatureAvailable()) doc["temperature"] = climate.getTemperature(settings.getFloat(TEMP_CORRECTION));
+  if (climate.isHumidityAvailable()) doc["humidity"] = climate.getHumidity(settings.getFloat(HUM_CORRECTION));
+  if (climate.isPressureAvailable()) doc["pressure"] = climate.getPressure(settings.getFloat(PRESSURE_CORRECTION));
+  // which settings make sense on this device, same conditions as on the built-in pages
+  JsonObject features = doc["features"].to<JsonObject>();
+  features["legacy"] = settings.getInt(LEGACY);
+  features["display"] = display.isDisplayAvailable();
+  features["climate"] = climate.isAnySensorAvailable();
+  features["temperature"] = climate.isTemperatureAvailable();
+  features["humidity"] = climate.isHumidityAvailable();
+  features["pressure"] = climate.isPressureAvailable();
+  features["light_sensor"] = lightSensor.isAnySensorAvailable();
+  features["button1"] = buttons.isButton1Enabled();
+  features["button2"] = buttons.isButton2Enabled();
+  features["bg_strip"] = isBgStripEnabled();
+  features["service_strip"] = isServiceStripEnabled();
+#if BUZZER_ENABLED
+  features["buzzer"] = isBuzzerEnabled();
+#else
+  features["buzzer"] = false;
+#endif
+  features["firmware_update"] = FW_UPDATE_ENABLED == 1;
+  sendJson(request, doc);
+}
+// Live state stream (server-sent events on /events). A new client gets the full state, then only
+// changed LEDs and regions are sent, at most once per LIVE_STATE_INTERVAL. Events:
+//   leds - {"main": [index, 0xRRGGBB, ...], "bg": [...], "service": [...]}, colors as shown on strips
+//   alerts - {"alerts": [region id, alert state, ...]}
+//   stats - uptime, heap, WiFi signal, frame rate, every LIVE_STATS_INTERVAL
+//   scheduler - {"jobs": [[name, runs, missed, max lateness ms, avg us, max us], ...]}, every LIVE_SCHEDULER_INTERVAL
+#define LIVE_STATE_INTERVAL 250 // ms
+#define LIVE_STATS_INTERVAL 1000 // ms
+#define LIVE_SCHEDULER_INTERVAL 5000 // ms
+#define LIVE_STATE_MAX_WAITING 8 // updates are skipped while clients have more packets waiting
+
+AsyncEventSource liveEvents("/events");
+// last sent state, compared with current one by loop task
+CRGB          sentStrip[MAIN_LEDS_COUNT];
+CRGB          sentBgStrip[100];
+CRGB          sentServiceStrip[5];
+uint8_t       sentAlertStates[REGION_SLOTS_COUNT];
+uint32_t      liveEventId = 0;
+unsigned long lastLiveStatsTime = 0;
+unsigned long lastLiveSchedulerTime = 0;
+
+// adds index and color of every LED that differs from sent one, all LEDs if sent is NULL
+void addLiveColors(JsonDocument& doc, const char* key, const CRGB colors[], CRGB sent[], int count) {
+  JsonArray changes;
+  for (int i = 0; i < count; i++) {
+    if (sent && sent[i] == colors[i]) continue;
+    if (changes.isNull()) changes = doc[key].to<JsonArray>();
+    changes.add(i);
+    changes.add(((uint32_t) colors[i].r << 16) | (colors[i].g << 8) | colors[i].b);
+    if (sent) sent[i] = colors[i];
+  }
+}
+
+// strips are read while render task may update them, a torn color is fixed by the next update
+bool fillLiveLeds(JsonDocument& doc, bool full) {
+  addLiveColors(doc, "main", shownStrip, full ? NULL : sentStrip, MAIN_LEDS_COUNT);
+  if (isBgStripEnabled()) {
+    addLiveColors(doc, "bg", shownBgStrip, full ? NULL : sentBgStrip, min(settings.getInt(BG_LED_COUNT), 100));
+  }
+  if (isServiceStripEnabled()) {
+    addLiveColors(doc, "service", shownServiceStrip, full ? NULL : sentServiceStrip, 5);
+  }
+  return doc.size() > 0;
+}
+
+bool fillLiveAlerts(JsonDocument& doc, bool full) {
+  JsonArray changes;
+  for (int slot = 0; slot < REGION_SLOTS_COUNT; slot++) {
+    uint8_t state = regionsState.alertState[slot];
+    if (!full && sentAlertStates[slot] == state) continue;
+    if (changes.isNull()) changes = doc["alerts"].to<JsonArray>();
+    changes.add(mapIndexToRegionId(slot));
+    changes.add(state);
+    if (!full) sentAlertStates[slot] = state;
+  }
+  return !changes.isNull();
+}
+
+void fillLiveStats(JsonDocument& doc) {
+  doc["uptime"] = millis() / 1000;
+  doc["heap"] = ESP.getFreeHeap();
+  doc["rssi"] = WiFi.RSSI();
+  doc["fps"] = frameClock.getAchievedFps();
+  doc["alarm_now"] = alarmNow;
+  doc["server_connected"] = client_websocket.available();
+}
+
+void fillLiveScheduler(JsonDocument& doc) {
+  JsonArray jobs = doc["jobs"].to<JsonArray>();
+  for (int id = 0; id < SCHEDULER_MAX_JOBS; id++) {
+    JaamScheduler::JobStats stats;
+    if (!scheduler.getJobStats(id, &stats)) continue;
+    JsonArray job = jobs.add<JsonArray>();
+    job.add(stats.name);
+    job.add(stats.runs);
+    job.add(stats.missed);
+    job.add(stats.maxLateness / 1000);
+    job.add((uint32_t) (stats.runs > 0 ? stats.totalRunTime / stats.runs : 0));
+    job.add(stats.maxRunTime);
+  }
+}
+
+void sendLiveEvent(AsyncEventSourceClient* client, JsonDocument& doc, const char* event) {
+  String message;
+  serializeJson(doc, message);
+  if (client) {
+    client->send(message.c_str(), event, ++liveEventId);
+  } else {
+    liveEvents.send(message.c_str(), event, ++liveEventId);
+  }
+}
+
+// runs in web server task, so only reads state, sent state is updated by loop task
+void onLiveEventsConnect(AsyncEventSourceClient* client) {
+  JsonDocument leds;
+  fillLiveLeds(leds, true);
+  sendLiveEvent(client, leds, "leds");
+  JsonDocument alerts;
+  fillLiveAlerts(alerts, true);
+  sendLiveEvent(client, alerts, "alerts");
+  JsonDocument stats;
+  fillLiveStats(stats);
+  sendLiveEvent(client, stats, "stats");
+}
+
+void liveStateCycle() {
+  // without clients sent state is left behind and new clients get full state anyway
+  if (liveEvents.count() == 0 || liveEvents.avgPacketsWaiting() > LIVE_STATE_MAX_WAITING) return;
+  JsonDocument leds;
+  if (fillLiveLeds(leds, false)) sendLiveEvent(NULL, leds, "leds");
+  JsonDocument alerts;
+  if (fillLiveAlerts(alerts, false)) sendLiveEvent(NULL, alerts, "alerts");
+  if (millis() - lastLiveStatsTime >= LIVE_STATS_INTERVAL) {
+    lastLiveStatsTime = millis();
+    JsonDocument stats;
+    fillLiveStats(stats);
+    sendLiveEvent(NULL, stats, "stats");
+  }
+  if (millis() - lastLiveSchedulerTime >= LIVE_SCHEDULER_INTERVAL) {
+    lastLiveSchedulerTime = millis();
+    JsonDocument jobs;
+    fillLiveScheduler(jobs);
+    sendLiveEvent(NULL, jobs, "scheduler");
+  }
+}
+
+// Map preview, drawn in the browser from the device framebuffer instead of the map picture from the server.
+// Framebuffer format (version 1), little endian:
+//   [0] version, [1] main LEDs count, [2] background LEDs count, [3] service LEDs count, [4] map mode,
+//   region id of every main LED (int16, -1 if LED is not used), RGB of main, background and service LEDs
+#define FRAMEBUFFER_VERSION 1
+
+// Draws LEDs from /framebuffer into svg element at approximate region centers and updates colors from /events
+static const char MAP_SCRIPT[] PROGMEM =
+  "function jaamMap(svg) {\n"
+  "  const NS = 'http://www.w3.org/2000/svg';\n"
+  "  const REGIONS = {\n"
+  "    9999: [34.1, 45.3, 'АР Крим'], 4: [28.5, 49.1, 'Вінницька'], 8: [25.0, 51.2, 'Волинська'],\n"
+  "    9: [35.0, 48.3, 'Дніпропетровська'], 28: [37.8, 48.0, 'Донецька'], 10: [28.5, 50.6, 'Житомирська'],\n"
+  "    11: [23.0, 48.4, 'Закарпатська'], 12: [35.6, 47.3, 'Запорізька'], 13: [24.6, 48.7, 'Ів.-Франківська'],\n"
+  "    14: [30.9, 50.0, 'Київська'], 31: [30.5, 50.5, 'Київ'], 15: [32.3, 48.4, 'Кіровоградська'],\n"
+  "    16: [39.2, 48.7, 'Луганська'], 27: [24.0, 49.7, 'Львівська'], 17: [31.9, 47.3, 'Миколаївська'],\n"
+  "    18: [30.0, 46.7, 'Одеська'], 19: [34.0, 49.6, 'Полтавська'], 5: [26.3, 51.0, 'Рівненська'],\n"
+  "    20: [34.4, 51.1, 'Сумська'], 21: [25.6, 49.4, 'Тернопільська'], 22: [36.4, 49.6, 'Харківська'],\n"
+  "    23: [33.4, 46.6, 'Херсонська'], 3: [26.9, 49.5, 'Хмельницька'], 24: [31.5, 49.2, 'Черкаська'],\n"
+  "    26: [25.9, 48.3, 'Чернівецька'], 25: [32.0, 51.4, 'Чернігівська'],\n"
+  "  };\n"
+  "  const WIDTH = 490;\n"
+  "  const leds = { main: [], bg: [], service: [] };\n"
+  "  function add(tag, attrs, title) {\n"
+  "    const node = document.createElementNS(NS, tag);\n"
+  "    for (const name in attrs) node.setAttribute(name, attrs[name]);\n"
+  "    const tooltip = document.createElementNS(NS, 'title');\n"
+  "    tooltip.textContent = title;\n"
+  "    node.appendChild(tooltip);\n"
+  "    svg.appendChild(node);\n"
+  "    return node;\n"
+  "  }\n"
+  "  function paint(led, color) {\n"
+  "    if (led) led.setAttribute('fill', '#' + color.toString(16).padStart(6, '0'));\n"
+  "  }\n"
+  "  fetch('/framebuffer').then((response) => response.arrayBuffer()).then((buffer) => {\n"
+  "    const data = new DataView(buffer);\n"
+  "    let offset = 5;\n"
+  "    let height = 340;\n"
+  "    const regionLeds = {};\n"
+  "    const unused = [];\n"
+  "    for (let i = 0; i < data.getUint8(1); i++, offset += 2) {\n"
+  "      const region = REGIONS[data.getInt16(offset, true)];\n"
+  "      if (!region) {\n"
+  "        unused.push(i);\n"
+  "        continue;\n"
+  "      }\n"
+  "      const shift = (regionLeds[region[2]] = (regionLeds[region[2]] || 0) + 1) - 1;\n"
+  "      leds.main[i] = add('circle', { cx: (region[0] - 22) * 26 + shift * 14, cy: (52.6 - region[1]) * 40, r: 6 }, i + ': ' + region[2]);\n"
+  "    }\n"
+  "    unused.forEach((led, index) => (leds.main[led] = add('circle', { cx: 10 + index * 16, cy: height, r: 6 }, led + ': -')));\n"
+  "    if (unused.length) height += 16;\n"
+  "    for (const [name, count] of [['bg', data.getUint8(2)], ['service', data.getUint8(3)]]) {\n"
+  "      if (!count) continue;\n"
+  "      const size = Math.min(WIDTH / count, 16);\n"
+  "      for (let i = 0; i < count; i++) leds[name].push(add('rect', { x: i * size, y: height, width: size - 1, height: 8 }, name + ' ' + i));\n"
+  "      height += 12;\n"
+  "    }\n"
+  "    svg.setAttribute('viewBox', '0 0 ' + WIDTH + ' ' + height);\n"
+  "    for (const name of ['main', 'bg', 'service']) {\n"
+  "      for (let i = 0; i < leds[name].length; i++, offset += 3) {\n"
+  "        paint(leds[name][i], (data.getUint8(offset) << 16) | (data.getUint8(offset + 1) << 8) | data.getUint8(offset + 2));\n"
+  "      }\n"
+  "    }\n"
+  "    new EventSource('/events').addEventListener('leds', (event) => {\n"
+  "      const changes = JSON.parse(event.data);\n"
+  "      for (const name in changes) {\n"
+  "        for (let i = 0; i < changes[name].length; i += 2) paint(leds[name][changes[name][i]], changes[name][i + 1]);\n"
+  "      }\n"
+  "    });\n"
+  "  });\n"
+  "}\n";
+
+void handleMapScript(AsyncWebServerRequest* request) {
+  // script is a part of the firmware, so firmware version is its ETag
+  char eTag[30];
+  sprintf(eTag, "\"%s\"", currentFwVersion);
+  if (sendNotModified(request, eTag)) return;
+  AsyncWebServerResponse* response = request->beginResponse_P(200, "application/javascript", MAP_SCRIPT);
+  response->addHeader("ETag", eTag);
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
+}
+
+// strips are read while render task may update them, a torn color is fixed by the next /events update
+void handleFramebuffer(AsyncWebServerRequest* request) {
+  uint8_t bgCount = isBgStripEnabled() ? min(settings.getInt(BG_LED_COUNT), 100) : 0;
+  uint8_t serviceCount = isServiceStripEnabled() ? 5 : 0;
+  AsyncResponseStream* response = request->beginResponseStream("application/octet-stream");
+  response->addHeader("Cache-Control", "no-store");
+  uint8_t header[] = {FRAMEBUFFER_VERSION, MAIN_LEDS_COUNT, bgCount, serviceCount, (uint8_t) getCurrentMapMode()};
+  response->write(header, sizeof(header));
+  for (int led = 0; led < MAIN_LEDS_COUNT; led++) {
+    int slot = ledLayout.ledSlots[led];
+    int16_t regionId = slot < 0 ? -1 : mapIndexToRegionId(slot);
+    uint8_t bytes[] = {(uint8_t) (regionId & 0xFF), (uint8_t) (regionId >> 8)};
+    response->write(bytes, sizeof(bytes));
+  }
+  response->write((const uint8_t*) shownStrip, MAIN_LEDS_COUNT * sizeof(CRGB));
+  response->write((const uint8_t*) shownBgStrip, bgCount * sizeof(CRGB));
+  response->write((const uint8_t*) shownServiceStrip, serviceCount * sizeof(CRGB));
+  request->send(response);
+}
+
 void setupRouting() {
   LOG.println("Init WebServer");
+  initWebApp();
   webserver.on("/", HTTP_GET, handleRoot);
   webserver.on("/brightness", HTTP_GET, handleBrightness);
   webserver.on("/saveBrightness", HTTP_POST, handleSaveBrightness);
@@ -2803,6 +3866,13 @@ void setupRouting() {
 #endif
   webserver.on("/telemetry", HTTP_GET, handleTelemetry);
   webserver.on("/refreshTelemetry", HTTP_POST, handleRefreshTelemetry);
+  webserver.on("/runBenchmark", HTTP_POST, handleRunBenchmark);
+  webserver.on("/saveBenchmarkBaseline", HTTP_POST, handleSaveBenchmarkBaseline);
+  webserver.on("/traceCapture", HTTP_POST, handleTraceCapture);
+  webserver.on("/traceStop", HTTP_POST, handleTraceStop);
+  webserver.on("/traceReplay", HTTP_POST, handleTraceReplay);
+  webserver.on("/trace", HTTP_GET, handleTraceDownload);
+  webserver.on("/traceUpload", HTTP_POST, handleTraceUpload, handleTraceUploadBody, NULL);
   webserver.on("/dev", HTTP_GET, handleDev);
   webserver.on("/saveDev", HTTP_POST, handleSaveDev);
 #if FW_UPDATE_ENABLED
@@ -2817,6 +3887,17 @@ void setupRouting() {
 #endif
   webserver.on("/backup", HTTP_GET, handleBackup);
   webserver.on("/restore", HTTP_POST, handleRestore, handleRestoreBody, NULL);
+  webserver.on("/framebuffer", HTTP_GET, handleFramebuffer);
+  webserver.on("/map.js", HTTP_GET, handleMapScript);
+  webserver.on("/api/state", HTTP_GET, handleApiState);
+  webserver.on("/api/settings", HTTP_GET, handleApiSettings);
+  webserver.on("/api/options", HTTP_GET, handleApiOptions);
+  AsyncCallbackJsonWebHandler* settingsHandler = new AsyncCallbackJsonWebHandler("/api/settings", handleApiSettingsPatch);
+  settingsHandler->setMethod(HTTP_PATCH);
+  settingsHandler->setMaxContentLength(API_MAX_BODY_SIZE);
+  webserver.addHandler(settingsHandler);
+  liveEvents.onConnect(onLiveEventsConnect);
+  webserver.addHandler(&liveEvents);
   webserver.begin();
   LOG.println("Webportal running");
 }
@@ -2838,6 +3919,12 @@ void uptime() {
   ha.setFreeMemory(freeHeapSize);
   ha.setUsedMemory(usedHeapSize);
   ha.setCpuTemp(cpuTemp);
+  ha.setSchedulerMissedDeadlines(scheduler.getMissedDeadlines());
+  ha.setSchedulerSlowestJob(scheduler.getSlowestJob());
+  // full latency is known only with server send time, otherwise device part is reported
+  JaamLatencyStats::Stage latencyStage = latencyStats.getSummary(JaamLatencyStats::TOTAL).count > 0 ? JaamLatencyStats::TOTAL : JaamLatencyStats::DEVICE;
+  JaamLatencyStats::Summary latency = latencyStats.getSummary(latencyStage);
+  if (latency.count > 0) ha.setAlertLatency(latency.p50 / 1000.0f, latency.p99 / 1000.0f);
 }
 
 void connectStatuses() {
@@ -2860,11 +3947,11 @@ void connectStatuses() {
 
 //--Service messages end
 
-static JsonDocument parseJson(const char* payload) {
+static JsonDocument parseJson(const char* payload, size_t length) {
   JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, payload);
+  DeserializationError error = deserializeJson(doc, payload, length);
   if (error) {
-    LOG.printf("Deserialization error: $s\n", error.f_str());
+    LOG.printf("Deserialization error: %s\n", error.c_str());
     return doc;
   } else {
     return doc;
@@ -2902,7 +3989,7 @@ void alertPinCycle() {
     setAlertPin();
     long timeoutMs = settings.getFloat(ALERT_CLEAR_PIN_TIME) * 1000;
     LOG.printf("Alert pin will be disabled in %d ms\n", timeoutMs);
-    asyncEngine.setTimeout(disableAlertPin, timeoutMs);
+    scheduler.setTimeout(disableAlertPin, timeoutMs, "disableAlertPin", JaamScheduler::PRIORITY_HIGH);
   }
   if (isClearPinEnabled() && settings.getInt(ALERT_CLEAR_PIN_MODE) == 1 && !alarmNow && pinAlarmNow) {
     pinAlarmNow = false;
@@ -2913,13 +4000,13 @@ void alertPinCycle() {
     setClearPin();
     long timeoutMs = settings.getFloat(ALERT_CLEAR_PIN_TIME) * 1000;
     LOG.printf("Clear pin will be disabled in %d ms\n", timeoutMs);
-    asyncEngine.setTimeout(disableClearPin, timeoutMs);
+    scheduler.setTimeout(disableClearPin, timeoutMs, "disableClearPin", JaamScheduler::PRIORITY_HIGH);
   }
 }
 
 void checkHomeDistrictAlerts() {
-  int ledStatus = id_to_alerts[settings.getInt(HOME_DISTRICT)].first;
-  long localHomeExplosions = id_to_explosions[settings.getInt(HOME_DISTRICT)];
+  int ledStatus = getRegionAlertState(settings.getInt(HOME_DISTRICT));
+  long localHomeExplosions = getRegionExplosionTime(settings.getInt(HOME_DISTRICT));
   bool localAlarmNow = ledStatus == 1;
   const char* districtName = getNameById(DISTRICTS, settings.getInt(HOME_DISTRICT), DISTRICTS_COUNT);
   if (localAlarmNow != alarmNow) {
@@ -2947,61 +4034,295 @@ void checkHomeDistrictAlerts() {
 
 //--Websocket process start
 
-void onMessageCallback(WebsocketsMessage message) {
+// sends current values of given payload type to render task, if queue is full they are sent on next try
+void publishRegionsUpdate(JaamPayloadParser::Payload payload, uint32_t changedSlots) {
+  changedSlots |= unpublishedSlots[payload];
+  if (!changedSlots) return;
+  RegionsUpdate update;
+  update.payload = payload;
+  update.changedSlots = changedSlots;
+  update.receivedAt = frameReceivedAt;
+  update.parsedAt = esp_timer_get_time();
+  update.networkLatency = frameNetworkLatency;
+  switch (payload) {
+    case JaamPayloadParser::ALERTS:
+      memcpy(update.alertState, regionsState.alertState, sizeof(update.alertState));
+      memcpy(update.times, regionsState.alertTime, sizeof(update.times));
+      break;
+    case JaamPayloadParser::WEATHER:
+      memcpy(update.temperature, regionsState.temperature, sizeof(update.temperature));
+      break;
+    case JaamPayloadParser::EXPLOSIONS:
+      memcpy(update.times, regionsState.explosionTime, sizeof(update.times));
+      break;
+    case JaamPayloadParser::MISSILES:
+      memcpy(update.times, regionsState.missilesTime, sizeof(update.times));
+      break;
+    case JaamPayloadParser::DRONES:
+      memcpy(update.times, regionsState.dronesTime, sizeof(update.times));
+      break;
+    default:
+      return;
+  }
+  unpublishedSlots[payload] = regionsUpdates.push(update) ? 0 : changedSlots;
+}
+
+// restored state may be too old after long power off, it is checked by network task (owner of regionsState)
+// until fresh data arrives, cleared state reaches render task as regular updates
+void checkWarmStartAge() {
+  if (!provisionalState || traceMode == TRACE_REPLAY || timeClient.status() != UNIX_OK) return;
+  long age = (long) timeClient.unixGMT() - warmStartTime;
+  if (age <= WARM_START_MAX_AGE) return;
+  LOG.printf("Restored state is too old (%ld s), dropped\n", age);
+  regionsState = AlarmsState<REGION_SLOTS_COUNT>();
+  provisionalState = false;
+  publishRegionsUpdate(JaamPayloadParser::ALERTS, ALL_REGION_SLOTS);
+  publishRegionsUpdate(JaamPayloadParser::WEATHER, ALL_REGION_SLOTS);
+  publishRegionsUpdate(JaamPayloadParser::EXPLOSIONS, ALL_REGION_SLOTS);
+  publishRegionsUpdate(JaamPayloadParser::MISSILES, ALL_REGION_SLOTS);
+  publishRegionsUpdate(JaamPayloadParser::DRONES, ALL_REGION_SLOTS);
+}
+
+void publishPendingRegionsUpdates() {
+  for (int payload = 0; payload <= JaamPayloadParser::TEST_BINS; payload++) {
+    if (unpublishedSlots[payload]) publishRegionsUpdate((JaamPayloadParser::Payload) payload, 0);
+  }
+}
+
+// keeps applied data in RTC memory for warm start, flash copy is written by commitIfDue()
+void saveWarmStartState() {
+  WarmStartState state;
+  // padding is a part of the checksum, so it should be the same for the same data
+  memset(&state, 0, sizeof(state));
+  state.savedAt = timeClient.unixGMT();
+  for (int slot = 0; slot < REGION_SLOTS_COUNT; slot++) {
+    state.alertTime[slot] = regionsState.alertTime[slot];
+    state.explosionTime[slot] = regionsState.explosionTime[slot];
+    state.missilesTime[slot] = regionsState.missilesTime[slot];
+    state.dronesTime[slot] = regionsState.dronesTime[slot];
+    state.temperature[slot] = lroundf(regionsState.temperature[slot] * 10);
+    state.alertState[slot] = regionsState.alertState[slot];
+  }
+  stateStore.save(&state, sizeof(state));
+}
+
+// fresh data replaces restored state
+void onRegionsDataReceived() {
+  // replayed data is not a real state
+  if (traceMode == TRACE_REPLAY) return;
+  if (provisionalState) {
+    LOG.println("Restored state is replaced by fresh data");
+    provisionalState = false;
+  }
+  saveWarmStartState();
+}
+
+void requestResync(JaamDeltaDecoder::Type type) {
+  deltaResyncs++;
+  char resyncInfo[15];
+  sprintf(resyncInfo, "resync:%d", type);
+  LOG.println(resyncInfo);
+  // replayed frames are not from the server the socket is connected to
+  if (traceMode == TRACE_REPLAY) return;
+  client_websocket.send(resyncInfo);
+}
+
+// server compares hash with values it sent and sends a new snapshot if they differ
+void reportStateHash(JaamDeltaDecoder& decoder) {
+  uint32_t hash;
+  if (traceMode == TRACE_REPLAY || !getStateHash(decoder, regionsState, &hash)) return;
+  char hashInfo[45];
+  sprintf(hashInfo, "state_hash:%d,%u,%u", decoder.getType(), decoder.getSequence(), hash);
+  LOG.println(hashInfo);
+  client_websocket.send(hashInfo);
+}
+
+// applies binary delta frame to regionsState, returns type of applied data
+JaamPayloadParser::Payload onDeltaFrame(JaamDeltaDecoder& decoder) {
+  JaamDeltaDecoder::Type type = decoder.getType();
+  uint32_t sequence = decoder.getSequence();
+  LOG.printf("Got %s frame: type %d, sequence %u, %d records\n", decoder.isSnapshot() ? "snapshot" : "delta", type, sequence, decoder.getCount());
+  switch (deltaSequence.check(decoder)) {
+    case JaamDeltaSequence::NO_SNAPSHOT:
+      LOG.println("Delta frame without snapshot, skipped");
+      return JaamPayloadParser::UNKNOWN;
+    case JaamDeltaSequence::OUTDATED:
+      LOG.println("Outdated delta frame, skipped");
+      return JaamPayloadParser::UNKNOWN;
+    case JaamDeltaSequence::GAP:
+      LOG.println("Delta frames gap, resync requested");
+      deltaGaps++;
+      requestResync(type);
+      return JaamPayloadParser::UNKNOWN;
+    case JaamDeltaSequence::APPLY:
+      break;
+  }
+  uint32_t changedSlots;
+  JaamPayloadParser::Payload payload = applyDeltaFrame(decoder, regionsState, &changedSlots);
+  if (payload == JaamPayloadParser::UNKNOWN) return payload;
+  publishRegionsUpdate(payload, changedSlots);
+  if (payload == JaamPayloadParser::WEATHER) ha.setHomeTemperature(getRegionTemperature(settings.getInt(HOME_DISTRICT)));
+  reportStateHash(decoder);
+  return payload;
+}
+
+// NTP client gives whole seconds, milliseconds are counted from the moment the second changed.
+// Network task updates it every loop, so error is about NETWORK_TASK_DELAY plus NTP error.
+void updateUnixClock() {
+  unix_t second = timeClient.unixGMT();
+  if (second == unixClockSecond) return;
+  unixClockSecond = second;
+  unixClockSecondStart = millis();
+}
+
+// returns 0 if time is not synced
+int64_t getUnixMillis() {
+  if (timeClient.status() != UNIX_OK) return 0;
+  updateUnixClock();
+  unsigned long millisInSecond = min(millis() - unixClockSecondStart, 999UL);
+  return (int64_t) unixClockSecond * 1000 + millisInSecond;
+}
+
+// returns -1 if frame has no send time or time is not synced, negative latency (clock skew) is counted as 0
+int32_t getNetworkLatency(uint64_t sentTime) {
+  int64_t now = getUnixMillis();
+  if (sentTime == 0 || now == 0) return -1;
+  return constrain(now - (int64_t) sentTime, (int64_t) 0, (int64_t) 2000000) * 1000;
+}
+
+// parses frame and applies its data to regionsState, used for received and replayed frames
+void ingestMessage(const char* data, size_t length) {
+  StageTimer timer(JaamProfiler::WS_MESSAGE);
+  JaamDeltaDecoder decoder((const uint8_t*) data, length);
+  if (decoder.isValid()) {
+    if (onDeltaFrame(decoder) != JaamPayloadParser::UNKNOWN) onRegionsDataReceived();
+    return;
+  }
   LOG.print("Got Message: ");
-  LOG.println(message.data());
-  JsonDocument data = parseJson(message.data().c_str());
-  String payload = data["payload"];
-  if (!payload.isEmpty()) {
-    if (payload == "ping") {
+  LOG.write((const uint8_t*) data, length);
+  LOG.println();
+  JaamPayloadParser parser(data, length);
+  switch (parser.getPayload()) {
+    case JaamPayloadParser::PING:
       LOG.println("Heartbeat from server");
       websocketLastPingTime = millis();
-    } else if (payload == "alerts") {
-      for (int i = 0; i < MAIN_LEDS_COUNT; ++i) {
-        id_to_alerts[mapIndexToRegionId(i)] = std::make_pair((uint8_t) data["alerts"][i][0], (long) data["alerts"][i][1]);
-      }
-      LOG.println("Successfully parsed alerts data");
-      remapAlerts();
-    } else if (payload == "weather") {
-      for (int i = 0; i < MAIN_LEDS_COUNT; ++i) {
-        id_to_weather[mapIndexToRegionId(i)] = data["weather"][i];
-      }
-      LOG.println("Successfully parsed weather data");
-      remapWeather();
-      ha.setHomeTemperature(id_to_weather[settings.getInt(HOME_DISTRICT) ]);
-    } else if (payload == "explosions") {
-      for (int i = 0; i < MAIN_LEDS_COUNT; ++i) {
-        id_to_explosions[mapIndexToRegionId(i)] = data["explosions"][i];
-      }
-      LOG.println("Successfully parsed explosions data");
-      remapExplosions();
-    } else if (payload == "missiles") {
-      for (int i = 0; i < MAIN_LEDS_COUNT; ++i) {
-        id_to_missiles[mapIndexToRegionId(i)] = data["missiles"][i];
-      }
-      LOG.println("Successfully parsed missiles data");
-      remapMissiles();
-    } else if (payload == "drones") {
-      for (int i = 0; i < MAIN_LEDS_COUNT; ++i) {
-        id_to_drones[mapIndexToRegionId(i)] = data["drones"][i];
-      }
-      LOG.println("Successfully parsed drones data");
-      remapDrones();
+      break;
+    case JaamPayloadParser::ALERTS:
+    case JaamPayloadParser::WEATHER:
+    case JaamPayloadParser::EXPLOSIONS:
+    case JaamPayloadParser::MISSILES:
+    case JaamPayloadParser::DRONES: {
+      uint32_t changedSlots;
+      JaamPayloadParser::Payload payload = applyJsonPayload(parser, regionsState, &changedSlots);
+      if (payload == JaamPayloadParser::UNKNOWN) break;
+      publishRegionsUpdate(payload, changedSlots);
+      if (payload == JaamPayloadParser::WEATHER) ha.setHomeTemperature(getRegionTemperature(settings.getInt(HOME_DISTRICT)));
+      onRegionsDataReceived();
+      break;
+    }
 #if FW_UPDATE_ENABLED
-    } else if (payload == "bins") {
-      fillBinList(data, "bins", bin_list, &binsCount);
+    // bins lists are rare and not strict JSON (single quoted strings), so they still go through ArduinoJson
+    case JaamPayloadParser::BINS: {
+      JsonDocument binsData = parseJson(data, length);
+      fillBinList(binsData, "bins", bin_list, &binsCount);
       saveLatestFirmware();
-    } else if (payload == "test_bins") {
-      fillBinList(data, "test_bins", test_bin_list, &testBinsCount);
+      break;
+    }
+    case JaamPayloadParser::TEST_BINS: {
+      JsonDocument binsData = parseJson(data, length);
+      fillBinList(binsData, "test_bins", test_bin_list, &testBinsCount);
       saveLatestFirmware();
-#endif
+      break;
     }
+#endif
+    default:
+      break;
+  }
+}
+
+JaamPayloadParser::Payload getDeltaPayload(JaamDeltaDecoder::Type type) {
+  switch (type) {
+    case JaamDeltaDecoder::ALERTS:
+      return JaamPayloadParser::ALERTS;
+    case JaamDeltaDecoder::EXPLOSIONS:
+      return JaamPayloadParser::EXPLOSIONS;
+    case JaamDeltaDecoder::MISSILES:
+      return JaamPayloadParser::MISSILES;
+    case JaamDeltaDecoder::DRONES:
+      return JaamPayloadParser::DRONES;
+    case JaamDeltaDecoder::WEATHER:
+      return JaamPayloadParser::WEATHER;
+    default:
+      return JaamPayloadParser::UNKNOWN;
+  }
+}
+
+// payload type of the frame for queue coalescing, fullState is set if frame replaces all slots of this type
+JaamPayloadParser::Payload getFramePayload(const char* data, size_t length, bool* fullState) {
+  JaamDeltaDecoder decoder((const uint8_t*) data, length);
+  if (decoder.isValid()) {
+    *fullState = decoder.isSnapshot();
+    return getDeltaPayload(decoder.getType());
   }
+  JaamPayloadParser::Payload payload = JaamPayloadParser(data, length).getPayload();
+  // JSON data frames always carry all slots
+  *fullState = payload >= JaamPayloadParser::ALERTS && payload <= JaamPayloadParser::DRONES;
+  return payload;
+}
+
+void applyFrame(const char* data, size_t length, const FrameMeta& meta) {
+  frameReceivedAt = meta.receivedAt;
+  frameNetworkLatency = meta.networkLatency;
+  ingestMessage(data, length);
+  frameReceivedAt = 0;
+  frameNetworkLatency = -1;
+}
+
+// apply stage, run by network task after websocket poll
+void applyQueuedFrames() {
+  FrameQueue::Frame frame;
+  bool applied = false;
+  while (frameQueue.front(frame)) {
+    applyFrame((const char*) frame.data, frame.length, frame.meta);
+    frameQueue.pop();
+    applied = true;
+  }
+  if (applied) regionsDataApplied = true;
+}
+
+// side effects of applied data are run by loop task, so slow display, buzzer and pins do not hold websocket
+void regionsDataProcess() {
+  if (!regionsDataApplied.exchange(false)) return;
   checkHomeDistrictAlerts();
   alertPinCycle();
   isFirstDataFetchCompleted = true;
 }
 
+void onMessageCallback(WebsocketsMessage message) {
+  const std::string& rawData = message.rawData();
+  if (traceMode == TRACE_CAPTURE) {
+    traceBuffer.add(millis(), (const uint8_t*) rawData.data(), rawData.size());
+  }
+  if (traceMode == TRACE_REPLAY) {
+    // received data would be mixed with replayed one, connection is reopened for fresh data after replay
+    websocketLastPingTime = millis();
+    return;
+  }
+  FrameMeta meta;
+  meta.receivedAt = esp_timer_get_time();
+  meta.networkLatency = getNetworkLatency(JaamDeltaDecoder((const uint8_t*) rawData.data(), rawData.size()).getSentTime());
+  bool fullState;
+  JaamPayloadParser::Payload payload = getFramePayload(rawData.data(), rawData.size(), &fullState);
+  if (frameQueue.push((const uint8_t*) rawData.data(), rawData.size(), payload, fullState, meta)) return;
+  // both ends of the queue are in this task, so it is drained here to keep frames order
+  frameQueueOverflows++;
+  applyQueuedFrames();
+  if (!frameQueue.push((const uint8_t*) rawData.data(), rawData.size(), payload, fullState, meta)) {
+    applyFrame(rawData.data(), rawData.size(), meta);
+    regionsDataApplied = true;
+  }
+}
+
 void onEventsCallback(WebsocketsEvent event, String data) {
   if (event == WebsocketsEvent::ConnectionOpened) {
     apiConnected = true;
@@ -3022,11 +4343,12 @@ void onEventsCallback(WebsocketsEvent event, String data) {
   }
 }
 
-void socketConnect() {
+bool socketConnect() {
   LOG.println("connection start...");
   showServiceMessage("підключення...", "Сервер даних");
   client_websocket.onMessage(onMessageCallback);
   client_websocket.onEvent(onEventsCallback);
+  deltaSequence.reset();
   long startTime = millis();
   char webSocketUrl[100];
   sprintf(
@@ -3062,111 +4384,201 @@ void socketConnect() {
     userInfoJson["sht2x"] = climate.isSHT2XAvailable();
     userInfoJson["sht3x"] = climate.isSHT3XAvailable();
     userInfoJson["ha"] = ha.isHaAvailable();
+    userInfoJson["protocol"] = WS_PROTOCOL_VERSION;
     sprintf(userInfo, "user_info:%s", userInfoJson.as<String>().c_str());
     LOG.println(userInfo);
     client_websocket.send(userInfo);
     client_websocket.ping();
     websocketReconnect = false;
     showServiceMessage("підключено!", "Сервер даних", 3000);
+    return true;
   } else {
     showServiceMessage("недоступний", "Сервер даних", 3000);
+    return false;
   }
 }
 
+bool resolveWebsocketHost() {
+  IPAddress serverIp;
+  if (!WiFi.hostByName(settings.getString(WS_SERVER_HOST), serverIp)) {
+    LOG.printf("Unable to resolve %s\n", settings.getString(WS_SERVER_HOST));
+    return false;
+  }
+  LOG.printf("%s resolved to %s\n", settings.getString(WS_SERVER_HOST), serverIp.toString().c_str());
+  websocketTcpClient->setServerIp(serverIp);
+  websocketServerIpTime = millis();
+  return true;
+}
+
+void scheduleWebsocketReconnect() {
+  uint32_t delay = websocketBackoff.nextDelay();
+  LOG.printf("Websocket reconnect attempt %u in %u ms\n", websocketBackoff.getAttempts(), delay);
+  websocketNextAttemptTime = millis() + delay;
+  websocketState = WS_WAITING;
+}
+
+// connection state machine, one blocking step (resolve or connect) per call, so network task
+// keeps serving other clients between steps and rendering is not affected at all
 void websocketProcess() {
-  if (millis() - websocketLastPingTime > settings.getInt(WS_ALERT_TIME)) {
+  unsigned long now = millis();
+  if (now - websocketLastPingTime > settings.getInt(WS_ALERT_TIME)) {
     websocketReconnect = true;
   }
-  if (millis() - websocketLastPingTime > settings.getInt(WS_REBOOT_TIME)) {
+  // server outage is waited out with backoff, reboot only helps when device itself can not reach network
+  if (now - websocketLastPingTime > settings.getInt(WS_REBOOT_TIME) && now - websocketServerIpTime > settings.getInt(WS_REBOOT_TIME)) {
     rebootDevice(3000, true);
   }
-  if (!client_websocket.available() or websocketReconnect) {
-    LOG.println("Reconnecting...");
-    socketConnect();
+  switch (websocketState) {
+    case WS_CONNECTED:
+      if (client_websocket.available() && !websocketReconnect) return;
+      LOG.println("Websocket disconnected");
+      client_websocket.close();
+      scheduleWebsocketReconnect();
+      break;
+    case WS_WAITING:
+      if ((long) (now - websocketNextAttemptTime) < 0) return;
+      websocketState = websocketTcpClient->hasServerIp() && now - websocketServerIpTime < WS_DNS_CACHE_TIME ? WS_CONNECTING : WS_RESOLVING;
+      break;
+    case WS_RESOLVING:
+      if (resolveWebsocketHost()) {
+        websocketState = WS_CONNECTING;
+      } else {
+        scheduleWebsocketReconnect();
+      }
+      break;
+    case WS_CONNECTING:
+      LOG.println("Reconnecting...");
+      if (socketConnect()) {
+        websocketState = WS_CONNECTED;
+        websocketFailures = 0;
+        websocketBackoff.reset();
+        break;
+      }
+      // server may have moved, resolve its address again
+      if (++websocketFailures >= WS_DNS_MAX_FAILURES) {
+        websocketFailures = 0;
+        websocketTcpClient->clearServerIp();
+      }
+      scheduleWebsocketReconnect();
+      break;
   }
 }
 //--Websocket process end
 
-//--Map processing start
-
-CRGB processAlarms(int led, long time, int expTime, int missilesTime, int dronesTime, int position, float alertBrightness, float notificationBrightness, bool isBgStrip) {
-  CRGB hue;
-  float localBrightnessAlert = isBgStrip ? settings.getInt(BRIGHTNESS_BG) / 100.0f : settings.getInt(BRIGHTNESS_ALERT) / 100.0f;
-  float localBrightnessClear = isBgStrip ? settings.getInt(BRIGHTNESS_BG) / 100.0f : settings.getInt(BRIGHTNESS_CLEAR) / 100.0f;
-  float localBrightnessHomeDistrict = isBgStrip ? settings.getInt(BRIGHTNESS_BG) / 100.0f : settings.getInt(BRIGHTNESS_HOME_DISTRICT) / 100.0f;
-
-  int localDistrictLedsCount = homeDistrictMapping.first;
-  int* localDistrictLed = homeDistrictMapping.second;
-  int colorSwitch;
-
-  unix_t currentTime = timeClient.unixGMT();
-
-  // explosions has highest priority
-  if (settings.getBool(ENABLE_EXPLOSIONS) && expTime > 0 && currentTime - expTime < settings.getInt(EXPLOSION_TIME) * 60 && settings.getInt(ALARMS_NOTIFY_MODE) > 0) {
-    colorSwitch = settings.getInt(COLOR_EXPLOSION);
-    hue = fromHue(colorSwitch, notificationBrightness * settings.getInt(BRIGHTNESS_EXPLOSION));
-    return hue;
+// sends latency stats to server as "stats:{"latency":{"<stage>":[count,p50,p99,max],...}}", values in ms
+void latencyReportProcess() {
+  if (millis() - latencyReportTime < LATENCY_REPORT_INTERVAL || !client_websocket.available()) return;
+  latencyReportTime = millis();
+  char stats[40 + JaamLatencyStats::STAGES_COUNT * 60];
+  int length = sprintf(stats, "stats:{\"latency\":{");
+  for (int stage = 0; stage < JaamLatencyStats::STAGES_COUNT; stage++) {
+    JaamLatencyStats::Summary summary = latencyStats.getSummary((JaamLatencyStats::Stage) stage);
+    length += sprintf(stats + length, "%s\"%s\":[%u,%.1f,%.1f,%.1f]", stage > 0 ? "," : "",
+      JaamLatencyStats::getStageName((JaamLatencyStats::Stage) stage), (unsigned int) summary.count,
+      summary.p50 / 1000.0f, summary.p99 / 1000.0f, summary.max / 1000.0f);
   }
+  sprintf(stats + length, "}}");
+  LOG.println(stats);
+  client_websocket.send(stats);
+}
 
-  // missiles has second priority
-  if (settings.getBool(ENABLE_MISSILES) && missilesTime > 0 && currentTime - missilesTime < settings.getInt(EXPLOSION_TIME) * 60 && settings.getInt(ALARMS_NOTIFY_MODE) > 0) {
-    colorSwitch = settings.getInt(COLOR_MISSILES);
-    hue = fromHue(colorSwitch, notificationBrightness * settings.getInt(BRIGHTNESS_EXPLOSION));
-    return hue;
-  }
+//--Trace start
 
-  // drones has third priority
-  if (settings.getBool(ENABLE_DRONES) && dronesTime > 0 && currentTime - dronesTime < settings.getInt(EXPLOSION_TIME) * 60 && settings.getInt(ALARMS_NOTIFY_MODE) > 0) {
-    colorSwitch = settings.getInt(COLOR_DRONES);
-    hue = fromHue(colorSwitch, notificationBrightness * settings.getInt(BRIGHTNESS_EXPLOSION));
-    return hue;
+void startReplay() {
+  if (traceBuffer.getCount() == 0) {
+    LOG.println("Trace is empty, nothing to replay");
+    return;
+  }
+  LOG.printf("Trace replay started: %d frames, speed %d\n", traceBuffer.getCount(), replaySpeed);
+  // replayed delta frames are applied on top of replayed snapshots only
+  deltaSequence.reset();
+  replayProfiler.reset();
+  renderTaskProfiler = &replayProfiler;
+  networkTaskProfiler = &replayProfiler;
+  replayStats = ReplayStats();
+  replayStats.speed = replaySpeed;
+  replayOffset = 0;
+  size_t offset = 0;
+  const uint8_t* data;
+  size_t length;
+  traceBuffer.next(&offset, &replayFirstFrameTime, &data, &length);
+  replayStartTime = millis();
+  replayStartHeap = ESP.getFreeHeap();
+  replayStartMinHeap = ESP.getMinFreeHeap();
+  traceMode = TRACE_REPLAY;
+}
+
+void finishReplay() {
+  renderTaskProfiler = &profiler;
+  networkTaskProfiler = &profiler;
+  replayStats.duration = millis() - replayStartTime;
+  traceMode = TRACE_IDLE;
+  LOG.printf("Trace replay finished: %u frames in %u ms\n", replayStats.frames, replayStats.duration);
+  // replayed data stays on the map until server sends current data on new connection
+  client_websocket.close();
+}
+
+// frames are replayed with recorded intervals divided by speed
+void replayFrames() {
+  for (int i = 0; i < TRACE_REPLAY_BATCH; i++) {
+    size_t offset = replayOffset;
+    uint32_t time;
+    const uint8_t* data;
+    size_t length;
+    if (!traceBuffer.next(&offset, &time, &data, &length)) {
+      finishReplay();
+      return;
+    }
+    if (replayStats.speed > 0 && millis() - replayStartTime < (time - replayFirstFrameTime) / replayStats.speed) return;
+    replayOffset = offset;
+    ingestMessage((const char*) data, length);
+    replayStats.frames++;
+    uint32_t freeHeap = ESP.getFreeHeap();
+    // low watermark also catches memory freed before the end of the frame, it is used only if replay lowered it
+    uint32_t minFreeHeap = ESP.getMinFreeHeap();
+    if (minFreeHeap < replayStartMinHeap && minFreeHeap < freeHeap) freeHeap = minFreeHeap;
+    if (freeHeap < replayStartHeap && replayStartHeap - freeHeap > replayStats.peakHeap) {
+      replayStats.peakHeap = replayStartHeap - freeHeap;
+    }
   }
+}
 
-  switch (led) {
-    case ALERT:
-      if (currentTime - time < settings.getInt(ALERT_ON_TIME) * 60 && settings.getInt(ALARMS_NOTIFY_MODE) > 0) {
-        colorSwitch = settings.getInt(COLOR_NEW_ALERT);
-        hue = fromHue(colorSwitch, alertBrightness * settings.getInt(BRIGHTNESS_NEW_ALERT));
-      } else {
-        colorSwitch = settings.getInt(COLOR_ALERT);
-        hue = fromHue(colorSwitch, settings.getInt(CURRENT_BRIGHTNESS) * localBrightnessAlert);
+// applies commands from web server, so trace buffer and map state are changed by network task only
+void traceProcess() {
+  switch (traceCommand.exchange(TRACE_NONE)) {
+    case TRACE_START_CAPTURE:
+      if (traceMode == TRACE_REPLAY) finishReplay();
+      if (!traceBuffer.allocate()) {
+        LOG.println("Not enough memory for trace");
+        break;
       }
+      traceBuffer.clear();
+      traceMode = TRACE_CAPTURE;
+      LOG.println("Trace capture started");
       break;
-    case CLEAR:
-      if (currentTime - time < settings.getInt(ALERT_OFF_TIME) * 60 && settings.getInt(ALARMS_NOTIFY_MODE) > 0) {
-        colorSwitch = settings.getInt(COLOR_ALERT_OVER);
-        hue = fromHue(colorSwitch, alertBrightness * settings.getInt(BRIGHTNESS_ALERT_OVER));
-      } else {
-        float localBrightness;
-        if (isBgStrip && isAlertInNeighboringDistricts()) {
-          colorSwitch = settings.getInt(COLOR_BG_NEIGHBOR_ALERT);
-          localBrightness = localBrightnessAlert;
-        } else if (isInArray(position, localDistrictLed, localDistrictLedsCount)) {
-          colorSwitch = settings.getInt(COLOR_HOME_DISTRICT);
-          localBrightness = localBrightnessHomeDistrict;
-        } else {
-          colorSwitch = settings.getInt(COLOR_CLEAR);
-          localBrightness = localBrightnessClear;
-        }
-        hue = fromHue(colorSwitch, settings.getInt(CURRENT_BRIGHTNESS) * localBrightness);
-      }
+    case TRACE_START_REPLAY:
+      if (traceMode == TRACE_REPLAY) break;
+      traceMode = TRACE_IDLE;
+      startReplay();
+      break;
+    case TRACE_STOP:
+      if (traceMode == TRACE_REPLAY) finishReplay();
+      traceMode = TRACE_IDLE;
+      LOG.printf("Trace stopped: %d frames\n", traceBuffer.getCount());
+      break;
+    default:
       break;
   }
-  return hue;
+  if (traceMode == TRACE_REPLAY) replayFrames();
 }
 
+//--Trace end
+
+//--Map processing start
+
 float getFadeInFadeOutBrightness(float maxBrightness, long fadeTime) {
-  float fixedMaxBrightness = (maxBrightness > 0.0f && maxBrightness < minBlinkBrightness) ? minBlinkBrightness : maxBrightness;
-  float minBrightness = fixedMaxBrightness * 0.01f;
-  int progress = micros() % (fadeTime * 1000);
-  int halfBlinkTime = fadeTime * 500;
-  float blinkBrightness;
-  if (progress < halfBlinkTime) {
-    blinkBrightness = mapf(progress, 0, halfBlinkTime, minBrightness, fixedMaxBrightness);
-  } else {
-    blinkBrightness = mapf(progress, halfBlinkTime + 1, halfBlinkTime * 2, fixedMaxBrightness, minBrightness);
-  }
-  return blinkBrightness;
+  int64_t frameTime = renderTaskHandle ? frameClock.getFrameTime() : esp_timer_get_time();
+  return getFadeInFadeOutBrightness(maxBrightness, minBlinkBrightness, fadeTime, frameTime);
 }
 
 void playMinOfSilenceSound() {
@@ -3180,11 +4592,12 @@ void checkMinuteOfSilence() {
     ha.setMapModeCurrent(getNameById(MAP_MODES, getCurrentMapMode(), MAP_MODES_COUNT));
     // play mos beep every 2 sec during min of silence
     if (minuteOfSilence && needToPlaySound(MIN_OF_SILINCE)) {
-      clockBeepInterval = asyncEngine.setInterval(playMinOfSilenceSound, 2000); // every 2 sec
+      clockBeepInterval = scheduler.setInterval(playMinOfSilenceSound, 2000, "playMinOfSilenceSound"); // every 2 sec
     }
     // turn off mos beep
     if (!minuteOfSilence && clockBeepInterval >= 0) {
-      asyncEngine.clearInterval(clockBeepInterval);
+      scheduler.cancel(clockBeepInterval);
+      clockBeepInterval = -1;
     }
 #if BUZZER_ENABLED
     // play UA Anthem when min of silence ends
@@ -3196,134 +4609,201 @@ void checkMinuteOfSilence() {
   }
 }
 
-int processWeather(float temp) {
-  float minTemp = settings.getInt(WEATHER_MIN_TEMP);
-  float maxTemp = settings.getInt(WEATHER_MAX_TEMP);
-  float normalizedValue = float(temp - minTemp) / float(maxTemp - minTemp);
-  if (normalizedValue > 1) {
-    normalizedValue = 1;
-  }
-  if (normalizedValue < 0) {
-    normalizedValue = 0;
-  }
-  int hue = round(275 + normalizedValue * (0 - 275));
-  hue %= 360;
-  return hue;
-}
-
 void mapReconnect() {
-  float localBrightness = getFadeInFadeOutBrightness(settings.getInt(CURRENT_BRIGHTNESS) / 200.0f, settings.getInt(ALERT_BLINK_TIME) * 1000);
-  CRGB hue = fromHue(64, localBrightness * settings.getInt(CURRENT_BRIGHTNESS));
+  const RenderConfig& config = getRenderConfig();
+  float localBrightness = getFadeInFadeOutBrightness(config.currentBrightness / 200.0f, config.blinkTime);
+  CRGB hue = fromHue(64, localBrightness * config.currentBrightness);
   for (uint16_t i = 0; i < 26; i++) {
     strip[i] = hue;
   }
-  if (isBgStripEnabled()) {
-    float brightness_factror = settings.getInt(BRIGHTNESS_BG) / 100.0f;
-    fill_solid(bg_strip, settings.getInt(BG_LED_COUNT), fromHue(64, localBrightness * settings.getInt(CURRENT_BRIGHTNESS) * brightness_factror));
+  if (config.bgStripEnabled) {
+    float brightness_factror = config.brightnessBg / 100.0f;
+    fill_solid(bg_strip, config.bgLedCount, fromHue(64, localBrightness * config.currentBrightness * brightness_factror));
   }
-  FastLED.show();
+  showStrips();
 }
 
 void mapOff() {
+  const RenderConfig& config = getRenderConfig();
   fill_solid(strip, MAIN_LEDS_COUNT, CRGB::Black);
-  if (isBgStripEnabled()) {
-    fill_solid(bg_strip, settings.getInt(BG_LED_COUNT), CRGB::Black);
+  if (config.bgStripEnabled) {
+    fill_solid(bg_strip, config.bgLedCount, CRGB::Black);
   }
-  FastLED.show();
+  showStrips();
 }
 
 void mapLamp() {
-  fill_solid(strip, MAIN_LEDS_COUNT, fromRgb(settings.getInt(HA_LIGHT_R), settings.getInt(HA_LIGHT_G), settings.getInt(HA_LIGHT_B), settings.getInt(HA_LIGHT_BRIGHTNESS)));
-  if (isBgStripEnabled()) {
-    float brightness_factror = settings.getInt(BRIGHTNESS_BG) / 100.0f;
-    fill_solid(bg_strip, settings.getInt(BG_LED_COUNT), fromRgb(settings.getInt(HA_LIGHT_R), settings.getInt(HA_LIGHT_G), settings.getInt(HA_LIGHT_B), settings.getInt(HA_LIGHT_BRIGHTNESS) * brightness_factror));
+  const RenderConfig& config = getRenderConfig();
+  fill_solid(strip, MAIN_LEDS_COUNT, fromRgbFixed(config.lampR, config.lampG, config.lampB, config.lampBrightness * 100));
+  if (config.bgStripEnabled) {
+    fill_solid(bg_strip, config.bgLedCount, fromRgbFixed(config.lampR, config.lampG, config.lampB, config.lampBrightness * config.brightnessBg));
   }
-  FastLED.show();
+  showStrips();
 }
 
-void mapAlarms() {
-  float blinkBrightness = settings.getInt(CURRENT_BRIGHTNESS) / 100.0f;
-  float notificationBrightness = settings.getInt(CURRENT_BRIGHTNESS) / 100.0f;
-  if (settings.getInt(ALARMS_NOTIFY_MODE) == 2) {
-    blinkBrightness = getFadeInFadeOutBrightness(blinkBrightness, settings.getInt(ALERT_BLINK_TIME) * 1000);
-    notificationBrightness = getFadeInFadeOutBrightness(notificationBrightness, settings.getInt(ALERT_BLINK_TIME) * 500);
-  }
+AlarmsFrame getAlarmsFrame(const RenderConfig& config, unix_t currentTime, bool neighborAlert) {
+  int64_t frameTime = renderTaskHandle ? frameClock.getFrameTime() : esp_timer_get_time();
+  return getAlarmsFrame(config, currentTime, neighborAlert, minBlinkBrightness, frameTime);
+}
+
+// renders LEDs from ledsToRender mask and returns mask of LEDs in transition
+uint32_t renderAlarms(const RenderConfig& config, const AlarmsFrame& frame, const AlarmsState<MAIN_LEDS_COUNT>& state, uint32_t ledsToRender, bool renderBgStrip) {
+  // the whole pass is one sample, a timer around every LED would cost as much as its color
+  StageTimer timer(JaamProfiler::PROCESS_ALARMS);
+  LedColor colors[MAIN_LEDS_COUNT];
+  uint32_t transitionLeds = getAlarmColors(config, frame, state, homeDistrict.leds, ledsToRender, colors);
   for (uint16_t i = 0; i < MAIN_LEDS_COUNT; i++) {
-    strip[i] = processAlarms(
-      led_to_alerts[i].first,
-      led_to_alerts[i].second,
-      led_to_explosions[i],
-      led_to_missiles[i],
-      led_to_drones[i],
-      i,
-      blinkBrightness,
-      notificationBrightness,
-      false
-    );
+    if ((ledsToRender >> i) & 1) strip[i] = fromHueFixed(colors[i].hue, colors[i].brightness);
   }
-  if (isBgStripEnabled()) {
-    // same as for local district
-    int localDistrictLedCount = homeDistrictMapping.first; // get count of leds in local district
-    if (localDistrictLedCount <= 0) {
-      // if local district led is missing, fill bg strip with black color
-      fill_solid(bg_strip, settings.getInt(BG_LED_COUNT), CRGB::Black);
+  if (config.bgStripEnabled && renderBgStrip) {
+    LedColor color;
+    if (getBgStripColor(config, frame, state, homeDistrict, &color)) {
+      fill_solid(bg_strip, config.bgLedCount, fromHueFixed(color.hue, color.brightness));
     } else {
-      int localDistrictLed = homeDistrictMapping.second[0]; // get first led in local district
-      fill_solid(
-        bg_strip,
-        settings.getInt(BG_LED_COUNT),
-        processAlarms(
-          led_to_alerts[localDistrictLed].first,
-          led_to_alerts[localDistrictLed].second,
-          led_to_explosions[localDistrictLed],
-          led_to_missiles[localDistrictLed],
-          led_to_drones[localDistrictLed],
-          localDistrictLed,
-          blinkBrightness,
-          notificationBrightness,
-          true
-        )
-      );
+      fill_solid(bg_strip, config.bgLedCount, CRGB::Black);
     }
   }
-  FastLED.show();
+  return transitionLeds;
+}
+
+void mapAlarms() {
+  uint32_t start = ESP.getCycleCount();
+  const RenderConfig& config = getRenderConfig();
+  // until time is synced restored state is drawn at the time it was saved, so its alerts are not shown as new
+  long currentTime = max((long) timeClient.unixGMT(), warmStartTime);
+  AlarmsFrame frame = getAlarmsFrame(config, currentTime, isAlertInSlots(renderRegionsState.alertState, homeDistrict.neighborSlots));
+  bool fullRedraw = renderedMapMode != 1 || renderedSettingsGeneration != config.generation;
+  AlarmsPass pass = getAlarmsPass(fullRedraw, dirtyLeds, animatedLeds, bgStripDirty, homeDistrict);
+  animatedLeds = renderAlarms(config, frame, ledsState, pass.ledsToRender, pass.renderBgStrip);
+  dirtyLeds = 0;
+  bgStripDirty = false;
+  renderedSettingsGeneration = config.generation;
+  addStageSample(JaamProfiler::MAP_ALARMS, ESP.getCycleCount() - start);
+  showStrips();
+}
+
+// renders synthetic worst case (all regions in alert with all notifications active in fade mode and
+// 100 LEDs background strip) BENCHMARK_FRAMES times and collects stage timings into benchmarkProfiler
+void runRenderBenchmark() {
+  LOG.println("Render benchmark started");
+  RenderConfig config = getRenderConfig();
+  config.notifyMode = 2;
+  config.enableExplosions = true;
+  config.enableMissiles = true;
+  config.enableDrones = true;
+  config.bgStripEnabled = true;
+  config.bgLedCount = 100;
+  unix_t currentTime = timeClient.unixGMT();
+  AlarmsState<MAIN_LEDS_COUNT> state;
+  for (int i = 0; i < MAIN_LEDS_COUNT; i++) {
+    state.alertState[i] = ALERT;
+    state.alertTime[i] = currentTime;
+    state.temperature[i] = 0.0f;
+    state.explosionTime[i] = currentTime;
+    state.missilesTime[i] = currentTime;
+    state.dronesTime[i] = currentTime;
+  }
+  // websocket stage is measured on parsing of alerts payload only, full callback changes real map state
+  char payload[40 + REGION_SLOTS_COUNT * 16];
+  int length = sprintf(payload, "{\"payload\":\"alerts\",\"alerts\":[");
+  for (int i = 0; i < REGION_SLOTS_COUNT; i++) {
+    length += sprintf(payload + length, "%s[1,%ld]", i > 0 ? "," : "", (long) currentTime);
+  }
+  length += sprintf(payload + length, "]}");
+
+  benchmarkProfiler.reset();
+  loopTaskProfiler = &benchmarkProfiler;
+  for (int frameIndex = 0; frameIndex < BENCHMARK_FRAMES; frameIndex++) {
+    uint32_t start = ESP.getCycleCount();
+    AlarmsFrame frame = getAlarmsFrame(config, currentTime, true);
+    renderAlarms(config, frame, state, ALL_LEDS, true);
+    benchmarkProfiler.add(JaamProfiler::MAP_ALARMS, ESP.getCycleCount() - start);
+    stripsShown = false;
+    showStrips();
+    displayCycle();
+    start = ESP.getCycleCount();
+    uint8_t states[REGION_SLOTS_COUNT];
+    long times[REGION_SLOTS_COUNT];
+    JaamPayloadParser parser(payload, length);
+    if (parser.getPayload() == JaamPayloadParser::ALERTS) {
+      parser.readAlerts("alerts", states, times, REGION_SLOTS_COUNT);
+    }
+    benchmarkProfiler.add(JaamProfiler::WS_MESSAGE, ESP.getCycleCount() - start);
+    esp_task_wdt_reset();
+  }
+  loopTaskProfiler = &profiler;
+  // real map state will be rendered on the next map cycle
+  renderedMapMode = -1;
+  LOG.println("Render benchmark finished");
+}
+
+// baseline is stored as comma separated p99 values (in CPU cycles) for every stage
+bool readBenchmarkBaseline(uint32_t baseline[]) {
+  const char* value = settings.getString(BENCHMARK_BASELINE);
+  for (int stage = 0; stage < JaamProfiler::STAGES_COUNT; stage++) {
+    char* end;
+    baseline[stage] = strtoul(value, &end, 10);
+    if (end == value) return false;
+    value = *end == ',' ? end + 1 : end;
+  }
+  return true;
+}
+
+void saveBenchmarkBaseline() {
+  char baseline[JaamProfiler::STAGES_COUNT * 11 + 1] = "";
+  int length = 0;
+  for (int stage = 0; stage < JaamProfiler::STAGES_COUNT; stage++) {
+    JaamProfiler::Summary summary = benchmarkProfiler.getSummary((JaamProfiler::Stage) stage);
+    length += sprintf(baseline + length, "%s%u", stage > 0 ? "," : "", (unsigned int) summary.p99);
+  }
+  settings.saveString(BENCHMARK_BASELINE, baseline);
+}
+
+void benchmarkCycle() {
+  if (!benchmarkRequested) return;
+  benchmarkRequested = false;
+  pauseRendering();
+  runRenderBenchmark();
+  resumeRendering();
 }
 
 void mapWeather() {
+  const RenderConfig& config = getRenderConfig();
   for (uint16_t i = 0; i < MAIN_LEDS_COUNT; i++) {
-    strip[i] = fromHue(processWeather(led_to_weather[i]), settings.getInt(CURRENT_BRIGHTNESS));
+    strip[i] = fromHueFixed(processWeather(config, ledsState.temperature[i]), config.fullBrightness);
   }
-  if (isBgStripEnabled()) {
+  if (config.bgStripEnabled) {
     // same as for local district
-    float brightness_factror = settings.getInt(BRIGHTNESS_BG) / 100.0f;
-    fill_solid(bg_strip, settings.getInt(BG_LED_COUNT), fromHue(processWeather(id_to_weather[settings.getInt(HOME_DISTRICT) ]), settings.getInt(CURRENT_BRIGHTNESS) * brightness_factror));
+    int homeSlot = regionSlot(config.homeDistrict);
+    float homeTemperature = homeSlot < 0 ? 0.0f : renderRegionsState.temperature[homeSlot];
+    fill_solid(bg_strip, config.bgLedCount, fromHueFixed(processWeather(config, homeTemperature), config.bgBrightness));
   }
-  FastLED.show();
+  showStrips();
 }
 
 void mapFlag() {
+  const RenderConfig& config = getRenderConfig();
   for (uint16_t i = 0; i < MAIN_LEDS_COUNT; i++) {
-    strip[i] = fromHue(led_to_flag_color[i], settings.getInt(CURRENT_BRIGHTNESS));
+    strip[i] = fromHueFixed(ledFlagColor[i], config.fullBrightness);
   }
-  if (isBgStripEnabled()) {
+  if (config.bgStripEnabled) {
       // 180 - blue color
-    float brightness_factror = settings.getInt(BRIGHTNESS_BG) / 100.0f;
-    fill_solid(bg_strip, settings.getInt(BG_LED_COUNT), fromHue(180, settings.getInt(CURRENT_BRIGHTNESS) * brightness_factror));
+    fill_solid(bg_strip, config.bgLedCount, fromHueFixed(180, config.bgBrightness));
   }
-  FastLED.show();
+  showStrips();
 }
 
 void mapRandom() {
+  const RenderConfig& config = getRenderConfig();
   int randomLed = random(MAIN_LEDS_COUNT);
   int randomColor = random(360);
-  strip[randomLed] = fromHue(randomColor, settings.getInt(CURRENT_BRIGHTNESS));
-  if (isBgStripEnabled()) {
-    int bgRandomLed = random(settings.getInt(BG_LED_COUNT));
+  strip[randomLed] = fromHueFixed(randomColor, config.fullBrightness);
+  if (config.bgStripEnabled) {
+    int bgRandomLed = random(config.bgLedCount);
     int bgRandomColor = random(360);
-    float brightness_factror = settings.getInt(BRIGHTNESS_BG) / 100.0f;
-    bg_strip[bgRandomLed] = fromHue(bgRandomColor, settings.getInt(CURRENT_BRIGHTNESS) * brightness_factror);
+    bg_strip[bgRandomLed] = fromHueFixed(bgRandomColor, config.bgBrightness);
   }
-  FastLED.show();
+  showStrips();
 }
 
 void mapCycle() {
@@ -3355,10 +4835,148 @@ void mapCycle() {
       mapReconnect();
       break;
   }
+  renderedMapMode = currentMapMode;
+}
+
+// applies data received by network task, returns true if anything was changed
+bool applyRegionsUpdates() {
+  RegionsUpdate update;
+  bool applied = false;
+  while (regionsUpdates.pop(update)) {
+    switch (update.payload) {
+      case JaamPayloadParser::ALERTS:
+        memcpy(renderRegionsState.alertState, update.alertState, sizeof(update.alertState));
+        memcpy(renderRegionsState.alertTime, update.times, sizeof(update.times));
+        remapAlerts(update.changedSlots);
+        if (update.receivedAt > 0 && pendingLatenciesCount < REGIONS_UPDATES_SIZE) {
+          pendingLatencies[pendingLatenciesCount++] = {update.receivedAt, update.parsedAt, esp_timer_get_time(), update.networkLatency};
+        }
+        break;
+      case JaamPayloadParser::WEATHER:
+        memcpy(renderRegionsState.temperature, update.temperature, sizeof(update.temperature));
+        remapWeather(update.changedSlots);
+        break;
+      case JaamPayloadParser::EXPLOSIONS:
+        memcpy(renderRegionsState.explosionTime, update.times, sizeof(update.times));
+        remapExplosions(update.changedSlots);
+        break;
+      case JaamPayloadParser::MISSILES:
+        memcpy(renderRegionsState.missilesTime, update.times, sizeof(update.times));
+        remapMissiles(update.changedSlots);
+        break;
+      case JaamPayloadParser::DRONES:
+        memcpy(renderRegionsState.dronesTime, update.times, sizeof(update.times));
+        remapDrones(update.changedSlots);
+        break;
+      default:
+        break;
+    }
+    applied = true;
+  }
+  return applied;
+}
+
+// called after the frame with remapped alerts is shown
+void recordPendingLatencies() {
+  int64_t shownAt = esp_timer_get_time();
+  for (int i = 0; i < pendingLatenciesCount; i++) {
+    const PendingLatency& latency = pendingLatencies[i];
+    latencyStats.add(JaamLatencyStats::PARSE, latency.parsedAt - latency.receivedAt);
+    latencyStats.add(JaamLatencyStats::REMAP, latency.remappedAt - latency.parsedAt);
+    latencyStats.add(JaamLatencyStats::SHOW, shownAt - latency.remappedAt);
+    latencyStats.add(JaamLatencyStats::DEVICE, shownAt - latency.receivedAt);
+    if (latency.networkLatency >= 0) {
+      latencyStats.add(JaamLatencyStats::NETWORK, latency.networkLatency);
+      latencyStats.add(JaamLatencyStats::TOTAL, latency.networkLatency + shownAt - latency.receivedAt);
+    }
+  }
+  pendingLatenciesCount = 0;
+}
+
+// strips are owned by render task once it is started, other tasks only ask it to redraw
+void requestMapRedraw() {
+  if (renderTaskHandle) {
+    mapRedrawRequested = true;
+  } else {
+    mapCycle();
+  }
+}
+
+// LED mapping is used by render task only, so it is rebuilt there
+void requestLedMappingUpdate() {
+  if (renderTaskHandle) {
+    ledMappingChanged = true;
+  } else {
+    initLedMapping();
+  }
+}
+
+// stops render task on frame boundary, so strips can be drawn from another task (update progress, benchmark)
+void pauseRendering() {
+  if (!renderTaskHandle || xTaskGetCurrentTaskHandle() == renderTaskHandle) return;
+  renderPauseRequested = true;
+  for (int i = 0; i < 200 && !renderPaused; i++) {
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
+
+void resumeRendering() {
+  renderPauseRequested = false;
+  mapRedrawRequested = true;
+}
+
+void renderTask(void* parameter) {
+  esp_task_wdt_add(NULL);
+  unsigned long lastMapCycleTime = 0;
+  frameClock.setFrameRate(getRenderConfig().frameRate, esp_timer_get_time());
+  while (true) {
+    if (renderPauseRequested) {
+      renderPaused = true;
+    } else {
+      if (renderPaused) {
+        // strips were changed outside, draw everything again
+        renderPaused = false;
+        renderedMapMode = -1;
+      }
+      const RenderConfig& config = getRenderConfig();
+      if (config.frameRate != frameClock.getFrameRate()) {
+        frameClock.setFrameRate(config.frameRate, esp_timer_get_time());
+      }
+      bool changed = applyRegionsUpdates();
+      if (ledMappingChanged.exchange(false)) {
+        // home district LEDs are remapped there too
+        initLedMapping();
+        homeDistrictChanged = false;
+        bgStripDirty = true;
+        changed = true;
+      }
+      if (homeDistrictChanged.exchange(false)) {
+        remapHomeDistrict();
+        bgStripDirty = true;
+        changed = true;
+      }
+      // only fading LEDs need a new frame, idle frames are skipped
+      bool animated = (renderedMapMode == 1 && config.notifyMode == 2 && animatedLeds != 0) || renderedMapMode == 1000;
+      if (mapRedrawRequested.exchange(false) || changed || animated || millis() - lastMapCycleTime >= MAP_CYCLE_TIME) {
+        mapCycle();
+        recordPendingLatencies();
+        lastMapCycleTime = millis();
+        frameClock.frameRendered();
+      }
+    }
+    esp_task_wdt_reset();
+    int64_t waitTime = frameClock.advance(esp_timer_get_time());
+    // round up to whole ticks, frame time is still taken from the frame deadline
+    vTaskDelay(max((TickType_t) 1, (TickType_t) ((waitTime + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000))));
+  }
 }
 
 //--Map processing end
 
+void settingsCommitCycle() {
+  settings.commitIfIdle();
+}
+
 void rebootCycle() {
   if (needRebootWithDelay != -1) {
     int localDelay = needRebootWithDelay;
@@ -3470,13 +5088,15 @@ void initLegacy() {
     settings.saveInt(BUZZER_PIN, 33, false);
     settings.saveInt(DISPLAY_MODEL, 2, false);
     settings.saveInt(DISPLAY_HEIGHT, 64, false);
-    brightnessFactor = 0.3f;
-    minBrightness = 2;
-    minBlinkBrightness = 0.07f;
     settings.saveBool(USE_TOUCH_BUTTON_1, 0, false);
     settings.saveBool(USE_TOUCH_BUTTON_2, 0, false);
     break;
   }
+  BrightnessProfile brightnessProfile = getBrightnessProfile(settings.getInt(LEGACY));
+  brightnessFactor = brightnessProfile.factor;
+  minBrightness = brightnessProfile.minBrightness;
+  minBlinkBrightness = brightnessProfile.minBlinkBrightness;
+  updateBrightnessScale();
 }
 
 void initButtons() {
@@ -3593,7 +5213,11 @@ void initStrip() {
     checkServicePins();
   }
   FastLED.setDither(DISABLE_DITHER);
-  mapFlag();
+  if (provisionalState) {
+    mapCycle();
+  } else {
+    mapFlag();
+  }
 }
 
 void initDisplayOptions() {
@@ -3711,6 +5335,9 @@ void initHA() {
   ha.initFreeMemorySensor();
   ha.initUsedMemorySensor();
   ha.initCpuTempSensor(temperatureRead());
+  ha.initSchedulerMissedDeadlinesSensor();
+  ha.initSchedulerSlowestJobSensor();
+  ha.initAlertLatencySensors();
   ha.initBrightnessSensor(settings.getInt(BRIGHTNESS), saveBrightness);
   ha.initDayBrightnessSensor(settings.getInt(BRIGHTNESS_DAY), saveDayBrightness);
   ha.initNightBrightnessSensor(settings.getInt(BRIGHTNESS_NIGHT), saveNightBrightness);
@@ -3837,16 +5464,47 @@ void runSelfTests() {
 }
 #endif
 
+void networkTask(void* parameter) {
+  esp_task_wdt_add(NULL);
+  websocketBackoff.seed(esp_random());
+  while (true) {
+    wm.process();
+#if ARDUINO_OTA_ENABLED
+    ArduinoOTA.handle();
+#endif
+    ha.loop();
+    client_websocket.poll();
+    applyQueuedFrames();
+    publishPendingRegionsUpdates();
+    stateStore.commitIfDue(millis());
+    // connect may block for up to WS_CONNECT_TIMEOUT, so it is done here instead of housekeeping jobs
+    websocketProcess();
+    traceProcess();
+    updateUnixClock();
+    checkWarmStartAge();
+    latencyReportProcess();
+    esp_task_wdt_reset();
+    vTaskDelay(pdMS_TO_TICKS(NETWORK_TASK_DELAY));
+  }
+}
+
+void initTasks() {
+  xTaskCreatePinnedToCore(renderTask, "render", RENDER_TASK_STACK_SIZE, NULL, RENDER_TASK_PRIORITY, &renderTaskHandle, RENDER_TASK_CORE);
+  xTaskCreatePinnedToCore(networkTask, "network", NETWORK_TASK_STACK_SIZE, NULL, NETWORK_TASK_PRIORITY, &networkTaskHandle, NETWORK_TASK_CORE);
+}
+
 void syncTimePeriodically() {
   syncTime(2);
 }
 
 void setup() {
+  mainLoopTaskHandle = xTaskGetCurrentTaskHandle();
   LOG.begin(115200);
 
   initChipID();
   initSettings();
   initLegacy();
+  initWarmStart();
   initLedMapping();
   initButtons();
   initBuzzer();
@@ -3861,30 +5519,35 @@ void setup() {
   initWifi();
   initTime();
 
-  asyncEngine.setInterval(uptime, 5000);
-  asyncEngine.setInterval(connectStatuses, 60000);
-  asyncEngine.setInterval(mapCycle, 1000);
-  asyncEngine.setInterval(displayCycle, 100);
-  asyncEngine.setInterval(wifiReconnect, 1000);
-  asyncEngine.setInterval(autoBrightnessUpdate, 1000);
+  scheduler.setInterval(uptime, 5000, "uptime", JaamScheduler::PRIORITY_LOW);
+  scheduler.setInterval(connectStatuses, 60000, "connectStatuses", JaamScheduler::PRIORITY_LOW);
+  scheduler.setInterval(displayCycle, 100, "displayCycle", JaamScheduler::PRIORITY_HIGH);
+  scheduler.setInterval(wifiReconnect, 1000, "wifiReconnect");
+  scheduler.setInterval(autoBrightnessUpdate, 1000, "autoBrightnessUpdate");
   #if FW_UPDATE_ENABLED
-  asyncEngine.setInterval(doUpdate, 1000);
+  scheduler.setInterval(doUpdate, 1000, "doUpdate", JaamScheduler::PRIORITY_LOW);
   #endif
-  asyncEngine.setInterval(websocketProcess, 3000);
-  asyncEngine.setInterval(alertPinCycle, 1000);
-  asyncEngine.setInterval(rebootCycle, 500);
-  asyncEngine.setInterval(lightSensorCycle, 2000);
-  asyncEngine.setInterval(climateSensorCycle, 5000);
-  asyncEngine.setInterval(calculateStates, 500);
-  asyncEngine.setInterval(syncTimePeriodically, 60000);
+  scheduler.setInterval(alertPinCycle, 1000, "alertPinCycle", JaamScheduler::PRIORITY_HIGH);
+  scheduler.setInterval(rebootCycle, 500, "rebootCycle");
+  scheduler.setInterval(settingsCommitCycle, 1000, "settingsCommitCycle", JaamScheduler::PRIORITY_LOW);
+  scheduler.setInterval(benchmarkCycle, 500, "benchmarkCycle", JaamScheduler::PRIORITY_LOW);
+  scheduler.setInterval(lightSensorCycle, 2000, "lightSensorCycle");
+  scheduler.setInterval(climateSensorCycle, 5000, "climateSensorCycle", JaamScheduler::PRIORITY_LOW);
+  scheduler.setInterval(calculateStates, 500, "calculateStates", JaamScheduler::PRIORITY_HIGH);
+  scheduler.setInterval(syncTimePeriodically, 60000, "syncTimePeriodically", JaamScheduler::PRIORITY_LOW);
+  scheduler.setInterval(liveStateCycle, LIVE_STATE_INTERVAL, "liveStateCycle", JaamScheduler::PRIORITY_LOW);
 #endif
   esp_err_t result  = esp_task_wdt_init(WDT_TIMEOUT, true);
   if (result == ESP_OK) {
     LOG.println("Watchdog timer enabled");
-    enableLoopWDT();
+    // every task subscribes itself, this one is for housekeeping loop
+    esp_task_wdt_add(NULL);
   } else {
     LOG.println("Watchdog timer NOT enabled");
   }
+#if TEST_MODE==0
+  initTasks();
+#endif
 }
 
 void loop() {
@@ -3892,16 +5555,10 @@ void loop() {
   LOG.handle();
 #endif
 #if TEST_MODE==0
-  wm.process();
-  asyncEngine.run();
-#if ARDUINO_OTA_ENABLED
-  ArduinoOTA.handle();
-#endif
-  ha.loop();
-  client_websocket.poll();
-  if (getCurrentMapMode() == 1 && settings.getInt(ALARMS_NOTIFY_MODE) == 2) {
-    mapCycle();
-  }
+  // networking and rendering are done in their own tasks, see initTasks()
+  scheduler.run();
+  regionsDataProcess();
 #endif
   buttons.tick();
+  esp_task_wdt_reset();
 }
@@ -0,0 +1,70 @@
+#include "JaamFrameClock.h"
+
+#define FPS_WINDOW 1000000 // us
+
+JaamFrameClock::JaamFrameClock() {
+  fps = 60;
+  startTime = 0;
+  frameIndex = 0;
+  frameTime = 0;
+  renderedFrames = 0;
+  droppedFrames = 0;
+  fpsWindowStart = 0;
+  fpsWindowFrames = 0;
+  achievedFps = 0;
+}
+
+// restarts frame counting from now, animation phase stays continuous because frame time is absolute
+void JaamFrameClock::setFrameRate(int fps, int64_t now) {
+  this->fps = fps > 0 ? fps : 1;
+  startTime = now;
+  frameIndex = 0;
+  frameTime = now;
+}
+
+int JaamFrameClock::getFrameRate() {
+  return fps;
+}
+
+int64_t JaamFrameClock::getFrameTime() {
+  return frameTime;
+}
+
+int64_t JaamFrameClock::getDeadline(int64_t index) {
+  return startTime + index * 1000000 / fps;
+}
+
+int64_t JaamFrameClock::advance(int64_t now) {
+  frameIndex++;
+  int64_t deadline = getDeadline(frameIndex);
+  if (deadline <= now) {
+    int64_t late = (now - deadline) * fps / 1000000 + 1;
+    droppedFrames += late;
+    frameIndex += late;
+    deadline = getDeadline(frameIndex);
+  }
+  if (now - fpsWindowStart >= FPS_WINDOW) {
+    achievedFps = fpsWindowFrames * 1000000.0f / (now - fpsWindowStart);
+    fpsWindowStart = now;
+    fpsWindowFrames = 0;
+  }
+  frameTime = deadline;
+  return deadline - now;
+}
+
+void JaamFrameClock::frameRendered() {
+  renderedFrames++;
+  fpsWindowFrames++;
+}
+
+float JaamFrameClock::getAchievedFps() {
+  return achievedFps;
+}
+
+uint32_t JaamFrameClock::getRenderedFrames() {
+  return renderedFrames;
+}
+
+uint32_t JaamFrameClock::getDroppedFrames() {
+  return droppedFrames;
+}
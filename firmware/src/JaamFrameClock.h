@@ -0,0 +1,35 @@
+#include <stdint.h>
+
+// Fixed-rate frame clock. Frame deadlines are computed from the clock start and frame index,
+// so rounding of task delays does not accumulate, and frame time (used as animation phase)
+// is monotonic 64 bit microseconds that never wraps. Frames whose deadline passed while
+// previous frame was still rendering are skipped and counted as dropped.
+class JaamFrameClock {
+
+public:
+    JaamFrameClock();
+    void setFrameRate(int fps, int64_t now);
+    int getFrameRate();
+    // scheduled time of the current frame, us
+    int64_t getFrameTime();
+    // moves to the next frame deadline which is not in the past, returns time to wait for it, us
+    int64_t advance(int64_t now);
+    // counts frames which were actually drawn, idle frames are not drawn
+    void frameRendered();
+    // frames drawn during the last second
+    float getAchievedFps();
+    uint32_t getRenderedFrames();
+    uint32_t getDroppedFrames();
+
+private:
+    int fps;
+    int64_t startTime;
+    int64_t frameIndex;
+    int64_t frameTime;
+    uint32_t renderedFrames;
+    uint32_t droppedFrames;
+    int64_t fpsWindowStart;
+    uint32_t fpsWindowFrames;
+    float achievedFps;
+    int64_t getDeadline(int64_t index);
+};
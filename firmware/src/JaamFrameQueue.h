@@ -0,0 +1,110 @@
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Lock-free bounded queue of variable length frames for exactly one producer task and one consumer task.
+// Frame bytes are copied into a ring of BYTES bytes, a frame that does not fit at the end of the ring
+// starts from its beginning. Each frame carries a copy of metadata M and a kind. Pushing a frame with
+// the full state of its kind supersedes older frames of the same kind that are still in the queue, the
+// consumer skips them. No memory is allocated after construction.
+template <typename M, uint32_t FRAMES, uint32_t BYTES>
+class JaamFrameQueue {
+    static_assert(FRAMES > 0 && (FRAMES & (FRAMES - 1)) == 0, "Queue size should be a power of two");
+
+public:
+    struct Frame {
+        const uint8_t* data;
+        size_t length;
+        int kind;
+        M meta;
+    };
+    // called by producer only, kind 0 is never superseded, returns false if queue is full
+    bool push(const uint8_t* data, size_t length, int kind, bool fullState, const M& meta) {
+        uint32_t currentTail = tail.load(std::memory_order_relaxed);
+        uint32_t currentHead = head.load(std::memory_order_acquire);
+        if (currentTail - currentHead == FRAMES) return false;
+        size_t offset;
+        if (!allocate(currentHead, currentTail, length, &offset)) return false;
+        if (fullState && kind != 0) {
+            // consumer may be applying the oldest of them right now, it is just applied once more
+            for (uint32_t index = currentHead; index != currentTail; index++) {
+                Slot& slot = slots[index % FRAMES];
+                if (slot.kind == kind) slot.superseded.store(true, std::memory_order_relaxed);
+            }
+        }
+        memcpy(storage + offset, data, length);
+        Slot& slot = slots[currentTail % FRAMES];
+        slot.offset = offset;
+        slot.length = length;
+        slot.kind = kind;
+        slot.meta = meta;
+        slot.superseded.store(false, std::memory_order_relaxed);
+        dataTail = offset + length;
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+    // called by consumer only, skips superseded frames and returns false if queue is empty.
+    // Frame data stays valid until pop().
+    bool front(Frame& frame) {
+        uint32_t currentHead = head.load(std::memory_order_relaxed);
+        while (tail.load(std::memory_order_acquire) != currentHead) {
+            Slot& slot = slots[currentHead % FRAMES];
+            if (!slot.superseded.load(std::memory_order_relaxed)) {
+                frame.data = storage + slot.offset;
+                frame.length = slot.length;
+                frame.kind = slot.kind;
+                frame.meta = slot.meta;
+                return true;
+            }
+            supersededFrames++;
+            currentHead++;
+            head.store(currentHead, std::memory_order_release);
+        }
+        return false;
+    }
+    // called by consumer only, releases the frame returned by front()
+    void pop() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    // number of frames skipped by consumer as superseded
+    uint32_t getSuperseded() {
+        return supersededFrames;
+    }
+
+private:
+    struct Slot {
+        size_t offset;
+        size_t length;
+        int kind;
+        M meta;
+        std::atomic<bool> superseded{false};
+    };
+    Slot slots[FRAMES];
+    uint8_t storage[BYTES];
+    size_t dataTail = 0; // end of the last pushed frame, producer only
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+    uint32_t supersededFrames = 0;
+
+    // frames are freed in order, so free space is from the end of the last frame to the start of the oldest one
+    bool allocate(uint32_t currentHead, uint32_t currentTail, size_t length, size_t* offset) {
+        if (length > BYTES) return false;
+        if (currentHead == currentTail) {
+            *offset = 0;
+            return true;
+        }
+        size_t oldest = slots[currentHead % FRAMES].offset;
+        if (dataTail >= oldest && dataTail + length <= BYTES) {
+            *offset = dataTail;
+            return true;
+        }
+        // frame may not end right at the oldest one, otherwise the next frame would be placed over it
+        size_t start = dataTail >= oldest ? 0 : dataTail;
+        if (start + length < oldest) {
+            *offset = start;
+            return true;
+        }
+        return false;
+    }
+};
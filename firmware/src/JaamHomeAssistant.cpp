@@ -34,6 +34,10 @@ char haLocalPressureID[28];
 char haLightLevelID[25];
 char haHomeTempID[23];
 char haNightModeID[24];
+char haSchedulerMissedID[33];
+char haSchedulerSlowestJobID[37];
+char haAlertLatencyP50ID[35];
+char haAlertLatencyP99ID[35];
 
 HASensorNumber*  haUptime;
 HASensorNumber*  haWifiSignal;
@@ -62,6 +66,10 @@ HASensorNumber*  haLocalPressure;
 HASensorNumber*  haLightLevel;
 HASensorNumber*  haHomeTemp;
 HASwitch*        haNightMode;
+HASensorNumber*  haSchedulerMissed;
+HASensor*        haSchedulerSlowestJob;
+HASensorNumber*  haAlertLatencyP50;
+HASensorNumber*  haAlertLatencyP99;
 
 const char* mqttServer;
 
@@ -89,7 +97,7 @@ void (*onMqqtConnectionStatusChanged)(bool connected);
 char configUrl[35];
 byte macAddress[6];
 
-#define SENSORS_COUNT 28
+#define SENSORS_COUNT 32
 
 char deviceUniqueID[15];
 
@@ -545,6 +553,45 @@ void JaamHomeAssistant::initNightModeSensor(bool currentState, bool (*onChange)(
 #endif
 }
 
+void JaamHomeAssistant::initSchedulerMissedDeadlinesSensor() {
+#if HA_ENABLED
+  if (!haEnabled) return;
+  sprintf(haSchedulerMissedID, "%s_scheduler_missed", deviceUniqueID);
+  haSchedulerMissed = new HASensorNumber(haSchedulerMissedID);
+  haSchedulerMissed->setIcon("mdi:timer-alert-outline");
+  haSchedulerMissed->setName("Missed Deadlines");
+  haSchedulerMissed->setStateClass("total_increasing");
+#endif
+}
+
+void JaamHomeAssistant::initSchedulerSlowestJobSensor() {
+#if HA_ENABLED
+  if (!haEnabled) return;
+  sprintf(haSchedulerSlowestJobID, "%s_scheduler_slowest_job", deviceUniqueID);
+  haSchedulerSlowestJob = new HASensor(haSchedulerSlowestJobID);
+  haSchedulerSlowestJob->setIcon("mdi:timer-sand");
+  haSchedulerSlowestJob->setName("Slowest Job");
+#endif
+}
+
+void JaamHomeAssistant::initAlertLatencySensors() {
+#if HA_ENABLED
+  if (!haEnabled) return;
+  sprintf(haAlertLatencyP50ID, "%s_alert_latency_p50", deviceUniqueID);
+  haAlertLatencyP50 = new HASensorNumber(haAlertLatencyP50ID, HASensorNumber::PrecisionP1);
+  haAlertLatencyP50->setIcon("mdi:timer-outline");
+  haAlertLatencyP50->setName("Alert Latency p50");
+  haAlertLatencyP50->setUnitOfMeasurement("ms");
+  haAlertLatencyP50->setDeviceClass("duration");
+  sprintf(haAlertLatencyP99ID, "%s_alert_latency_p99", deviceUniqueID);
+  haAlertLatencyP99 = new HASensorNumber(haAlertLatencyP99ID, HASensorNumber::PrecisionP1);
+  haAlertLatencyP99->setIcon("mdi:timer-alert-outline");
+  haAlertLatencyP99->setName("Alert Latency p99");
+  haAlertLatencyP99->setUnitOfMeasurement("ms");
+  haAlertLatencyP99->setDeviceClass("duration");
+#endif
+}
+
 void JaamHomeAssistant::setUptime(int uptime) {
 #if HA_ENABLED
   if (!haEnabled) return;
@@ -726,3 +773,25 @@ void JaamHomeAssistant::setNightMode(bool nightMode) {
   haNightMode->setState(nightMode);
 #endif
 }
+
+void JaamHomeAssistant::setSchedulerMissedDeadlines(int missedDeadlines) {
+#if HA_ENABLED
+  if (!haEnabled) return;
+  haSchedulerMissed->setValue(missedDeadlines);
+#endif
+}
+
+void JaamHomeAssistant::setSchedulerSlowestJob(const char* jobName) {
+#if HA_ENABLED
+  if (!haEnabled) return;
+  haSchedulerSlowestJob->setValue(jobName);
+#endif
+}
+
+void JaamHomeAssistant::setAlertLatency(float p50, float p99) {
+#if HA_ENABLED
+  if (!haEnabled) return;
+  haAlertLatencyP50->setValue(p50);
+  haAlertLatencyP99->setValue(p99);
+#endif
+}
@@ -47,6 +47,9 @@ public:
     void initLightLevelSensor(float currentLightLevel);
     void initHomeTemperatureSensor();
     void initNightModeSensor(bool currentState, bool (*onChange)(bool newState));
+    void initSchedulerMissedDeadlinesSensor();
+    void initSchedulerSlowestJobSensor();
+    void initAlertLatencySensors();
 
     void setUptime(int uptime);
     void setWifiSignal(int wifiSignal);
@@ -74,5 +77,8 @@ public:
     void setLightLevel(float lightLevel);
     void setHomeTemperature(float homeTemperature);
     void setNightMode(bool nightMode);
+    void setSchedulerMissedDeadlines(int missedDeadlines);
+    void setSchedulerSlowestJob(const char* jobName);
+    void setAlertLatency(float p50, float p99);
 };
     
\ No newline at end of file
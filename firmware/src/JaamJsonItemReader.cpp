@@ -0,0 +1,103 @@
+#include "JaamJsonItemReader.h"
+#include <string.h>
+
+JaamJsonItemReader::JaamJsonItemReader(const char* arrayKey) {
+  this->arrayKey = arrayKey;
+  depth = 0;
+  inString = false;
+  escape = false;
+  inArray = false;
+  itemReady = false;
+  failed = false;
+  finished = false;
+  keyLength = 0;
+  itemLength = 0;
+}
+
+void JaamJsonItemReader::append(char c) {
+  if (itemLength == JSON_ITEM_MAX_SIZE) {
+    failed = true;
+    return;
+  }
+  item[itemLength++] = c;
+}
+
+size_t JaamJsonItemReader::read(const uint8_t* data, size_t length) {
+  itemReady = false;
+  size_t consumed = 0;
+  while (consumed < length && !itemReady && !failed) {
+    char c = (char) data[consumed++];
+    if (finished) {
+      if (c != ' ' && c != '\t' && c != '\r' && c != '\n') failed = true;
+      continue;
+    }
+    if (inString) {
+      if (escape) {
+        escape = false;
+      } else if (c == '\\') {
+        escape = true;
+      } else if (c == '"') {
+        inString = false;
+      }
+      if (itemLength > 0) {
+        append(c);
+      } else if (inString && depth == 1 && keyLength <= JSON_KEY_MAX_SIZE) {
+        // longer keys are kept truncated to one char more than the limit, so they never match
+        key[keyLength++] = c;
+      }
+      continue;
+    }
+    switch (c) {
+      case '"':
+        inString = true;
+        if (depth == 1) keyLength = 0;
+        break;
+      case '{':
+      case '[':
+        depth++;
+        if (depth == 2 && c == '[' && keyLength == strlen(arrayKey) && strncmp(key, arrayKey, keyLength) == 0) {
+          inArray = true;
+        } else if (depth == 3 && c == '{' && inArray) {
+          itemLength = 0;
+          item[itemLength++] = c;
+          continue;
+        }
+        break;
+      case '}':
+      case ']':
+        depth--;
+        if (depth < 0) {
+          failed = true;
+        } else if (depth == 0) {
+          finished = true;
+        } else if (depth == 1) {
+          inArray = false;
+        } else if (depth == 2 && itemLength > 0) {
+          append(c);
+          item[itemLength] = '\0';
+          itemLength = 0;
+          itemReady = !failed;
+          continue;
+        }
+        break;
+    }
+    if (itemLength > 0) append(c);
+  }
+  return consumed;
+}
+
+bool JaamJsonItemReader::hasItem() {
+  return itemReady;
+}
+
+const char* JaamJsonItemReader::getItem() {
+  return item;
+}
+
+bool JaamJsonItemReader::isFailed() {
+  return failed;
+}
+
+bool JaamJsonItemReader::isFinished() {
+  return finished && !failed;
+}
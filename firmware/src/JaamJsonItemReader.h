@@ -0,0 +1,38 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_ITEM_MAX_SIZE 512
+#define JSON_KEY_MAX_SIZE 32
+
+// Incremental reader of a JSON document that arrives in pieces, e.g. an upload. Objects of the array
+// under the given top level key are taken out one by one, so the document is never kept in memory
+// as a whole. Only nesting and strings are tracked here, items themselves should be parsed by caller.
+class JaamJsonItemReader {
+
+public:
+    JaamJsonItemReader(const char* arrayKey);
+    // consumes bytes until the next item is complete, returns number of consumed bytes
+    size_t read(const uint8_t* data, size_t length);
+    // true if the last read() completed an item, item text stays valid until the next read()
+    bool hasItem();
+    const char* getItem();
+    // document is not valid JSON or an item is bigger than JSON_ITEM_MAX_SIZE
+    bool isFailed();
+    // top level value was read completely
+    bool isFinished();
+
+private:
+    const char* arrayKey;
+    int depth;
+    bool inString;
+    bool escape;
+    bool inArray; // inside the array under arrayKey
+    bool itemReady;
+    bool failed;
+    bool finished;
+    char key[JSON_KEY_MAX_SIZE + 1]; // last string of the top level object, it is a key before a value
+    size_t keyLength;
+    char item[JSON_ITEM_MAX_SIZE + 1];
+    size_t itemLength; // 0 if item is not being read
+    void append(char c); // adds char to the item being read
+};
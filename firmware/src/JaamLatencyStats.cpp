@@ -0,0 +1,66 @@
+#include "JaamLatencyStats.h"
+#include <string.h>
+
+static const uint32_t BUCKET_BOUNDS[LATENCY_BUCKETS_COUNT - 1] = {200, 1000, 5000, 20000, 50000, 100000, 200000, 500000, 1000000};
+
+static const char* STAGE_NAMES[] = {
+  "network",
+  "parse",
+  "remap",
+  "show",
+  "device",
+  "total",
+};
+
+JaamLatencyStats::JaamLatencyStats() {
+  reset();
+}
+
+const char* JaamLatencyStats::getStageName(Stage stage) {
+  return STAGE_NAMES[stage];
+}
+
+uint32_t JaamLatencyStats::getBucketBound(int bucket) {
+  return bucket < LATENCY_BUCKETS_COUNT - 1 ? BUCKET_BOUNDS[bucket] : UINT32_MAX;
+}
+
+void JaamLatencyStats::add(Stage stage, uint32_t latency) {
+  int bucket = 0;
+  while (bucket < LATENCY_BUCKETS_COUNT - 1 && latency >= BUCKET_BOUNDS[bucket]) bucket++;
+  histogram[stage][bucket]++;
+  counts[stage]++;
+  if (latency > maxLatency[stage]) maxLatency[stage] = latency;
+}
+
+uint32_t JaamLatencyStats::getPercentile(Stage stage, int percent) {
+  // rank of the percentile sample, rounded up
+  uint64_t rank = ((uint64_t) counts[stage] * percent + 99) / 100;
+  uint64_t seen = 0;
+  for (int bucket = 0; bucket < LATENCY_BUCKETS_COUNT - 1; bucket++) {
+    seen += histogram[stage][bucket];
+    if (seen >= rank) {
+      // bound is never greater than real max
+      return BUCKET_BOUNDS[bucket] < maxLatency[stage] ? BUCKET_BOUNDS[bucket] : maxLatency[stage];
+    }
+  }
+  return maxLatency[stage];
+}
+
+JaamLatencyStats::Summary JaamLatencyStats::getSummary(Stage stage) {
+  Summary summary;
+  summary.count = counts[stage];
+  summary.p50 = counts[stage] > 0 ? getPercentile(stage, 50) : 0;
+  summary.p99 = counts[stage] > 0 ? getPercentile(stage, 99) : 0;
+  summary.max = maxLatency[stage];
+  return summary;
+}
+
+uint32_t JaamLatencyStats::getBucketCount(Stage stage, int bucket) {
+  return histogram[stage][bucket];
+}
+
+void JaamLatencyStats::reset() {
+  memset(histogram, 0, sizeof(histogram));
+  memset(counts, 0, sizeof(counts));
+  memset(maxLatency, 0, sizeof(maxLatency));
+}
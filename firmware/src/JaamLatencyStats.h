@@ -0,0 +1,39 @@
+#include <stdint.h>
+
+#define LATENCY_BUCKETS_COUNT 10
+
+// Histograms of alert update latency split by pipeline stage, in microseconds. Buckets have fixed
+// bounds, so percentiles are estimated as the upper bound of the bucket they fall into.
+class JaamLatencyStats {
+
+public:
+    enum Stage {
+        NETWORK, // server sent frame -> frame received, needs synced time on both sides
+        PARSE, // frame received -> data applied to regions state
+        REMAP, // data applied -> LEDs state remapped by render task, includes queue wait
+        SHOW, // LEDs state remapped -> frame shown
+        DEVICE, // frame received -> frame shown
+        TOTAL, // server sent frame -> frame shown
+        STAGES_COUNT
+    };
+    struct Summary {
+        uint32_t count;
+        uint32_t p50;
+        uint32_t p99;
+        uint32_t max;
+    };
+    JaamLatencyStats();
+    static const char* getStageName(Stage stage);
+    // upper bound of bucket in us, last bucket has no upper bound
+    static uint32_t getBucketBound(int bucket);
+    void add(Stage stage, uint32_t latency);
+    Summary getSummary(Stage stage);
+    uint32_t getBucketCount(Stage stage, int bucket);
+    void reset();
+
+private:
+    uint32_t histogram[STAGES_COUNT][LATENCY_BUCKETS_COUNT];
+    uint32_t counts[STAGES_COUNT];
+    uint32_t maxLatency[STAGES_COUNT];
+    uint32_t getPercentile(Stage stage, int percent);
+};
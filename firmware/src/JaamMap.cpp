@@ -0,0 +1,256 @@
+#include "JaamUtils.h"
+#include "JaamSettings.h"
+#include "JaamAlarms.h"
+#include "JaamPayloadParser.h"
+#include "JaamDeltaDecoder.h"
+#include "JaamMap.h"
+
+BrightnessProfile getBrightnessProfile(int legacy) {
+  BrightnessProfile profile;
+  profile.factor = 0.5f;
+  profile.minBrightness = 1;
+  profile.minBlinkBrightness = 0.05f;
+  if (legacy == 3) {
+    profile.factor = 0.3f;
+    profile.minBrightness = 2;
+    profile.minBlinkBrightness = 0.07f;
+  }
+  return profile;
+}
+
+uint32_t getBrightnessScale(float brightnessFactor) {
+  return lroundf(brightnessFactor * 255.0f / 10000.0f * 16777216.0f);
+}
+
+void loadRenderConfig(JaamSettings& settings, RenderConfig& config) {
+  config.generation = settings.getGeneration();
+  config.mapMode = settings.getInt(MAP_MODE);
+  config.alarmsAutoSwitch = settings.getInt(ALARMS_AUTO_SWITCH);
+  config.homeDistrict = settings.getInt(HOME_DISTRICT);
+  config.notifyMode = settings.getInt(ALARMS_NOTIFY_MODE);
+  config.enableExplosions = settings.getBool(ENABLE_EXPLOSIONS);
+  config.enableMissiles = settings.getBool(ENABLE_MISSILES);
+  config.enableDrones = settings.getBool(ENABLE_DRONES);
+  config.explosionPeriod = settings.getInt(EXPLOSION_TIME) * 60L;
+  config.alertOnPeriod = settings.getInt(ALERT_ON_TIME) * 60L;
+  config.alertOffPeriod = settings.getInt(ALERT_OFF_TIME) * 60L;
+  config.blinkTime = settings.getInt(ALERT_BLINK_TIME) * 1000L;
+  config.frameRate = settings.getInt(FRAME_RATE);
+  config.currentBrightness = settings.getInt(CURRENT_BRIGHTNESS);
+  config.bgStripEnabled = settings.getInt(BG_LED_PIN) > -1 && settings.getInt(BG_LED_COUNT) > 0;
+  config.bgLedCount = settings.getInt(BG_LED_COUNT);
+  config.colorAlert = settings.getInt(COLOR_ALERT);
+  config.colorClear = settings.getInt(COLOR_CLEAR);
+  config.colorNewAlert = settings.getInt(COLOR_NEW_ALERT);
+  config.colorAlertOver = settings.getInt(COLOR_ALERT_OVER);
+  config.colorExplosion = settings.getInt(COLOR_EXPLOSION);
+  config.colorMissiles = settings.getInt(COLOR_MISSILES);
+  config.colorDrones = settings.getInt(COLOR_DRONES);
+  config.colorHomeDistrict = settings.getInt(COLOR_HOME_DISTRICT);
+  config.colorBgNeighborAlert = settings.getInt(COLOR_BG_NEIGHBOR_ALERT);
+  config.brightnessNewAlert = settings.getInt(BRIGHTNESS_NEW_ALERT);
+  config.brightnessAlertOver = settings.getInt(BRIGHTNESS_ALERT_OVER);
+  config.brightnessExplosion = settings.getInt(BRIGHTNESS_EXPLOSION);
+  config.brightnessBg = settings.getInt(BRIGHTNESS_BG);
+  // percent * percent gives brightness in 1/100 of percent
+  config.alertBrightness = config.currentBrightness * settings.getInt(BRIGHTNESS_ALERT);
+  config.clearBrightness = config.currentBrightness * settings.getInt(BRIGHTNESS_CLEAR);
+  config.homeDistrictBrightness = config.currentBrightness * settings.getInt(BRIGHTNESS_HOME_DISTRICT);
+  config.bgBrightness = config.currentBrightness * config.brightnessBg;
+  config.fullBrightness = config.currentBrightness * 100;
+  config.weatherMinTemp = settings.getInt(WEATHER_MIN_TEMP);
+  config.weatherMaxTemp = settings.getInt(WEATHER_MAX_TEMP);
+  config.lampR = settings.getInt(HA_LIGHT_R);
+  config.lampG = settings.getInt(HA_LIGHT_G);
+  config.lampB = settings.getInt(HA_LIGHT_B);
+  config.lampBrightness = settings.getInt(HA_LIGHT_BRIGHTNESS);
+}
+
+bool loadLedLayout(JaamSettings& settings, LedLayout<MAIN_LEDS_COUNT>& layout) {
+  int kyivDistrictMode = settings.getInt(KYIV_DISTRICT_MODE);
+  if (kyivDistrictMode < 1 || kyivDistrictMode > KYIV_DISTRICT_MODES_COUNT) {
+    LOG.printf("Unknown Kyiv district mode: %d\n", kyivDistrictMode);
+    return false;
+  }
+  const char* customLayout = settings.getString(LED_LAYOUT);
+  int8_t customSlots[MAIN_LEDS_COUNT];
+  if (strlen(customLayout) > 0 && parseLedLayout(customLayout, customSlots)) {
+    memcpy(layout.ledSlots, customSlots, MAIN_LEDS_COUNT);
+    LOG.printf("Custom LED layout: %s\n", customLayout);
+  } else {
+    if (strlen(customLayout) > 0) {
+      LOG.printf("Invalid custom LED layout, default layout will be used: %s\n", customLayout);
+    }
+    if (settings.getInt(LEGACY) == 1) {
+      memcpy_P(layout.ledSlots, TRANSCARPATIA_START_LAYOUTS[kyivDistrictMode - 1], MAIN_LEDS_COUNT);
+      LOG.printf("Transcarpatia district mode %d\n", kyivDistrictMode);
+    } else {
+      memcpy_P(layout.ledSlots, ODESSA_START_LAYOUTS[kyivDistrictMode - 1], MAIN_LEDS_COUNT);
+      LOG.printf("Odessa district mode %d\n", kyivDistrictMode);
+    }
+  }
+  layout.combiMode = kyivDistrictMode == 4;
+  layout.kyivSlot = regionSlot(KYIV_REGION_ID);
+  layout.kyivOblSlot = regionSlot(KYIV_OBL_REGION_ID);
+  return true;
+}
+
+HomeDistrict getHomeDistrict(const LedLayout<MAIN_LEDS_COUNT>& layout, int regionId) {
+  HomeDistrict home;
+  home.leds = getSlotLeds(layout, regionSlot(regionId));
+  home.firstLed = home.leds ? __builtin_ctz(home.leds) : -1;
+  home.neighborSlots = 0;
+  auto neighbors = NEIGHBORING_DISTRICS.find(regionId);
+  if (neighbors != NEIGHBORING_DISTRICS.end()) {
+    for (int i = 0; i < neighbors->second.first; i++) {
+      int slot = regionSlot(neighbors->second.second[i]);
+      if (slot >= 0) home.neighborSlots |= 1UL << slot;
+    }
+  }
+  return home;
+}
+
+JaamDeltaSequence::Result JaamDeltaSequence::check(JaamDeltaDecoder& decoder) {
+  JaamDeltaDecoder::Type type = decoder.getType();
+  uint32_t frameSequence = decoder.getSequence();
+  if (decoder.isSnapshot()) {
+    snapshotReceived[type] = true;
+  } else if (!snapshotReceived[type]) {
+    return NO_SNAPSHOT;
+  } else if ((int32_t) (frameSequence - sequence[type]) <= 0) {
+    return OUTDATED;
+  } else if (frameSequence != sequence[type] + 1) {
+    // state is not trusted until a new snapshot
+    snapshotReceived[type] = false;
+    return GAP;
+  }
+  sequence[type] = frameSequence;
+  return APPLY;
+}
+
+void JaamDeltaSequence::reset() {
+  memset(snapshotReceived, 0, sizeof(snapshotReceived));
+}
+
+JaamPayloadParser::Payload applyDeltaFrame(JaamDeltaDecoder& decoder, AlarmsState<REGION_SLOTS_COUNT>& regions, uint32_t* changedSlots) {
+  *changedSlots = 0;
+  switch (decoder.getType()) {
+    case JaamDeltaDecoder::ALERTS:
+      *changedSlots = decoder.applyAlerts(regions.alertState, regions.alertTime, REGION_SLOTS_COUNT);
+      return JaamPayloadParser::ALERTS;
+    case JaamDeltaDecoder::EXPLOSIONS:
+      *changedSlots = decoder.applyTimes(regions.explosionTime, REGION_SLOTS_COUNT);
+      return JaamPayloadParser::EXPLOSIONS;
+    case JaamDeltaDecoder::MISSILES:
+      *changedSlots = decoder.applyTimes(regions.missilesTime, REGION_SLOTS_COUNT);
+      return JaamPayloadParser::MISSILES;
+    case JaamDeltaDecoder::DRONES:
+      *changedSlots = decoder.applyTimes(regions.dronesTime, REGION_SLOTS_COUNT);
+      return JaamPayloadParser::DRONES;
+    case JaamDeltaDecoder::WEATHER:
+      *changedSlots = decoder.applyTemperatures(regions.temperature, REGION_SLOTS_COUNT);
+      return JaamPayloadParser::WEATHER;
+    default:
+      return JaamPayloadParser::UNKNOWN;
+  }
+}
+
+static bool applyTimes(JaamPayloadParser& parser, const char* key, long current[], uint32_t* changedSlots) {
+  long times[REGION_SLOTS_COUNT] = {};
+  if (parser.readLongs(key, times, REGION_SLOTS_COUNT) < 0) return false;
+  *changedSlots = diffSlots(current, times, REGION_SLOTS_COUNT);
+  memcpy(current, times, sizeof(times));
+  return true;
+}
+
+JaamPayloadParser::Payload applyJsonPayload(JaamPayloadParser& parser, AlarmsState<REGION_SLOTS_COUNT>& regions, uint32_t* changedSlots) {
+  *changedSlots = 0;
+  JaamPayloadParser::Payload payload = parser.getPayload();
+  const char* name;
+  bool parsed;
+  switch (payload) {
+    case JaamPayloadParser::ALERTS: {
+      name = "alerts";
+      uint8_t states[REGION_SLOTS_COUNT] = {};
+      long times[REGION_SLOTS_COUNT] = {};
+      parsed = parser.readAlerts(name, states, times, REGION_SLOTS_COUNT) >= 0;
+      if (parsed) {
+        *changedSlots = diffSlots(regions.alertState, states, REGION_SLOTS_COUNT) | diffSlots(regions.alertTime, times, REGION_SLOTS_COUNT);
+        memcpy(regions.alertState, states, sizeof(states));
+        memcpy(regions.alertTime, times, sizeof(times));
+      }
+      break;
+    }
+    case JaamPayloadParser::WEATHER: {
+      name = "weather";
+      float weather[REGION_SLOTS_COUNT] = {};
+      parsed = parser.readFloats(name, weather, REGION_SLOTS_COUNT) >= 0;
+      if (parsed) {
+        *changedSlots = diffSlots(regions.temperature, weather, REGION_SLOTS_COUNT);
+        memcpy(regions.temperature, weather, sizeof(weather));
+      }
+      break;
+    }
+    case JaamPayloadParser::EXPLOSIONS:
+      name = "explosions";
+      parsed = applyTimes(parser, name, regions.explosionTime, changedSlots);
+      break;
+    case JaamPayloadParser::MISSILES:
+      name = "missiles";
+      parsed = applyTimes(parser, name, regions.missilesTime, changedSlots);
+      break;
+    case JaamPayloadParser::DRONES:
+      name = "drones";
+      parsed = applyTimes(parser, name, regions.dronesTime, changedSlots);
+      break;
+    default:
+      return JaamPayloadParser::UNKNOWN;
+  }
+  if (!parsed) {
+    LOG.printf("Failed to parse %s data\n", name);
+    return JaamPayloadParser::UNKNOWN;
+  }
+  LOG.printf("Successfully parsed %s data\n", name);
+  return payload;
+}
+
+bool getStateHash(JaamDeltaDecoder& decoder, const AlarmsState<REGION_SLOTS_COUNT>& regions, uint32_t* hash) {
+  // server hashes every record of the snapshot, so state of a newer server with more slots than applied
+  // can not be checked, hash would never match and every snapshot would be followed by a resync
+  int size = decoder.getCount();
+  if (!decoder.isSnapshot() || size > REGION_SLOTS_COUNT) return false;
+  switch (decoder.getType()) {
+    case JaamDeltaDecoder::ALERTS:
+      *hash = JaamDeltaDecoder::hashAlerts(regions.alertState, regions.alertTime, size);
+      return true;
+    case JaamDeltaDecoder::EXPLOSIONS:
+      *hash = JaamDeltaDecoder::hashTimes(regions.explosionTime, size);
+      return true;
+    case JaamDeltaDecoder::MISSILES:
+      *hash = JaamDeltaDecoder::hashTimes(regions.missilesTime, size);
+      return true;
+    case JaamDeltaDecoder::DRONES:
+      *hash = JaamDeltaDecoder::hashTimes(regions.dronesTime, size);
+      return true;
+    case JaamDeltaDecoder::WEATHER:
+      *hash = JaamDeltaDecoder::hashTemperatures(regions.temperature, size);
+      return true;
+    default:
+      return false;
+  }
+}
+
+AlarmsPass getAlarmsPass(bool fullRedraw, uint32_t dirtyLeds, uint32_t animatedLeds, bool bgStripDirty, const HomeDistrict& home) {
+  AlarmsPass pass;
+  pass.ledsToRender = fullRedraw ? ALL_LEDS : dirtyLeds | animatedLeds;
+  bool homeDistrictRendered = home.firstLed >= 0 && (pass.ledsToRender >> home.firstLed) & 1;
+  pass.renderBgStrip = fullRedraw || bgStripDirty || homeDistrictRendered;
+  return pass;
+}
+
+bool getBgStripColor(const RenderConfig& config, const AlarmsFrame& frame, const AlarmsState<MAIN_LEDS_COUNT>& leds, const HomeDistrict& home, LedColor* color) {
+  if (home.firstLed < 0) return false;
+  int led = home.firstLed;
+  *color = getAlarmColor(config, frame, leds.alertState[led], leds.alertTime[led], leds.explosionTime[led], leds.missilesTime[led], leds.dronesTime[led], true, true);
+  return true;
+}
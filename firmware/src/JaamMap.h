@@ -0,0 +1,68 @@
+#include <stdint.h>
+
+// Map pipeline steps shared by the firmware and host drivers: render config and LED layout from
+// settings, sequence of delta frames, applying data to regions state and choosing what to redraw.
+// Tasks, LED hardware, websocket replies and side effects of data stay with the caller.
+// Expects JaamSettings.h, JaamAlarms.h, JaamPayloadParser.h and JaamDeltaDecoder.h to be included before.
+
+// brightness limits of the board, LEGACY setting selects the board
+struct BrightnessProfile {
+    float factor; // share of LED power used at 100% brightness
+    int minBrightness; // percent
+    float minBlinkBrightness;
+};
+
+// home district LEDs and region slots of its neighbors
+struct HomeDistrict {
+    uint32_t leds;
+    int firstLed; // -1 if home district has no LED
+    uint32_t neighborSlots;
+};
+
+// LEDs of the alarms map to render in this frame
+struct AlarmsPass {
+    uint32_t ledsToRender;
+    bool renderBgStrip;
+};
+
+BrightnessProfile getBrightnessProfile(int legacy);
+// brightness factor as Q24 multiplier of brightness in 1/100 of percent, see scaleBrightness()
+uint32_t getBrightnessScale(float brightnessFactor);
+void loadRenderConfig(JaamSettings& settings, RenderConfig& config);
+// custom layout from settings or default layout of the board, returns false if Kyiv district mode is unknown
+bool loadLedLayout(JaamSettings& settings, LedLayout<MAIN_LEDS_COUNT>& layout);
+HomeDistrict getHomeDistrict(const LedLayout<MAIN_LEDS_COUNT>& layout, int regionId);
+
+// Delta frames of a type are applied after a snapshot of this type and only in sequence. A lost frame
+// makes state of the type untrusted until the next snapshot.
+class JaamDeltaSequence {
+
+public:
+    enum Result {
+        APPLY,
+        NO_SNAPSHOT, // delta frame before the first snapshot or after a gap
+        OUTDATED, // frame is not newer than the applied one
+        GAP // frames in between are lost, resync should be requested
+    };
+    // checks frame and takes its sequence if frame should be applied
+    Result check(JaamDeltaDecoder& decoder);
+    // next delta frames wait for a snapshot, e.g. after reconnect
+    void reset();
+
+private:
+    bool snapshotReceived[JaamDeltaDecoder::TYPES_COUNT] = {};
+    uint32_t sequence[JaamDeltaDecoder::TYPES_COUNT] = {};
+};
+
+// applies binary frame to regions state, returns type of applied data (UNKNOWN if frame has no data)
+JaamPayloadParser::Payload applyDeltaFrame(JaamDeltaDecoder& decoder, AlarmsState<REGION_SLOTS_COUNT>& regions, uint32_t* changedSlots);
+// applies JSON data payload to regions state, returns UNKNOWN if payload has no data or is malformed
+JaamPayloadParser::Payload applyJsonPayload(JaamPayloadParser& parser, AlarmsState<REGION_SLOTS_COUNT>& regions, uint32_t* changedSlots);
+// hash the server compares with a snapshot it sent, returns false if state of the snapshot can not be checked
+bool getStateHash(JaamDeltaDecoder& decoder, const AlarmsState<REGION_SLOTS_COUNT>& regions, uint32_t* hash);
+
+// all LEDs are rendered on full redraw (settings or map mode changed), otherwise only changed LEDs and
+// LEDs in transition; background strip follows the first home district LED
+AlarmsPass getAlarmsPass(bool fullRedraw, uint32_t dirtyLeds, uint32_t animatedLeds, bool bgStripDirty, const HomeDistrict& home);
+// color of background strip, returns false if home district has no LED and the strip should be black
+bool getBgStripColor(const RenderConfig& config, const AlarmsFrame& frame, const AlarmsState<MAIN_LEDS_COUNT>& leds, const HomeDistrict& home, LedColor* color);
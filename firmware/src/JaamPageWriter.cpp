@@ -0,0 +1,104 @@
+#include "JaamPageWriter.h"
+#include <string.h>
+
+JaamPageWriter::JaamPageWriter() {
+  buffer = NULL;
+  capacity = 0;
+  used = 0;
+  fragmentStart = 0;
+  full = false;
+  finished = false;
+  fragment = 0;
+  position = 0;
+  resumeFragment = 0;
+  resumeOffset = 0;
+  snapshotsCount = 0;
+  snapshotIndex = 0;
+}
+
+bool JaamPageWriter::begin(uint8_t* buffer, size_t capacity) {
+  if (finished) return false;
+  this->buffer = buffer;
+  this->capacity = capacity;
+  used = 0;
+  fragmentStart = 0;
+  full = false;
+  fragment = 0;
+  position = 0;
+  snapshotIndex = 0;
+  return true;
+}
+
+size_t JaamPageWriter::end() {
+  // render went through the whole page without filling the buffer, so nothing is left
+  if (!full) finished = true;
+  return used;
+}
+
+bool JaamPageWriter::beginFragment() {
+  fragment++;
+  position = 0;
+  fragmentStart = used;
+  return !full && fragment >= resumeFragment;
+}
+
+uint32_t JaamPageWriter::snapshot(uint32_t value) {
+  if (snapshotIndex < snapshotsCount) return snapshots[snapshotIndex++];
+  if (snapshotsCount < PAGE_SNAPSHOTS_MAX) {
+    snapshots[snapshotsCount++] = value;
+    snapshotIndex++;
+  }
+  return value;
+}
+
+void JaamPageWriter::fill(const char* fragment, std::initializer_list<const char*> args) {
+  if (!beginFragment()) return;
+  const char* literal = fragment;
+  const char* cursor = fragment;
+  while (*cursor) {
+    if (cursor[0] == '{' && cursor[1] >= '0' && cursor[1] <= '9' && cursor[2] == '}') {
+      write((const uint8_t*) literal, cursor - literal);
+      size_t index = cursor[1] - '0';
+      if (index < args.size() && args.begin()[index]) print(args.begin()[index]);
+      cursor += 3;
+      literal = cursor;
+    } else {
+      cursor++;
+    }
+  }
+  write((const uint8_t*) literal, cursor - literal);
+}
+
+size_t JaamPageWriter::write(uint8_t value) {
+  return write(&value, 1);
+}
+
+size_t JaamPageWriter::write(const uint8_t* data, size_t length) {
+  if (full || fragment < resumeFragment) return length;
+  size_t start = position;
+  position += length;
+  size_t skip = 0;
+  if (fragment == resumeFragment && start < resumeOffset) {
+    skip = resumeOffset - start < length ? resumeOffset - start : length;
+  }
+  size_t count = length - skip;
+  size_t room = capacity - used;
+  if (count <= room) {
+    memcpy(buffer + used, data + skip, count);
+    used += count;
+    return length;
+  }
+  full = true;
+  resumeFragment = fragment;
+  if (fragmentStart > 0) {
+    // fragment is sent with the next chunk as a whole
+    used = fragmentStart;
+    resumeOffset = 0;
+  } else {
+    // fragment is bigger than a chunk, so it is split
+    memcpy(buffer + used, data + skip, room);
+    used = capacity;
+    resumeOffset = start + skip + room;
+  }
+  return length;
+}
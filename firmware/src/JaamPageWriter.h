@@ -0,0 +1,46 @@
+#include <Print.h>
+#include <initializer_list>
+
+// Writes an HTML page into chunks of a chunked response without keeping the page in memory.
+// The page is rendered again for every chunk: bytes that were already sent are skipped and
+// rendering stops when the chunk is full. The page is split into fragments, a chunk that
+// cannot take the whole next fragment ends before it, so a fragment is taken from a single
+// render unless it is bigger than a chunk and values changed between renders can not break
+// markup in the middle of a fragment. Values that decide which fragments the page has should be
+// taken with snapshot, so the fragments do not shift between renders.
+#define PAGE_SNAPSHOTS_MAX 8
+
+class JaamPageWriter : public Print {
+
+public:
+    JaamPageWriter();
+    // starts a new render into buffer, returns false if the whole page was already written
+    bool begin(uint8_t* buffer, size_t capacity);
+    // finishes the render, returns number of bytes written into buffer
+    size_t end();
+    // starts a new fragment, returns false if its output is not needed by this render
+    bool beginFragment();
+    // returns value passed by the first render at the same call, so all renders of the page see the same
+    // value; values after the first PAGE_SNAPSHOTS_MAX are not kept
+    uint32_t snapshot(uint32_t value);
+    // writes fragment with {0}..{9} placeholders replaced by args
+    void fill(const char* fragment, std::initializer_list<const char*> args = {});
+    size_t write(uint8_t value) override;
+    size_t write(const uint8_t* data, size_t length) override;
+    using Print::write;
+
+private:
+    uint8_t* buffer;
+    size_t capacity;
+    size_t used;
+    size_t fragmentStart; // buffer position where the current fragment starts
+    bool full;
+    bool finished;
+    int fragment; // index of the current fragment, 0 is output before the first one
+    size_t position; // bytes of the current fragment produced by this render
+    int resumeFragment; // next render starts from this fragment...
+    size_t resumeOffset; // ...skipping this number of its bytes
+    uint32_t snapshots[PAGE_SNAPSHOTS_MAX];
+    int snapshotsCount;
+    int snapshotIndex; // next snapshot call of the current render
+};
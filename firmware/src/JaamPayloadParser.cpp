@@ -0,0 +1,246 @@
+#include "JaamPayloadParser.h"
+#include <string.h>
+
+struct PayloadName {
+  const char* name;
+  JaamPayloadParser::Payload payload;
+};
+
+static const PayloadName PAYLOAD_NAMES[] = {
+  {"ping", JaamPayloadParser::PING},
+  {"alerts", JaamPayloadParser::ALERTS},
+  {"weather", JaamPayloadParser::WEATHER},
+  {"explosions", JaamPayloadParser::EXPLOSIONS},
+  {"missiles", JaamPayloadParser::MISSILES},
+  {"drones", JaamPayloadParser::DRONES},
+  {"bins", JaamPayloadParser::BINS},
+  {"test_bins", JaamPayloadParser::TEST_BINS},
+};
+
+static const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+
+static bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+JaamPayloadParser::JaamPayloadParser(const char* data, size_t length) {
+  this->data = data;
+  this->end = data + length;
+}
+
+const char* JaamPayloadParser::skipSpaces(const char* pos) {
+  while (pos < end && isSpace(*pos)) pos++;
+  return pos;
+}
+
+// returns position of the value for "key" of the top-level object, or nullptr if key is not present.
+// strings are skipped as a whole and nesting is tracked, so keys of nested objects and string values
+// that are equal to the key (e.g. "payload":"alerts") are not matched
+const char* JaamPayloadParser::findValue(const char* key) {
+  size_t keyLength = strlen(key);
+  int depth = 0;
+  const char* pos = data;
+  while (pos < end) {
+    char c = *pos;
+    if (c == '{' || c == '[') {
+      depth++;
+    } else if (c == '}' || c == ']') {
+      depth--;
+    } else if (c == '"') {
+      const char* name = pos + 1;
+      pos = name;
+      while (pos < end && *pos != '"') pos += *pos == '\\' ? 2 : 1;
+      if (pos >= end) return nullptr;
+      if (depth == 1 && (size_t) (pos - name) == keyLength && memcmp(name, key, keyLength) == 0) {
+        const char* colon = skipSpaces(pos + 1);
+        if (colon < end && *colon == ':') return skipSpaces(colon + 1);
+      }
+    }
+    pos++;
+  }
+  return nullptr;
+}
+
+const char* JaamPayloadParser::readLong(const char* pos, long* value) {
+  pos = skipSpaces(pos);
+  if (end - pos >= 4 && memcmp(pos, "null", 4) == 0) {
+    *value = 0;
+    return pos + 4;
+  }
+  bool negative = false;
+  if (pos < end && *pos == '-') {
+    negative = true;
+    pos++;
+  }
+  if (pos >= end || !isDigit(*pos)) return nullptr;
+  long result = 0;
+  while (pos < end && isDigit(*pos)) {
+    result = result * 10 + (*pos - '0');
+    pos++;
+  }
+  // tolerate integers serialized as floats (e.g. 1700000000.0), fraction is dropped
+  if (pos < end && *pos == '.') {
+    pos++;
+    while (pos < end && isDigit(*pos)) pos++;
+  }
+  *value = negative ? -result : result;
+  return pos;
+}
+
+const char* JaamPayloadParser::readNumber(const char* pos, double* value) {
+  pos = skipSpaces(pos);
+  if (end - pos >= 4 && memcmp(pos, "null", 4) == 0) {
+    *value = 0;
+    return pos + 4;
+  }
+  bool negative = false;
+  if (pos < end && *pos == '-') {
+    negative = true;
+    pos++;
+  }
+  if (pos >= end || !isDigit(*pos)) return nullptr;
+  // mantissa is collected as integer and scaled once, so common values like 12.5 are exact
+  int64_t mantissa = 0;
+  int exponent = 0;
+  int digits = 0;
+  while (pos < end && isDigit(*pos)) {
+    if (digits < 18) {
+      mantissa = mantissa * 10 + (*pos - '0');
+      digits++;
+    } else {
+      exponent++;
+    }
+    pos++;
+  }
+  if (pos < end && *pos == '.') {
+    pos++;
+    while (pos < end && isDigit(*pos)) {
+      if (digits < 18) {
+        mantissa = mantissa * 10 + (*pos - '0');
+        digits++;
+        exponent--;
+      }
+      pos++;
+    }
+  }
+  if (pos < end && (*pos == 'e' || *pos == 'E')) {
+    pos++;
+    bool negativeExponent = false;
+    if (pos < end && (*pos == '-' || *pos == '+')) {
+      negativeExponent = *pos == '-';
+      pos++;
+    }
+    if (pos >= end || !isDigit(*pos)) return nullptr;
+    int explicitExponent = 0;
+    while (pos < end && isDigit(*pos)) {
+      if (explicitExponent < 1000) explicitExponent = explicitExponent * 10 + (*pos - '0');
+      pos++;
+    }
+    exponent += negativeExponent ? -explicitExponent : explicitExponent;
+  }
+  double result = (double) mantissa;
+  while (exponent > 0) {
+    int step = exponent > 15 ? 15 : exponent;
+    result *= POW10[step];
+    exponent -= step;
+  }
+  while (exponent < 0) {
+    int step = -exponent > 15 ? 15 : -exponent;
+    result /= POW10[step];
+    exponent += step;
+  }
+  *value = negative ? -result : result;
+  return pos;
+}
+
+JaamPayloadParser::Payload JaamPayloadParser::getPayload() {
+  const char* pos = findValue("payload");
+  if (!pos || pos >= end || *pos != '"') return UNKNOWN;
+  pos++;
+  const char* close = (const char*) memchr(pos, '"', end - pos);
+  if (!close) return UNKNOWN;
+  size_t length = close - pos;
+  for (const PayloadName& item : PAYLOAD_NAMES) {
+    if (strlen(item.name) == length && memcmp(item.name, pos, length) == 0) {
+      return item.payload;
+    }
+  }
+  return UNKNOWN;
+}
+
+// "key": [[state, time], [state, time], ...]
+int JaamPayloadParser::readAlerts(const char* key, uint8_t states[], long times[], int size) {
+  const char* pos = findValue(key);
+  if (!pos || pos >= end || *pos != '[') return -1;
+  pos = skipSpaces(pos + 1);
+  int count = 0;
+  if (pos < end && *pos == ']') return count;
+  while (pos < end) {
+    if (*pos != '[') return -1;
+    long state;
+    long time;
+    pos = readLong(pos + 1, &state);
+    if (!pos) return -1;
+    pos = skipSpaces(pos);
+    if (pos >= end || *pos != ',') return -1;
+    pos = readLong(pos + 1, &time);
+    if (!pos) return -1;
+    pos = skipSpaces(pos);
+    if (pos >= end || *pos != ']') return -1;
+    if (count < size) {
+      states[count] = (uint8_t) state;
+      times[count] = time;
+    }
+    count++;
+    pos = skipSpaces(pos + 1);
+    if (pos < end && *pos == ']') return count < size ? count : size;
+    if (pos >= end || *pos != ',') return -1;
+    pos = skipSpaces(pos + 1);
+  }
+  return -1;
+}
+
+// "key": [value, value, ...]
+int JaamPayloadParser::readLongs(const char* key, long values[], int size) {
+  const char* pos = findValue(key);
+  if (!pos || pos >= end || *pos != '[') return -1;
+  pos = skipSpaces(pos + 1);
+  int count = 0;
+  if (pos < end && *pos == ']') return count;
+  while (pos < end) {
+    long value;
+    pos = readLong(pos, &value);
+    if (!pos) return -1;
+    if (count < size) values[count] = value;
+    count++;
+    pos = skipSpaces(pos);
+    if (pos < end && *pos == ']') return count < size ? count : size;
+    if (pos >= end || *pos != ',') return -1;
+    pos++;
+  }
+  return -1;
+}
+
+int JaamPayloadParser::readFloats(const char* key, float values[], int size) {
+  const char* pos = findValue(key);
+  if (!pos || pos >= end || *pos != '[') return -1;
+  pos = skipSpaces(pos + 1);
+  int count = 0;
+  if (pos < end && *pos == ']') return count;
+  while (pos < end) {
+    double value;
+    pos = readNumber(pos, &value);
+    if (!pos) return -1;
+    if (count < size) values[count] = (float) value;
+    count++;
+    pos = skipSpaces(pos);
+    if (pos < end && *pos == ']') return count < size ? count : size;
+    if (pos >= end || *pos != ',') return -1;
+    pos++;
+  }
+  return -1;
+}
@@ -0,0 +1,36 @@
+#include <stddef.h>
+#include <stdint.h>
+
+// Allocation-free reader for websocket payloads. Works directly on the received
+// frame buffer: no DOM is built and nothing is copied, values are written
+// straight into caller provided fixed-size arrays.
+class JaamPayloadParser {
+
+public:
+    enum Payload {
+        UNKNOWN,
+        PING,
+        ALERTS,
+        WEATHER,
+        EXPLOSIONS,
+        MISSILES,
+        DRONES,
+        BINS,
+        TEST_BINS
+    };
+    JaamPayloadParser(const char* data, size_t length);
+    Payload getPayload();
+    // Each read method returns the number of parsed items or -1 if the frame is malformed.
+    // Items missing in the frame are left untouched.
+    int readAlerts(const char* key, uint8_t states[], long times[], int size);
+    int readLongs(const char* key, long values[], int size);
+    int readFloats(const char* key, float values[], int size);
+
+private:
+    const char* data;
+    const char* end;
+    const char* findValue(const char* key);
+    const char* skipSpaces(const char* pos);
+    const char* readNumber(const char* pos, double* value);
+    const char* readLong(const char* pos, long* value);
+};
@@ -0,0 +1,51 @@
+#include "JaamProfiler.h"
+#include <algorithm>
+#include <string.h>
+
+static const char* STAGE_NAMES[] = {
+  "mapAlarms",
+  "processAlarms",
+  "FastLED.show",
+  "displayCycle",
+  "onMessageCallback",
+};
+
+static_assert(sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]) == JaamProfiler::STAGES_COUNT, "Every stage should have a name");
+
+JaamProfiler::JaamProfiler() {
+  reset();
+}
+
+const char* JaamProfiler::getStageName(Stage stage) {
+  return STAGE_NAMES[stage];
+}
+
+void JaamProfiler::add(Stage stage, uint32_t cycles) {
+  samples[stage][counts[stage] % PROFILER_SAMPLES_COUNT] = cycles;
+  counts[stage]++;
+  if (cycles < minCycles[stage]) minCycles[stage] = cycles;
+  if (cycles > maxCycles[stage]) maxCycles[stage] = cycles;
+}
+
+// min and max cover all samples since reset, percentiles only the last PROFILER_SAMPLES_COUNT ones
+JaamProfiler::Summary JaamProfiler::getSummary(Stage stage) {
+  Summary summary = {counts[stage], 0, 0, 0, 0};
+  if (summary.count == 0) return summary;
+  uint32_t sorted[PROFILER_SAMPLES_COUNT];
+  int size = std::min(counts[stage], (uint32_t) PROFILER_SAMPLES_COUNT);
+  memcpy(sorted, samples[stage], size * sizeof(uint32_t));
+  std::sort(sorted, sorted + size);
+  summary.min = minCycles[stage];
+  summary.p50 = sorted[(size - 1) * 50 / 100];
+  summary.p99 = sorted[(size - 1) * 99 / 100];
+  summary.max = maxCycles[stage];
+  return summary;
+}
+
+void JaamProfiler::reset() {
+  memset(counts, 0, sizeof(counts));
+  memset(maxCycles, 0, sizeof(maxCycles));
+  for (int stage = 0; stage < STAGES_COUNT; stage++) {
+    minCycles[stage] = UINT32_MAX;
+  }
+}
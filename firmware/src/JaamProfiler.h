@@ -0,0 +1,36 @@
+#include <stdint.h>
+
+#define PROFILER_SAMPLES_COUNT 64
+
+// Collects durations of render loop stages (in CPU cycles) and reports min, p50, p99 and max
+// over the last PROFILER_SAMPLES_COUNT samples of every stage.
+class JaamProfiler {
+
+public:
+    enum Stage {
+        MAP_ALARMS,
+        PROCESS_ALARMS,
+        LEDS_SHOW,
+        DISPLAY_CYCLE,
+        WS_MESSAGE,
+        STAGES_COUNT
+    };
+    struct Summary {
+        uint32_t count;
+        uint32_t min;
+        uint32_t p50;
+        uint32_t p99;
+        uint32_t max;
+    };
+    JaamProfiler();
+    static const char* getStageName(Stage stage);
+    void add(Stage stage, uint32_t cycles);
+    Summary getSummary(Stage stage);
+    void reset();
+
+private:
+    uint32_t samples[STAGES_COUNT][PROFILER_SAMPLES_COUNT];
+    uint32_t counts[STAGES_COUNT];
+    uint32_t minCycles[STAGES_COUNT];
+    uint32_t maxCycles[STAGES_COUNT];
+};
@@ -0,0 +1,234 @@
+#include "JaamScheduler.h"
+#include <string.h>
+
+static const uint32_t HISTOGRAM_BOUNDS[SCHEDULER_HISTOGRAM_BUCKETS - 1] = {100, 500, 1000, 5000, 10000, 50000};
+
+static const char* PRIORITY_NAMES[] = {
+  "low",
+  "normal",
+  "high",
+};
+
+// deadlines are compared as signed difference, so micros() overflow every ~71 minutes is handled
+static bool isReached(uint32_t now, uint32_t deadline) {
+  return (int32_t) (now - deadline) >= 0;
+}
+
+// 0, 1/2, 1/4, 3/4, 1/8, ... of the period: jobs with the same period are spread evenly
+// no matter how many of them will be registered
+static uint32_t staggerOffset(uint32_t period, int sameCount) {
+  uint32_t reversed = 0;
+  for (int bit = 0; bit < 8; bit++) {
+    if (sameCount & (1 << bit)) reversed |= 1 << (7 - bit);
+  }
+  return (uint64_t) period * reversed / 256;
+}
+
+JaamScheduler::JaamScheduler(unsigned long (*clock)()) {
+  this->clock = clock;
+  memset(jobs, 0, sizeof(jobs));
+  heapSize = 0;
+}
+
+int JaamScheduler::setInterval(Callback callback, uint32_t periodMs, const char* name, Priority priority) {
+  int sameCount = 0;
+  for (const Job& job : jobs) {
+    if (job.state != FREE && job.repeat && job.stats.period == periodMs) sameCount++;
+  }
+  return addJob(callback, periodMs, staggerOffset(periodMs * 1000, sameCount), name, priority, true);
+}
+
+int JaamScheduler::setTimeout(Callback callback, uint32_t delayMs, const char* name, Priority priority) {
+  return addJob(callback, delayMs, delayMs * 1000, name, priority, false);
+}
+
+int JaamScheduler::addJob(Callback callback, uint32_t periodMs, uint32_t firstDelay, const char* name, Priority priority, bool repeat) {
+  for (int id = 0; id < SCHEDULER_MAX_JOBS; id++) {
+    Job& job = jobs[id];
+    if (job.state != FREE) continue;
+    memset(&job, 0, sizeof(Job));
+    job.callback = callback;
+    job.name = name;
+    job.period = periodMs * 1000;
+    job.deadline = clock() + firstDelay;
+    job.priority = priority;
+    job.repeat = repeat;
+    job.stats.name = name;
+    job.stats.period = periodMs;
+    job.stats.priority = priority;
+    job.stats.repeat = repeat;
+    heapPush(id);
+    return id;
+  }
+  return -1;
+}
+
+void JaamScheduler::cancel(int id) {
+  if (id < 0 || id >= SCHEDULER_MAX_JOBS) return;
+  Job& job = jobs[id];
+  switch (job.state) {
+    case SCHEDULED:
+      heapRemove(job.heapIndex);
+      job.state = FREE;
+      break;
+    case DUE:
+      // popped from heap by run(), slot is released there
+      job.state = CANCELLED;
+      break;
+    default:
+      break;
+  }
+}
+
+void JaamScheduler::run() {
+  uint32_t now = clock();
+  uint8_t due[SCHEDULER_MAX_JOBS];
+  int dueCount = 0;
+  while (heapSize > 0 && isReached(now, jobs[heap[0]].deadline)) {
+    uint8_t id = heap[0];
+    heapRemove(0);
+    jobs[id].state = DUE;
+    due[dueCount++] = id;
+  }
+  // heap gives due jobs ordered by deadline, reorder them by priority keeping deadline order inside a priority
+  for (int i = 1; i < dueCount; i++) {
+    uint8_t id = due[i];
+    int j = i - 1;
+    while (j >= 0 && jobs[due[j]].priority < jobs[id].priority) {
+      due[j + 1] = due[j];
+      j--;
+    }
+    due[j + 1] = id;
+  }
+  for (int i = 0; i < dueCount; i++) {
+    uint8_t id = due[i];
+    if (jobs[id].state == CANCELLED) {
+      jobs[id].state = FREE;
+      continue;
+    }
+    uint32_t start = clock();
+    jobs[id].callback();
+    finishRun(id, start, clock());
+  }
+}
+
+void JaamScheduler::finishRun(uint8_t id, uint32_t start, uint32_t end) {
+  Job& job = jobs[id];
+  JobStats& stats = job.stats;
+  uint32_t lateness = start - job.deadline;
+  uint32_t runTime = end - start;
+  stats.runs++;
+  if (lateness > stats.maxLateness) stats.maxLateness = lateness;
+  if (runTime > stats.maxRunTime) stats.maxRunTime = runTime;
+  stats.totalRunTime += runTime;
+  int bucket = 0;
+  while (bucket < SCHEDULER_HISTOGRAM_BUCKETS - 1 && runTime >= HISTOGRAM_BOUNDS[bucket]) bucket++;
+  stats.histogram[bucket]++;
+
+  if (job.state == CANCELLED || !job.repeat) {
+    job.state = FREE;
+    return;
+  }
+  // keep original phase, periods that already passed are counted as missed and skipped instead of run in a burst
+  job.deadline += job.period;
+  if (job.period > 0 && isReached(end, job.deadline)) {
+    uint32_t skipped = (end - job.deadline) / job.period + 1;
+    stats.missed += skipped;
+    job.deadline += skipped * job.period;
+  }
+  heapPush(id);
+}
+
+bool JaamScheduler::getJobStats(int id, JobStats* stats) {
+  if (id < 0 || id >= SCHEDULER_MAX_JOBS || jobs[id].state == FREE) return false;
+  *stats = jobs[id].stats;
+  return true;
+}
+
+static_assert(SCHEDULER_MAX_JOBS <= 32, "Every job should have a bit in jobs mask");
+
+uint32_t JaamScheduler::getJobsMask() {
+  uint32_t mask = 0;
+  for (int id = 0; id < SCHEDULER_MAX_JOBS; id++) {
+    if (jobs[id].state != FREE) mask |= 1UL << id;
+  }
+  return mask;
+}
+
+uint32_t JaamScheduler::getMissedDeadlines() {
+  uint32_t missed = 0;
+  for (const Job& job : jobs) {
+    if (job.state != FREE) missed += job.stats.missed;
+  }
+  return missed;
+}
+
+const char* JaamScheduler::getSlowestJob() {
+  const Job* slowest = nullptr;
+  for (const Job& job : jobs) {
+    if (job.state == FREE || job.stats.runs == 0) continue;
+    if (!slowest || job.stats.maxRunTime > slowest->stats.maxRunTime) slowest = &job;
+  }
+  return slowest ? slowest->name : "";
+}
+
+const char* JaamScheduler::getPriorityName(Priority priority) {
+  return PRIORITY_NAMES[priority];
+}
+
+uint32_t JaamScheduler::getHistogramBound(int bucket) {
+  return bucket < SCHEDULER_HISTOGRAM_BUCKETS - 1 ? HISTOGRAM_BOUNDS[bucket] : UINT32_MAX;
+}
+
+// earlier deadline goes first, on equal deadlines higher priority goes first
+bool JaamScheduler::isBefore(uint8_t first, uint8_t second) {
+  int32_t diff = (int32_t) (jobs[first].deadline - jobs[second].deadline);
+  if (diff != 0) return diff < 0;
+  return jobs[first].priority > jobs[second].priority;
+}
+
+void JaamScheduler::heapSwap(int first, int second) {
+  uint8_t id = heap[first];
+  heap[first] = heap[second];
+  heap[second] = id;
+  jobs[heap[first]].heapIndex = first;
+  jobs[heap[second]].heapIndex = second;
+}
+
+void JaamScheduler::siftUp(int index) {
+  while (index > 0) {
+    int parent = (index - 1) / 2;
+    if (!isBefore(heap[index], heap[parent])) return;
+    heapSwap(index, parent);
+    index = parent;
+  }
+}
+
+void JaamScheduler::siftDown(int index) {
+  while (true) {
+    int smallest = index;
+    int left = index * 2 + 1;
+    int right = left + 1;
+    if (left < heapSize && isBefore(heap[left], heap[smallest])) smallest = left;
+    if (right < heapSize && isBefore(heap[right], heap[smallest])) smallest = right;
+    if (smallest == index) return;
+    heapSwap(index, smallest);
+    index = smallest;
+  }
+}
+
+void JaamScheduler::heapPush(uint8_t id) {
+  jobs[id].state = SCHEDULED;
+  jobs[id].heapIndex = heapSize;
+  heap[heapSize++] = id;
+  siftUp(heapSize - 1);
+}
+
+void JaamScheduler::heapRemove(int index) {
+  heapSize--;
+  if (index != heapSize) {
+    heapSwap(index, heapSize);
+    siftDown(index);
+    siftUp(index);
+  }
+}
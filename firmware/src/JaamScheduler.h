@@ -0,0 +1,78 @@
+#include <stdint.h>
+
+#define SCHEDULER_MAX_JOBS 24
+#define SCHEDULER_HISTOGRAM_BUCKETS 7
+
+// Cooperative scheduler for periodic jobs and one-shot timeouts. Jobs are kept in a min-heap
+// ordered by deadline, due jobs are started by priority. Every job collects number of runs,
+// missed deadlines (periods skipped because job was started too late), max lateness and a
+// histogram of run times. Jobs with the same period are spread over the period on registration.
+// Not thread safe: setInterval, setTimeout, cancel and run should be called from the same task.
+class JaamScheduler {
+
+public:
+    typedef void (*Callback)();
+    enum Priority {
+        PRIORITY_LOW,
+        PRIORITY_NORMAL,
+        PRIORITY_HIGH
+    };
+    struct JobStats {
+        const char* name;
+        uint32_t period; // ms
+        Priority priority;
+        bool repeat;
+        uint32_t runs;
+        uint32_t missed;
+        uint32_t maxLateness; // us
+        uint32_t maxRunTime; // us
+        uint64_t totalRunTime; // us
+        uint32_t histogram[SCHEDULER_HISTOGRAM_BUCKETS];
+    };
+    // clock should return microseconds, e.g. micros()
+    JaamScheduler(unsigned long (*clock)());
+    // Both return job id or -1 if there are no free slots
+    int setInterval(Callback callback, uint32_t periodMs, const char* name, Priority priority = PRIORITY_NORMAL);
+    int setTimeout(Callback callback, uint32_t delayMs, const char* name, Priority priority = PRIORITY_NORMAL);
+    void cancel(int id);
+    void run();
+    bool getJobStats(int id, JobStats* stats);
+    // bit N is set if job N is registered
+    uint32_t getJobsMask();
+    uint32_t getMissedDeadlines();
+    const char* getSlowestJob();
+    static const char* getPriorityName(Priority priority);
+    // upper bounds of histogram buckets in us, last bucket has no upper bound
+    static uint32_t getHistogramBound(int bucket);
+
+private:
+    enum State : uint8_t {
+        FREE,
+        SCHEDULED,
+        DUE,
+        CANCELLED
+    };
+    struct Job {
+        Callback callback;
+        const char* name;
+        uint32_t period; // us
+        uint32_t deadline; // us
+        Priority priority;
+        bool repeat;
+        State state;
+        uint8_t heapIndex;
+        JobStats stats;
+    };
+    unsigned long (*clock)();
+    Job jobs[SCHEDULER_MAX_JOBS];
+    uint8_t heap[SCHEDULER_MAX_JOBS];
+    int heapSize;
+    int addJob(Callback callback, uint32_t periodMs, uint32_t firstDelay, const char* name, Priority priority, bool repeat);
+    bool isBefore(uint8_t first, uint8_t second);
+    void heapSwap(int first, int second);
+    void siftUp(int index);
+    void siftDown(int index);
+    void heapPush(uint8_t id);
+    void heapRemove(int index);
+    void finishRun(uint8_t id, uint32_t start, uint32_t end);
+};
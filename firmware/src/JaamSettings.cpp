@@ -2,8 +2,8 @@
 #include <Preferences.h>
 #include <ArduinoJson.h>
 #include <JaamUtils.h>
-#include <stdexcept>
-#include <map>
+#include <limits.h>
+#include <mutex>
 
 JaamSettings::JaamSettings() {
 }
@@ -12,148 +12,271 @@ const char* PF_STRING = "S";
 const char* PF_INT = "I";
 const char* PF_FLOAT = "F";
 
-struct SettingItemInt {
-    const char* key;
-    int value;
+enum SettingKind : uint8_t {
+    KIND_INT,
+    KIND_FLOAT,
+    KIND_STRING,
 };
 
-struct SettingItemString {
-    const char* key;
-    String value;
+enum SettingFlag : uint8_t {
+    SETTING_NOT_RESTORED = 1 << 0, // skipped on settings backup restore
 };
 
-struct SettingItemFloat {
+struct SettingDescriptor {
+    Type type;
     const char* key;
-    float value;
+    SettingKind kind;
+    int defaultInt;
+    float defaultFloat;
+    const char* defaultString;
+    int min; // for int and float settings
+    int max;
+    uint8_t flags;
+    // ids of the select box the value is chosen from, when they are not a plain range
+    const SettingListItem* options;
+    int optionsCount;
 };
 
-std::map<Type, SettingItemInt> intSettings = {
-    {WS_SERVER_PORT, {"wsnp", 80}},
-    {UPDATE_SERVER_PORT, {"upp", 80}},
-    {LEGACY, {"legacy", 1}},
-    {MAIN_LED_PIN, {"pp", 13}},
-    {BG_LED_PIN, {"bpp", -1}},
-    {BG_LED_COUNT, {"bpc", 0}},
-    {SERVICE_LED_PIN, {"slp", -1}},
-    {BUTTON_1_PIN, {"bp", -1}},
-    {BUTTON_2_PIN, {"b2p", -1}},
-    {ALERT_PIN, {"ap", -1}},
-    {CLEAR_PIN, {"cp", -1}},
-    {BUZZER_PIN, {"bzp", -1}},
-    {LIGHT_SENSOR_PIN, {"lp", -1}},
-    {POWER_PIN, {"powp", 12}},
-    {WIFI_PIN, {"wifip", 14}},
-    {DATA_PIN, {"datap", 25}},
-    {HA_PIN, {"hap", 26}},
-    {RESERVED_PIN, {"resp", 27}},
-    {ALERT_CLEAR_PIN_MODE, {"acpm", 0}},
-    {HA_MQTT_PORT, {"ha_mqttport", 1883}},
-    {CURRENT_BRIGHTNESS, {"cbr", 50}},
-    {BRIGHTNESS, {"brightness", 50}},
-    {BRIGHTNESS_DAY, {"brd", 50}},
-    {BRIGHTNESS_NIGHT, {"brn", 5}},
-    {BRIGHTNESS_MODE, {"bra", 0}},
-    {HOME_ALERT_TIME, {"hat", 0}},
-    {COLOR_ALERT, {"coloral", 0}},
-    {COLOR_CLEAR, {"colorcl", 120}},
-    {COLOR_NEW_ALERT, {"colorna", 30}},
-    {COLOR_ALERT_OVER, {"colorao", 100}},
-    {COLOR_EXPLOSION, {"colorex", 180}},
-    {COLOR_MISSILES, {"colormi", 275}},
-    {COLOR_DRONES, {"colordr", 330}},
-    {COLOR_HOME_DISTRICT, {"colorhd", 120}},
-    {COLOR_BG_NEIGHBOR_ALERT, {"colorbna", 30}},
-    {ENABLE_EXPLOSIONS, {"eex", 1}},
-    {ENABLE_MISSILES, {"emi", 1}},
-    {ENABLE_DRONES, {"edr", 1}},
-    {BRIGHTNESS_ALERT, {"ba", 100}},
-    {BRIGHTNESS_CLEAR, {"bc", 100}},
-    {BRIGHTNESS_NEW_ALERT, {"bna", 100}},
-    {BRIGHTNESS_ALERT_OVER, {"bao", 100}},
-    {BRIGHTNESS_EXPLOSION, {"bex", 100}},
-    {BRIGHTNESS_HOME_DISTRICT, {"bhd", 100}},
-    {BRIGHTNESS_BG, {"bbg", 100}},
-    {BRIGHTNESS_SERVICE, {"bs", 50}},
-    {WEATHER_MIN_TEMP, {"mintemp", -10}},
-    {WEATHER_MAX_TEMP, {"maxtemp", 30}},
-    {ALARMS_AUTO_SWITCH, {"aas", 1}},
-    {HOME_DISTRICT, {"hmd", 31}},
-    {KYIV_DISTRICT_MODE, {"kdm", 1}},
-    {SERVICE_DIODES_MODE, {"sdm", 0}},
-    {NEW_FW_NOTIFICATION, {"nfwn", 1}},
-    {HA_LIGHT_BRIGHTNESS, {"ha_lbri", 50}},
-    {HA_LIGHT_R, {"ha_lr", 215}},
-    {HA_LIGHT_G, {"ha_lg", 7}},
-    {HA_LIGHT_B, {"ha_lb", 255}},
-    {SOUND_ON_MIN_OF_SL, {"somos", 0}},
-    {SOUND_ON_ALERT, {"soa", 0}},
-    {MELODY_ON_ALERT, {"moa", 4}},
-    {SOUND_ON_ALERT_END, {"soae", 0}},
-    {MELODY_ON_ALERT_END, {"moae", 5}},
-    {SOUND_ON_EXPLOSION, {"soex", 0}},
-    {MELODY_ON_EXPLOSION, {"moex", 18}},
-    {SOUND_ON_EVERY_HOUR, {"soeh", 0}},
-    {SOUND_ON_BUTTON_CLICK, {"sobc", 0}},
-    {MUTE_SOUND_ON_NIGHT, {"mson", 0}},
-    {MELODY_VOLUME, {"mv", 100}},
-    {INVERT_DISPLAY, {"invd", 0}},
-    {DIM_DISPLAY_ON_NIGHT, {"ddon", 1}},
-    {IGNORE_MUTE_ON_ALERT, {"imoa", 0}},
-    {MAP_MODE, {"mapmode", 1}},
-    {DISPLAY_MODE, {"dm", 2}},
-    {DISPLAY_MODE_TIME, {"dmt", 5}},
-    {TOGGLE_MODE_WEATHER, {"tmw", 1}},
-    {TOGGLE_MODE_TEMP, {"tmt", 1}},
-    {TOGGLE_MODE_HUM, {"tmh", 1}},
-    {TOGGLE_MODE_PRESS, {"tmp", 1}},
-    {BUTTON_1_MODE, {"bm", 0}},
-    {BUTTON_2_MODE, {"b2m", 0}},
-    {BUTTON_1_MODE_LONG, {"bml", 0}},
-    {BUTTON_2_MODE_LONG, {"b2ml", 0}},
-    {USE_TOUCH_BUTTON_1, {"utb1", 0}},
-    {USE_TOUCH_BUTTON_2, {"utb2", 0}},
-    {ALARMS_NOTIFY_MODE, {"anm", 2}},
-    {DISPLAY_MODEL, {"dsmd", 1}},
-    {DISPLAY_WIDTH, {"dw", 128}},
-    {DISPLAY_HEIGHT, {"dh", 32}},
-    {DAY_START, {"ds", 8}},
-    {NIGHT_START, {"ns", 22}},
-    {WS_ALERT_TIME, {"wsat", 150000}},
-    {WS_REBOOT_TIME, {"wsrt", 300000}},
-    {MIN_OF_SILENCE, {"mos", 1}},
-    {FW_UPDATE_CHANNEL, {"fwuc", 0}},
-    {TIME_ZONE, {"tz", 2}},
-    {ALERT_ON_TIME, {"aont", 5}},
-    {ALERT_OFF_TIME, {"aoft", 5}},
-    {EXPLOSION_TIME, {"ext", 3}},
-    {ALERT_BLINK_TIME, {"abt", 3}},
+// the highest GPIO number of ESP32
+static constexpr int MAX_PIN = 39;
 
-};
+static constexpr SettingDescriptor intSetting(Type type, const char* key, int defaultValue, int min = INT_MIN, int max = INT_MAX, uint8_t flags = 0) {
+    return {type, key, KIND_INT, defaultValue, 0.0f, nullptr, min, max, flags, nullptr, 0};
+}
 
-std::map<Type, SettingItemString> stringSettings = {
-    {ID, {"id", "github"}},
-    {DEVICE_NAME, {"dn", "JAAM"}},
-    {DEVICE_DESCRIPTION, {"dd", "JAAM Informer"}},
-    {BROADCAST_NAME, {"bn", "jaam"}},
-    {WS_SERVER_HOST, {"wshost", "ws.jaam.net.ua"}},
-    {NTP_HOST, {"ntph", "time.google.com"}},
-    {HA_MQTT_USER, {"ha_mqttuser", ""}},
-    {HA_MQTT_PASSWORD, {"ha_mqttpass", ""}},
-    {HA_BROKER_ADDRESS, {"ha_brokeraddr", ""}},
+static constexpr SettingDescriptor optionSetting(Type type, const char* key, int defaultValue, const SettingListItem* options, int optionsCount) {
+    return {type, key, KIND_INT, defaultValue, 0.0f, nullptr, INT_MIN, INT_MAX, 0, options, optionsCount};
+}
+
+static constexpr SettingDescriptor boolSetting(Type type, const char* key, int defaultValue) {
+    return intSetting(type, key, defaultValue, 0, 1);
+}
+
+static constexpr SettingDescriptor floatSetting(Type type, const char* key, float defaultValue, int min = INT_MIN, int max = INT_MAX) {
+    return {type, key, KIND_FLOAT, 0, defaultValue, nullptr, min, max, 0, nullptr, 0};
+}
+
+static constexpr SettingDescriptor stringSetting(Type type, const char* key, const char* defaultValue, uint8_t flags = 0) {
+    return {type, key, KIND_STRING, 0, 0.0f, defaultValue, INT_MIN, INT_MAX, flags, nullptr, 0};
+}
+
+// indexed by Type, order must match the enum (checked below)
+static constexpr SettingDescriptor SETTINGS[] = {
+    stringSetting(ID, "id", "github", SETTING_NOT_RESTORED),
+    stringSetting(DEVICE_NAME, "dn", "JAAM"),
+    stringSetting(DEVICE_DESCRIPTION, "dd", "JAAM Informer"),
+    stringSetting(BROADCAST_NAME, "bn", "jaam"),
+    stringSetting(WS_SERVER_HOST, "wshost", "ws.jaam.net.ua"),
+    intSetting(WS_SERVER_PORT, "wsnp", 80, 1, 65535),
+    intSetting(UPDATE_SERVER_PORT, "upp", 80, 1, 65535),
+    stringSetting(NTP_HOST, "ntph", "time.google.com"),
+    optionSetting(LEGACY, "legacy", 1, LEGACY_OPTIONS, LEGACY_OPTIONS_COUNT),
+    intSetting(MAIN_LED_PIN, "pp", 13, -1, MAX_PIN),
+    intSetting(BG_LED_PIN, "bpp", -1, -1, MAX_PIN),
+    intSetting(BG_LED_COUNT, "bpc", 0, 0),
+    intSetting(SERVICE_LED_PIN, "slp", -1, -1, MAX_PIN),
+    intSetting(BUTTON_1_PIN, "bp", -1, -1, MAX_PIN),
+    intSetting(BUTTON_2_PIN, "b2p", -1, -1, MAX_PIN),
+    intSetting(ALERT_PIN, "ap", -1, -1, MAX_PIN),
+    intSetting(CLEAR_PIN, "cp", -1, -1, MAX_PIN),
+    intSetting(BUZZER_PIN, "bzp", -1, -1, MAX_PIN),
+    intSetting(LIGHT_SENSOR_PIN, "lp", -1, -1, MAX_PIN),
+    intSetting(POWER_PIN, "powp", 12, -1, MAX_PIN),
+    intSetting(WIFI_PIN, "wifip", 14, -1, MAX_PIN),
+    intSetting(DATA_PIN, "datap", 25, -1, MAX_PIN),
+    intSetting(HA_PIN, "hap", 26, -1, MAX_PIN),
+    intSetting(RESERVED_PIN, "resp", 27, -1, MAX_PIN),
+    optionSetting(ALERT_CLEAR_PIN_MODE, "acpm", 0, ALERT_PIN_MODES_OPTIONS, ALERT_PIN_MODES_COUNT),
+    floatSetting(ALERT_CLEAR_PIN_TIME, "acpt", 1.0f, 0, 10),
+    intSetting(HA_MQTT_PORT, "ha_mqttport", 1883, 1, 65535),
+    stringSetting(HA_MQTT_USER, "ha_mqttuser", ""),
+    stringSetting(HA_MQTT_PASSWORD, "ha_mqttpass", ""),
+    stringSetting(HA_BROKER_ADDRESS, "ha_brokeraddr", ""),
+    intSetting(CURRENT_BRIGHTNESS, "cbr", 50, 0, 100),
+    intSetting(BRIGHTNESS, "brightness", 50, 0, 100),
+    intSetting(BRIGHTNESS_DAY, "brd", 50, 0, 100),
+    intSetting(BRIGHTNESS_NIGHT, "brn", 5, 0, 100),
+    optionSetting(BRIGHTNESS_MODE, "bra", 0, AUTO_BRIGHTNESS_MODES, AUTO_BRIGHTNESS_OPTIONS_COUNT),
+    boolSetting(HOME_ALERT_TIME, "hat", 0),
+    intSetting(COLOR_ALERT, "coloral", 0, 0, 360),
+    intSetting(COLOR_CLEAR, "colorcl", 120, 0, 360),
+    intSetting(COLOR_NEW_ALERT, "colorna", 30, 0, 360),
+    intSetting(COLOR_ALERT_OVER, "colorao", 100, 0, 360),
+    intSetting(COLOR_EXPLOSION, "colorex", 180, 0, 360),
+    intSetting(COLOR_MISSILES, "colormi", 275, 0, 360),
+    intSetting(COLOR_DRONES, "colordr", 330, 0, 360),
+    intSetting(COLOR_HOME_DISTRICT, "colorhd", 120, 0, 360),
+    intSetting(COLOR_BG_NEIGHBOR_ALERT, "colorbna", 30, 0, 360),
+    boolSetting(ENABLE_EXPLOSIONS, "eex", 1),
+    boolSetting(ENABLE_MISSILES, "emi", 1),
+    boolSetting(ENABLE_DRONES, "edr", 1),
+    intSetting(BRIGHTNESS_ALERT, "ba", 100, 0, 100),
+    intSetting(BRIGHTNESS_CLEAR, "bc", 100, 0, 100),
+    intSetting(BRIGHTNESS_NEW_ALERT, "bna", 100, 0, 100),
+    intSetting(BRIGHTNESS_ALERT_OVER, "bao", 100, 0, 100),
+    intSetting(BRIGHTNESS_EXPLOSION, "bex", 100, 0, 100),
+    intSetting(BRIGHTNESS_HOME_DISTRICT, "bhd", 100, 0, 100),
+    intSetting(BRIGHTNESS_BG, "bbg", 100, 0, 100),
+    intSetting(BRIGHTNESS_SERVICE, "bs", 50, 0, 100),
+    intSetting(WEATHER_MIN_TEMP, "mintemp", -10, -20, 10),
+    intSetting(WEATHER_MAX_TEMP, "maxtemp", 30, 11, 40),
+    optionSetting(ALARMS_AUTO_SWITCH, "aas", 1, AUTO_ALARM_MODES, AUTO_ALARM_MODES_COUNT),
+    optionSetting(HOME_DISTRICT, "hmd", 31, DISTRICTS, DISTRICTS_COUNT),
+    optionSetting(KYIV_DISTRICT_MODE, "kdm", 1, KYIV_LED_MODE_OPTIONS, KYIV_LED_MODE_COUNT),
+    boolSetting(SERVICE_DIODES_MODE, "sdm", 0),
+    boolSetting(NEW_FW_NOTIFICATION, "nfwn", 1),
+    intSetting(HA_LIGHT_BRIGHTNESS, "ha_lbri", 50, 0, 100),
+    intSetting(HA_LIGHT_R, "ha_lr", 215, 0, 255),
+    intSetting(HA_LIGHT_G, "ha_lg", 7, 0, 255),
+    intSetting(HA_LIGHT_B, "ha_lb", 255, 0, 255),
+    boolSetting(SOUND_ON_MIN_OF_SL, "somos", 0),
+    boolSetting(SOUND_ON_ALERT, "soa", 0),
+    intSetting(MELODY_ON_ALERT, "moa", 4, 0, MELODIES_COUNT - 1),
+    boolSetting(SOUND_ON_ALERT_END, "soae", 0),
+    intSetting(MELODY_ON_ALERT_END, "moae", 5, 0, MELODIES_COUNT - 1),
+    boolSetting(SOUND_ON_EXPLOSION, "soex", 0),
+    intSetting(MELODY_ON_EXPLOSION, "moex", 18, 0, MELODIES_COUNT - 1),
+    boolSetting(SOUND_ON_EVERY_HOUR, "soeh", 0),
+    boolSetting(SOUND_ON_BUTTON_CLICK, "sobc", 0),
+    boolSetting(MUTE_SOUND_ON_NIGHT, "mson", 0),
+    boolSetting(IGNORE_MUTE_ON_ALERT, "imoa", 0),
+    intSetting(MELODY_VOLUME, "mv", 100, 0, 100),
+    boolSetting(INVERT_DISPLAY, "invd", 0),
+    boolSetting(DIM_DISPLAY_ON_NIGHT, "ddon", 1),
+    optionSetting(MAP_MODE, "mapmode", 1, MAP_MODES, MAP_MODES_COUNT),
+    optionSetting(DISPLAY_MODE, "dm", 2, DISPLAY_MODES, DISPLAY_MODE_OPTIONS_MAX),
+    intSetting(DISPLAY_MODE_TIME, "dmt", 5, 1, 60),
+    boolSetting(TOGGLE_MODE_WEATHER, "tmw", 1),
+    boolSetting(TOGGLE_MODE_TEMP, "tmt", 1),
+    boolSetting(TOGGLE_MODE_HUM, "tmh", 1),
+    boolSetting(TOGGLE_MODE_PRESS, "tmp", 1),
+    optionSetting(BUTTON_1_MODE, "bm", 0, SINGLE_CLICK_OPTIONS, SINGLE_CLICK_OPTIONS_MAX),
+    optionSetting(BUTTON_2_MODE, "b2m", 0, SINGLE_CLICK_OPTIONS, SINGLE_CLICK_OPTIONS_MAX),
+    optionSetting(BUTTON_1_MODE_LONG, "bml", 0, LONG_CLICK_OPTIONS, LONG_CLICK_OPTIONS_MAX),
+    optionSetting(BUTTON_2_MODE_LONG, "b2ml", 0, LONG_CLICK_OPTIONS, LONG_CLICK_OPTIONS_MAX),
+    boolSetting(USE_TOUCH_BUTTON_1, "utb1", 0),
+    boolSetting(USE_TOUCH_BUTTON_2, "utb2", 0),
+    optionSetting(ALARMS_NOTIFY_MODE, "anm", 2, ALERT_NOTIFY_OPTIONS, ALERT_NOTIFY_OPTIONS_COUNT),
+    optionSetting(DISPLAY_MODEL, "dsmd", 1, DISPLAY_MODEL_OPTIONS, DISPLAY_MODEL_OPTIONS_COUNT),
+    intSetting(DISPLAY_WIDTH, "dw", 128),
+    optionSetting(DISPLAY_HEIGHT, "dh", 32, DISPLAY_HEIGHT_OPTIONS, DISPLAY_HEIGHT_OPTIONS_COUNT),
+    intSetting(DAY_START, "ds", 8, 0, 24),
+    intSetting(NIGHT_START, "ns", 22, 0, 24),
+    intSetting(WS_ALERT_TIME, "wsat", 150000),
+    intSetting(WS_REBOOT_TIME, "wsrt", 300000),
+    boolSetting(MIN_OF_SILENCE, "mos", 1),
+    intSetting(FW_UPDATE_CHANNEL, "fwuc", 0, 0, 1),
+    floatSetting(TEMP_CORRECTION, "ltc", 0.0f, -10, 10),
+    floatSetting(HUM_CORRECTION, "lhc", 0.0f, -20, 20),
+    floatSetting(PRESSURE_CORRECTION, "lpc", 0.0f, -50, 50),
+    floatSetting(LIGHT_SENSOR_FACTOR, "lsf", 0.0f, 0, 30),
+    intSetting(TIME_ZONE, "tz", 2, -12, 12),
+    intSetting(ALERT_ON_TIME, "aont", 5, 1, 10),
+    intSetting(ALERT_OFF_TIME, "aoft", 5, 1, 10),
+    intSetting(EXPLOSION_TIME, "ext", 3, 1, 10),
+    intSetting(ALERT_BLINK_TIME, "abt", 3, 1, 5),
+    stringSetting(LED_LAYOUT, "ledl", ""),
+    stringSetting(BENCHMARK_BASELINE, "bbl", ""),
+    optionSetting(FRAME_RATE, "fps", 60, FRAME_RATE_OPTIONS, FRAME_RATE_OPTIONS_COUNT),
 };
 
-std::map<Type, SettingItemFloat> floatSettings = {
-    {ALERT_CLEAR_PIN_TIME, {"acpt", 1.0f}},
-    {TEMP_CORRECTION, {"ltc", 0.0f}},
-    {HUM_CORRECTION, {"lhc", 0.0f}},
-    {PRESSURE_CORRECTION, {"lpc", 0.0f}},
-    {LIGHT_SENSOR_FACTOR, {"lsf", 0.0f}},
+static constexpr bool isSettingsOrderValid(int index = 0) {
+    return index == SETTINGS_COUNT || (SETTINGS[index].type == index && isSettingsOrderValid(index + 1));
+}
+
+static constexpr int countSettings(SettingKind kind, int index = 0) {
+    return index == SETTINGS_COUNT ? 0 : (SETTINGS[index].kind == kind ? 1 : 0) + countSettings(kind, index + 1);
+}
+
+static_assert(sizeof(SETTINGS) / sizeof(SETTINGS[0]) == SETTINGS_COUNT, "Every setting type should have a descriptor");
+static_assert(isSettingsOrderValid(), "Setting descriptors should be in the same order as Type enum");
+
+#define STRING_SETTINGS_COUNT countSettings(KIND_STRING)
+
+// fits the longest string setting, custom LED layout, with room to spare
+#define STRING_VALUE_SIZE 256
+
+// int and float values are stored in place, string values are kept in stringValues at stringSlot
+union SettingValue {
+    int intValue;
+    float floatValue;
+    uint8_t stringSlot;
 };
 
+SettingValue values[SETTINGS_COUNT];
+// getString() returns a slot without taking a lock, so slots are fixed buffers that are never reallocated:
+// a reader racing with saveString() may see a mix of old and new value, but never freed memory
+char stringValues[STRING_SETTINGS_COUNT][STRING_VALUE_SIZE];
+
 Preferences preferences;
 const char* PREFS_NAME = "storage";
+// incremented on every settings change, lets consumers detect that cached values are outdated
+uint32_t generation = 0;
+
+// saves are kept in memory and written to NVS in one session after COMMIT_QUIET_PERIOD without changes
+const unsigned long COMMIT_QUIET_PERIOD = 5000;
+uint32_t dirtySettings[(SETTINGS_COUNT + 31) / 32];
+int dirtyCount = 0;
+unsigned long lastChangeTime = 0;
+SettingsWriteStats writeStats;
+// settings are saved from web server, network and loop tasks: valuesMutex guards values, dirty bitmap
+// and stats, nvsMutex guards NVS sessions on shared preferences. nvsMutex is always taken first.
+std::mutex valuesMutex;
+std::mutex nvsMutex;
+
+static bool isDirty(Type type) {
+    return (dirtySettings[type / 32] >> (type % 32)) & 1;
+}
+
+static void clearDirty(Type type) {
+    dirtySettings[type / 32] &= ~(1UL << (type % 32));
+    dirtyCount--;
+}
+
+// returns false if value was cut to the slot size, the last byte of a slot always stays a terminator
+static bool setStringValue(uint8_t slot, const char* value) {
+    int length = snprintf(stringValues[slot], STRING_VALUE_SIZE, "%s", value);
+    return length < STRING_VALUE_SIZE;
+}
+
+static bool hasDirty(Type type) {
+    std::lock_guard<std::mutex> lock(valuesMutex);
+    return isDirty(type);
+}
+
+// should be called with valuesMutex taken
+static void markDirty(Type type) {
+    if (!isDirty(type)) {
+        dirtySettings[type / 32] |= 1UL << (type % 32);
+        dirtyCount++;
+    } else {
+        // previous pending value is overwritten before it reached flash
+        writeStats.avoided++;
+    }
+    writeStats.requested++;
+    lastChangeTime = millis();
+}
+
+static const SettingDescriptor* getDescriptor(Type type, SettingKind kind) {
+    if (type < 0 || type >= SETTINGS_COUNT || SETTINGS[type].kind != kind) {
+        LOG.printf("Wrong setting type: %d\n", type);
+        return nullptr;
+    }
+    return &SETTINGS[type];
+}
+
+// value should be in range and, for settings chosen from a select box, one of its ids
+static bool isAllowed(const SettingDescriptor* setting, int value) {
+    if (value < setting->min || value > setting->max) return false;
+    if (!setting->options) return true;
+    for (int i = 0; i < setting->optionsCount; i++) {
+        if (setting->options[i].id == value) return true;
+    }
+    return false;
+}
 
 void JaamSettings::init() {
+    std::lock_guard<std::mutex> lock(nvsMutex);
     preferences.begin(PREFS_NAME, true);
 
     // home district migration to regionID
@@ -168,112 +291,190 @@ void JaamSettings::init() {
         preferences.putInt("hmd", newRegionId);
     }
 
-    for (auto it = stringSettings.begin(); it != stringSettings.end(); ++it) {
-        SettingItemString setting = it->second;
-        setting.value = preferences.getString(setting.key, setting.value);
-        it->second = setting;
-    }
-
-    for (auto it = intSettings.begin(); it != intSettings.end(); ++it) {
-        SettingItemInt setting = it->second;
-        setting.value = preferences.getInt(setting.key, setting.value);
-        it->second = setting;
-    }
-
-    for (auto it = floatSettings.begin(); it != floatSettings.end(); ++it) {
-        SettingItemFloat setting = it->second;
-        setting.value = preferences.getFloat(setting.key, setting.value);
-        it->second = setting;
+    uint8_t stringSlot = 0;
+    for (const SettingDescriptor& setting : SETTINGS) {
+        switch (setting.kind) {
+            case KIND_INT:
+                values[setting.type].intValue = preferences.getInt(setting.key, setting.defaultInt);
+                // value stored by older firmware may be unknown to this one
+                if (!isAllowed(&setting, values[setting.type].intValue)) {
+                    LOG.printf("Stored setting %s value %d is not allowed, default is used\n", setting.key, values[setting.type].intValue);
+                    values[setting.type].intValue = setting.defaultInt;
+                }
+                break;
+            case KIND_FLOAT:
+                values[setting.type].floatValue = preferences.getFloat(setting.key, setting.defaultFloat);
+                break;
+            case KIND_STRING:
+                values[setting.type].stringSlot = stringSlot;
+                if (!setStringValue(stringSlot++, preferences.getString(setting.key, setting.defaultString).c_str())) {
+                    LOG.printf("Stored setting %s value is longer than %d characters and was cut\n", setting.key, STRING_VALUE_SIZE - 1);
+                }
+                break;
+        }
     }
 
     preferences.end();
 }
 
 const char* JaamSettings::getKey(Type type) {
-    if (intSettings.find(type) != intSettings.end()) {
-        return intSettings[type].key;
-    } else if (stringSettings.find(type) != stringSettings.end()) {
-        return stringSettings[type].key;
-    } else if (floatSettings.find(type) != floatSettings.end()) {
-        return floatSettings[type].key;
+    if (type < 0 || type >= SETTINGS_COUNT) {
+        LOG.printf("Unknown setting type: %d\n", type);
+        return "";
     }
-    LOG.println("Unknown setting type");
-    throw std::runtime_error("Unknown setting type");
+    return SETTINGS[type].key;
 }
 
 int JaamSettings::getInt(Type type) {
-    if (intSettings.find(type) != intSettings.end()) {
-        return intSettings[type].value;
-    }
-    LOG.println("Unknown setting type");
-    throw std::runtime_error("Unknown setting type");
+    if (!getDescriptor(type, KIND_INT)) return 0;
+    return values[type].intValue;
 }
 
 void JaamSettings::saveInt(Type type, int value, bool saveToPrefs) {
-    if (intSettings.find(type) != intSettings.end()) {
-        SettingItemInt setting = intSettings[type];
-        if (saveToPrefs) {
-            preferences.begin(PREFS_NAME, false);
-            preferences.putInt(setting.key, value);
-            preferences.end();
-        }
-        setting.value = value;
-        intSettings[type] = setting;
-        LOG.printf("Saved setting %s: %d (to prefs - %s)\n", setting.key, value, saveToPrefs ? "true" : "false");
+    const SettingDescriptor* setting = getDescriptor(type, KIND_INT);
+    if (!setting) return;
+    if (value < setting->min || value > setting->max) {
+        LOG.printf("Setting %s value %d is out of range [%d, %d]\n", setting->key, value, setting->min, setting->max);
+        value = min(max(value, setting->min), setting->max);
+    }
+    if (!isAllowed(setting, value)) {
+        LOG.printf("Setting %s value %d is not one of the options\n", setting->key, value);
         return;
     }
-    LOG.println("Unknown setting type");
-    throw std::runtime_error("Unknown setting type");
+    // value that is not persisted should not leak into flash with the next commit
+    if (!saveToPrefs && hasDirty(type)) commit();
+    {
+        std::lock_guard<std::mutex> lock(valuesMutex);
+        values[type].intValue = value;
+        if (saveToPrefs) markDirty(type);
+        generation++;
+    }
+    LOG.printf("Saved setting %s: %d (to prefs - %s)\n", setting->key, value, saveToPrefs ? "true" : "false");
+}
+
+bool JaamSettings::isValidInt(Type type, int value) {
+    const SettingDescriptor* setting = getDescriptor(type, KIND_INT);
+    return setting && isAllowed(setting, value);
+}
+
+bool JaamSettings::isValidFloat(Type type, float value) {
+    const SettingDescriptor* setting = getDescriptor(type, KIND_FLOAT);
+    return setting && value >= setting->min && value <= setting->max;
 }
 
 const char* JaamSettings::getString(Type type) {
-    if (stringSettings.find(type) != stringSettings.end()) {
-        return stringSettings[type].value.c_str();
-    }
-    LOG.println("Unknown setting type");
-    throw std::runtime_error("Unknown setting type");
+    if (!getDescriptor(type, KIND_STRING)) return "";
+    return stringValues[values[type].stringSlot];
 }
 
 void JaamSettings::saveString(Type type, const char* value, bool saveToPrefs) {
-    if (stringSettings.find(type) != stringSettings.end()) {
-        SettingItemString setting = stringSettings[type];
-        if (saveToPrefs) {
-            preferences.begin(PREFS_NAME, false);
-            preferences.putString(setting.key, value);
-            preferences.end();
-        }
-        setting.value = value;
-        stringSettings[type] = setting;
-        LOG.printf("Saved setting %s: '%s' (to prefs - %s)\n", setting.key, value, saveToPrefs ? "true" : "false");
+    const SettingDescriptor* setting = getDescriptor(type, KIND_STRING);
+    if (!setting) return;
+    if (strlen(value) >= STRING_VALUE_SIZE) {
+        LOG.printf("Setting %s value is longer than %d characters\n", setting->key, STRING_VALUE_SIZE - 1);
         return;
     }
-    LOG.println("Unknown setting type");
-    throw std::runtime_error("Unknown setting type");
+    // value that is not persisted should not leak into flash with the next commit
+    if (!saveToPrefs && hasDirty(type)) commit();
+    {
+        std::lock_guard<std::mutex> lock(valuesMutex);
+        setStringValue(values[type].stringSlot, value);
+        if (saveToPrefs) markDirty(type);
+        generation++;
+    }
+    LOG.printf("Saved setting %s: '%s' (to prefs - %s)\n", setting->key, value, saveToPrefs ? "true" : "false");
 }
 
 float JaamSettings::getFloat(Type type) {
-    if (floatSettings.find(type) != floatSettings.end()) {
-        return floatSettings[type].value;
-    }
-    LOG.println("Unknown setting type");
-    throw std::runtime_error("Unknown setting type");
+    if (!getDescriptor(type, KIND_FLOAT)) return 0.0f;
+    return values[type].floatValue;
 }
 
 void JaamSettings::saveFloat(Type type, float value, bool saveToPrefs) {
-    if (floatSettings.find(type) != floatSettings.end()) {
-        SettingItemFloat setting = floatSettings[type];
-        if (saveToPrefs) {
-            preferences.begin(PREFS_NAME, false);
-            preferences.putFloat(setting.key, value);
-            preferences.end();
+    const SettingDescriptor* setting = getDescriptor(type, KIND_FLOAT);
+    if (!setting) return;
+    // value that is not persisted should not leak into flash with the next commit
+    if (!saveToPrefs && hasDirty(type)) commit();
+    {
+        std::lock_guard<std::mutex> lock(valuesMutex);
+        values[type].floatValue = value;
+        if (saveToPrefs) markDirty(type);
+        generation++;
+    }
+    LOG.printf("Saved setting %s: %.1f (to prefs - %s)\n", setting->key, value, saveToPrefs ? "true" : "false");
+}
+
+// writes all pending settings in a single NVS session, values equal to the stored ones are skipped
+void JaamSettings::commit() {
+    std::lock_guard<std::mutex> nvsLock(nvsMutex);
+    if (!hasPendingChanges()) return;
+    preferences.begin(PREFS_NAME, false);
+    for (const SettingDescriptor& setting : SETTINGS) {
+        const char* key = setting.key;
+        SettingValue value;
+        char stringValue[STRING_VALUE_SIZE];
+        {
+            // bit is cleared before the value is written, so a save made meanwhile stays pending
+            std::lock_guard<std::mutex> lock(valuesMutex);
+            if (!isDirty(setting.type)) continue;
+            clearDirty(setting.type);
+            value = values[setting.type];
+            if (setting.kind == KIND_STRING) memcpy(stringValue, stringValues[value.stringSlot], STRING_VALUE_SIZE);
+        }
+        bool stored = preferences.isKey(key);
+        bool changed = true;
+        switch (setting.kind) {
+            case KIND_INT:
+                changed = !stored || preferences.getInt(key) != value.intValue;
+                if (changed) preferences.putInt(key, value.intValue);
+                break;
+            case KIND_FLOAT:
+                changed = !stored || preferences.getFloat(key) != value.floatValue;
+                if (changed) preferences.putFloat(key, value.floatValue);
+                break;
+            case KIND_STRING:
+                changed = !stored || preferences.getString(key) != stringValue;
+                if (changed) preferences.putString(key, stringValue);
+                break;
+        }
+        std::lock_guard<std::mutex> lock(valuesMutex);
+        if (changed) {
+            writeStats.committed++;
+        } else {
+            writeStats.avoided++;
         }
-        setting.value = value;
-        floatSettings[type] = setting;
-        LOG.printf("Saved setting %s: %.1f (to prefs - %s)\n", setting.key, value, saveToPrefs ? "true" : "false");
-        return;
     }
-    LOG.println("Unknown setting type");
-    throw std::runtime_error("Unknown setting type");
+    preferences.end();
+    SettingsWriteStats stats;
+    {
+        std::lock_guard<std::mutex> lock(valuesMutex);
+        writeStats.commits++;
+        stats = writeStats;
+    }
+    LOG.printf("Settings committed (written: %u, avoided: %u)\n", (unsigned int) stats.committed, (unsigned int) stats.avoided);
+}
+
+void JaamSettings::commitIfIdle() {
+    bool idle;
+    {
+        std::lock_guard<std::mutex> lock(valuesMutex);
+        idle = dirtyCount > 0 && millis() - lastChangeTime >= COMMIT_QUIET_PERIOD;
+    }
+    if (idle) commit();
+}
+
+bool JaamSettings::hasPendingChanges() {
+    std::lock_guard<std::mutex> lock(valuesMutex);
+    return dirtyCount > 0;
+}
+
+SettingsWriteStats JaamSettings::getWriteStats() {
+    std::lock_guard<std::mutex> lock(valuesMutex);
+    return writeStats;
+}
+
+uint32_t JaamSettings::getGeneration() {
+    return generation;
 }
 
 bool JaamSettings::getBool(Type type) {
@@ -284,83 +485,161 @@ void JaamSettings::saveBool(Type type, bool value, bool saveToPrefs) {
     saveInt(type, value ? 1 : 0, saveToPrefs);
 }
 
-void JaamSettings::getSettingsBackup(Print* stream, const char* fwVersion, const char* chipID, const char* time) {
+static void printJsonString(Print* stream, const char* value) {
     JsonDocument doc;
-    doc["fw_version"] = fwVersion;
-    doc["chip_id"] = chipID;
-    doc["time"] = time;
-    JsonArray settingsArray = doc["settings"].to<JsonArray>();
-    preferences.begin("storage", true);
-
-    for (auto it = stringSettings.begin(); it != stringSettings.end(); ++it) {
-        SettingItemString setting = it->second;
-        const char* key = setting.key;
-        if (preferences.isKey(key)) {
-            JsonObject settingObj = settingsArray.add<JsonObject>();
-            settingObj["key"] = key;
-            settingObj["value"] = preferences.getString(key);
-            settingObj["type"] = PF_STRING;
-        }
-    }
+    doc.set(value);
+    serializeJson(doc, *stream);
+}
 
-    for (auto it = intSettings.begin(); it != intSettings.end(); ++it) {
-        SettingItemInt setting = it->second;
-        const char* key = setting.key;
-        if (preferences.isKey(key)) {
-            JsonObject settingObj = settingsArray.add<JsonObject>();
-            settingObj["key"] = key;
-            settingObj["value"] = preferences.getInt(key);
-            settingObj["type"] = PF_INT;
-        }
+bool JaamSettings::getSettingsBackupPart(Print* stream, SettingsBackupCursor& cursor, const char* fwVersion, const char* chipID, const char* time) {
+    if (cursor.part > SETTINGS_COUNT + 1) return false;
+    int part = cursor.part++;
+    if (part == 0) {
+        // backup is read from NVS, so pending changes should be there
+        commit();
+        stream->print("{\"fw_version\":");
+        printJsonString(stream, fwVersion);
+        stream->print(",\"chip_id\":");
+        printJsonString(stream, chipID);
+        stream->print(",\"time\":");
+        printJsonString(stream, time);
+        stream->print(",\"settings\":[");
+        return true;
     }
-
-    for (auto it = floatSettings.begin(); it != floatSettings.end(); ++it) {
-        SettingItemFloat setting = it->second;
-        const char* key = setting.key;
-        if (preferences.isKey(key)) {
-            JsonObject settingObj = settingsArray.add<JsonObject>();
-            settingObj["key"] = key;
-            settingObj["value"] = preferences.getFloat(key);
-            settingObj["type"] = PF_FLOAT;
+    if (part == SETTINGS_COUNT + 1) {
+        stream->print("]}");
+        return true;
+    }
+    const SettingDescriptor& setting = SETTINGS[part - 1];
+    const char* key = setting.key;
+    // NVS is opened for every part, so a download that was not finished does not leave it open
+    std::lock_guard<std::mutex> nvsLock(nvsMutex);
+    preferences.begin(PREFS_NAME, true);
+    if (preferences.isKey(key)) {
+        JsonDocument settingObj;
+        settingObj["key"] = key;
+        switch (setting.kind) {
+            case KIND_STRING:
+                settingObj["value"] = preferences.getString(key);
+                settingObj["type"] = PF_STRING;
+                break;
+            case KIND_INT:
+                settingObj["value"] = preferences.getInt(key);
+                settingObj["type"] = PF_INT;
+                break;
+            case KIND_FLOAT:
+                settingObj["value"] = preferences.getFloat(key);
+                settingObj["type"] = PF_FLOAT;
+                break;
         }
+        if (cursor.hasSettings) stream->print(",");
+        serializeJson(settingObj, *stream);
+        cursor.hasSettings = true;
     }
-
     preferences.end();
+    return true;
+}
+
+struct SettingsRestore {
+    SettingValue values[SETTINGS_COUNT];
+    String stringValues[STRING_SETTINGS_COUNT]; // at the same slots as current string values
+    uint32_t restored[(SETTINGS_COUNT + 31) / 32] = {};
+    int count = 0;
+    bool valid = true;
+};
+
+static const SettingDescriptor* findDescriptor(const char* key) {
+    for (const SettingDescriptor& setting : SETTINGS) {
+        if (strcmp(setting.key, key) == 0) return &setting;
+    }
+    return nullptr;
+}
 
-    stream->print(doc.as<String>());
+SettingsRestore* JaamSettings::beginSettingsRestore() {
+    return new SettingsRestore();
 }
 
-bool JaamSettings::restoreSettingsBackup(const char* settings) {
+bool JaamSettings::addRestoredSetting(SettingsRestore* restore, const char* entry) {
     JsonDocument doc;
-    deserializeJson(doc, settings);
-    JsonArray settingsArray = doc["settings"].as<JsonArray>();
-    preferences.begin("storage", false);
-    bool restored = false;
-
-    for (JsonObject settingObj : settingsArray) {
-        const char* key = settingObj["key"];
-        const char* type = settingObj["type"];
-
-        // skip id key, we do not need to restore it
-        if (strcmp(key, "id") == 0) continue;
-
-        if (strcmp(type, PF_STRING) == 0) {
-            String valueString = settingObj["value"].as<String>();
-            preferences.putString(key, valueString);
-            LOG.printf("Restored setting: '%s' with value '%s'\n", key, valueString.c_str());
-        } else if (strcmp(type, PF_INT) == 0) {
-            int valueInt = settingObj["value"].as<int>();
-            preferences.putInt(key, valueInt);
-            LOG.printf("Restored setting: '%s' with value '%d'\n", key, valueInt);
-        } else if (strcmp(type, PF_FLOAT) == 0) {
-            float valueFloat = settingObj["value"].as<float>();
-            preferences.putFloat(key, valueFloat);
-            LOG.printf("Restored setting: '%s' with value '%.1f'\n", key, valueFloat);
-        }
-        restored = true;
+    DeserializationError error = deserializeJson(doc, entry);
+    const char* key = doc["key"];
+    const char* type = doc["type"];
+    JsonVariant value = doc["value"];
+    if (error || !key || !type || value.isNull()) {
+        LOG.printf("Malformed backup entry: %s\n", entry);
+        restore->valid = false;
+        return false;
     }
+    const SettingDescriptor* setting = findDescriptor(key);
+    // skip keys of other firmware versions and keys we do not need to restore (e.g. id)
+    if (!setting || (setting->flags & SETTING_NOT_RESTORED)) {
+        LOG.printf("Skipped setting: '%s'\n", key);
+        return true;
+    }
+    bool valid = false;
+    switch (setting->kind) {
+        case KIND_STRING:
+            valid = strcmp(type, PF_STRING) == 0 && value.is<const char*>() && strlen(value.as<const char*>()) < STRING_VALUE_SIZE;
+            if (valid) restore->stringValues[values[setting->type].stringSlot] = value.as<const char*>();
+            break;
+        case KIND_INT:
+            valid = strcmp(type, PF_INT) == 0 && value.is<int>() && isAllowed(setting, value.as<int>());
+            if (valid) restore->values[setting->type].intValue = value.as<int>();
+            break;
+        case KIND_FLOAT:
+            valid = strcmp(type, PF_FLOAT) == 0 && value.is<float>() && value.as<float>() >= setting->min && value.as<float>() <= setting->max;
+            if (valid) restore->values[setting->type].floatValue = value.as<float>();
+            break;
+    }
+    if (!valid) {
+        LOG.printf("Invalid backup entry: %s\n", entry);
+        restore->valid = false;
+        return false;
+    }
+    uint32_t& restored = restore->restored[setting->type / 32];
+    if (!((restored >> (setting->type % 32)) & 1)) restore->count++;
+    restored |= 1UL << (setting->type % 32);
+    return true;
+}
 
-    preferences.end();
-
+bool JaamSettings::finishSettingsRestore(SettingsRestore* restore) {
+    bool restored = restore->valid && restore->count > 0;
+    if (restored) {
+        std::lock_guard<std::mutex> nvsLock(nvsMutex);
+        {
+            // restored values should not be overwritten by pending changes before reboot
+            std::lock_guard<std::mutex> lock(valuesMutex);
+            memset(dirtySettings, 0, sizeof(dirtySettings));
+            dirtyCount = 0;
+        }
+        preferences.begin(PREFS_NAME, false);
+        for (const SettingDescriptor& setting : SETTINGS) {
+            if (!((restore->restored[setting.type / 32] >> (setting.type % 32)) & 1)) continue;
+            const char* key = setting.key;
+            const SettingValue& value = restore->values[setting.type];
+            switch (setting.kind) {
+                case KIND_STRING: {
+                    const String& valueString = restore->stringValues[values[setting.type].stringSlot];
+                    preferences.putString(key, valueString);
+                    LOG.printf("Restored setting: '%s' with value '%s'\n", key, valueString.c_str());
+                    break;
+                }
+                case KIND_INT:
+                    preferences.putInt(key, value.intValue);
+                    LOG.printf("Restored setting: '%s' with value '%d'\n", key, value.intValue);
+                    break;
+                case KIND_FLOAT:
+                    preferences.putFloat(key, value.floatValue);
+                    LOG.printf("Restored setting: '%s' with value '%.1f'\n", key, value.floatValue);
+                    break;
+            }
+        }
+        preferences.end();
+    }
+    delete restore;
     return restored;
 }
+
+void JaamSettings::cancelSettingsRestore(SettingsRestore* restore) {
+    delete restore;
+}
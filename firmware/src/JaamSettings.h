@@ -114,8 +114,27 @@ enum Type {
     ALERT_OFF_TIME,
     EXPLOSION_TIME,
     ALERT_BLINK_TIME,
+    LED_LAYOUT,
+    BENCHMARK_BASELINE,
+    FRAME_RATE,
+    SETTINGS_COUNT, // keep last
 };
 
+struct SettingsWriteStats {
+    uint32_t requested; // saves that asked to persist value
+    uint32_t committed; // values actually written to NVS
+    uint32_t avoided; // writes coalesced or skipped because value was not changed
+    uint32_t commits; // NVS sessions
+};
+
+struct SettingsBackupCursor {
+    int part = 0;
+    bool hasSettings = false; // separator is needed before the next setting
+};
+
+// settings collected from a backup being restored
+struct SettingsRestore;
+
 class JaamSettings {
 
 public:
@@ -124,12 +143,31 @@ public:
     const char* getKey(Type type);
     int getInt(Type type);
     void saveInt(Type type, int value, bool saveToPrefs = true);
+    // checks value against the setting range and its select box options
+    bool isValidInt(Type type, int value);
+    // pointer stays valid for the lifetime of the firmware, the value under it changes on save
     const char* getString(Type type);
+    // values longer than 255 characters are rejected
     void saveString(Type type, const char* value, bool saveToPrefs = true);
     float getFloat(Type type);
     void saveFloat(Type type, float value, bool saveToPrefs = true);
+    bool isValidFloat(Type type, float value);
     bool getBool(Type type);
     void saveBool(Type type, bool value, bool saveToPrefs = true);
-    void getSettingsBackup(Print* stream, const char* fwVersion, const char* chipID, const char* time);
-    bool restoreSettingsBackup(const char* settings);
+    void commit();
+    void commitIfIdle();
+    bool hasPendingChanges();
+    SettingsWriteStats getWriteStats();
+    uint32_t getGeneration();
+    // Backup is written part by part, so it can be streamed without keeping it in memory: the first part
+    // opens the document, the next ones add stored settings and the last one closes the document.
+    // Returns false if backup is already finished.
+    bool getSettingsBackupPart(Print* stream, SettingsBackupCursor& cursor, const char* fwVersion, const char* chipID, const char* time);
+    // Restore collects backup entries as they are read and writes them together only if all of them are valid
+    SettingsRestore* beginSettingsRestore();
+    // adds backup entry in JSON, returns false if it does not match the setting descriptor
+    bool addRestoredSetting(SettingsRestore* restore, const char* entry);
+    // writes collected settings in a single NVS session and releases restore, returns false if nothing was written
+    bool finishSettingsRestore(SettingsRestore* restore);
+    void cancelSettingsRestore(SettingsRestore* restore);
 };
\ No newline at end of file
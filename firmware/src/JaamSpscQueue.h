@@ -0,0 +1,32 @@
+#include <atomic>
+#include <stdint.h>
+
+// Lock-free bounded queue for exactly one producer task and one consumer task.
+// Items are copied in and out, so no memory is allocated after construction.
+template <typename T, uint32_t N>
+class JaamSpscQueue {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "Queue size should be a power of two");
+
+public:
+    // called by producer only, returns false if queue is full
+    bool push(const T& item) {
+        uint32_t currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail - head.load(std::memory_order_acquire) == N) return false;
+        items[currentTail % N] = item;
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+    // called by consumer only, returns false if queue is empty
+    bool pop(T& item) {
+        uint32_t currentHead = head.load(std::memory_order_relaxed);
+        if (tail.load(std::memory_order_acquire) == currentHead) return false;
+        item = items[currentHead % N];
+        head.store(currentHead + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T items[N];
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+};
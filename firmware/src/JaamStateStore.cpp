@@ -0,0 +1,102 @@
+#include "JaamStateStore.h"
+#include <Preferences.h>
+#include <esp_attr.h>
+#include <string.h>
+
+#define STATE_STORE_MAGIC 0x4A535453 // "STSJ"
+#define STATE_STORE_KEY "state"
+
+struct StoredState {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size;
+  uint32_t checksum;
+  uint8_t data[STATE_STORE_MAX_SIZE];
+};
+
+#define STORED_STATE_HEADER_SIZE offsetof(StoredState, data)
+
+// RTC memory is not initialized on boot, so state saved before software reset is still there.
+// It is also used as a buffer for flash reads and writes.
+RTC_NOINIT_ATTR static StoredState rtcState;
+
+static const char* SOURCE_NAMES[] = {
+  "none",
+  "rtc",
+  "flash",
+};
+
+// FNV-1a
+static uint32_t getChecksum(const uint8_t* data, size_t size) {
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ data[i]) * 16777619UL;
+  }
+  return hash;
+}
+
+static bool isValid(uint16_t version, size_t size) {
+  return rtcState.magic == STATE_STORE_MAGIC && rtcState.version == version && rtcState.size == size
+    && size <= STATE_STORE_MAX_SIZE && rtcState.checksum == getChecksum(rtcState.data, size);
+}
+
+JaamStateStore::JaamStateStore(const char* name, uint16_t version, uint32_t flashInterval) {
+  this->name = name;
+  this->version = version;
+  this->flashInterval = flashInterval;
+  flashChecksum = 0;
+  lastFlashWrite = 0;
+  flashWrites = 0;
+}
+
+JaamStateStore::Source JaamStateStore::restore(void* data, size_t size) {
+  if (isValid(version, size)) {
+    memcpy(data, rtcState.data, size);
+    return RTC;
+  }
+  Preferences preferences;
+  size_t length = 0;
+  if (preferences.begin(name, true)) {
+    length = preferences.getBytes(STATE_STORE_KEY, &rtcState, sizeof(StoredState));
+    preferences.end();
+  }
+  if (length == STORED_STATE_HEADER_SIZE + size && isValid(version, size)) {
+    memcpy(data, rtcState.data, size);
+    flashChecksum = rtcState.checksum;
+    return FLASH;
+  }
+  rtcState.magic = 0;
+  return NONE;
+}
+
+bool JaamStateStore::save(const void* data, size_t size) {
+  if (size > STATE_STORE_MAX_SIZE) return false;
+  // reset in the middle of the write leaves wrong checksum, flash copy is restored then
+  memcpy(rtcState.data, data, size);
+  rtcState.magic = STATE_STORE_MAGIC;
+  rtcState.version = version;
+  rtcState.size = size;
+  rtcState.checksum = getChecksum(rtcState.data, size);
+  return true;
+}
+
+void JaamStateStore::commitIfDue(unsigned long now) {
+  // interval is counted from boot too, so boot loop does not write flash on every boot
+  if (now - lastFlashWrite < flashInterval) return;
+  if (rtcState.magic != STATE_STORE_MAGIC || rtcState.checksum == flashChecksum) return;
+  Preferences preferences;
+  if (!preferences.begin(name, false)) return;
+  preferences.putBytes(STATE_STORE_KEY, &rtcState, STORED_STATE_HEADER_SIZE + rtcState.size);
+  preferences.end();
+  flashChecksum = rtcState.checksum;
+  lastFlashWrite = now;
+  flashWrites++;
+}
+
+uint32_t JaamStateStore::getFlashWrites() {
+  return flashWrites;
+}
+
+const char* JaamStateStore::getSourceName(Source source) {
+  return SOURCE_NAMES[source];
+}
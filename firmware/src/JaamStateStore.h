@@ -0,0 +1,37 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#define STATE_STORE_MAX_SIZE 1024
+
+// Keeps the last copy of a state blob across reboots. Every saved state goes to RTC memory, which
+// survives software resets (reboot, OTA, watchdog, panic) but not power loss. Flash copy in NVS is
+// written not more often than flashInterval to limit flash wear, so after power loss state may be
+// up to flashInterval old. Both copies are checked by magic, version, size and checksum, so a
+// state left by firmware with another layout or RTC garbage after power-on is never restored.
+class JaamStateStore {
+
+public:
+    enum Source {
+        NONE,
+        RTC,
+        FLASH
+    };
+    // version should be changed when layout of the state is changed
+    JaamStateStore(const char* name, uint16_t version, uint32_t flashInterval);
+    // copies stored state into data, RTC copy is preferred as it is never older than flash one
+    Source restore(void* data, size_t size);
+    // stores state in RTC memory, returns false if it is too big
+    bool save(const void* data, size_t size);
+    // writes last saved state to flash if it was changed and flashInterval passed since last write
+    void commitIfDue(unsigned long now);
+    uint32_t getFlashWrites();
+    static const char* getSourceName(Source source);
+
+private:
+    const char* name;
+    uint16_t version;
+    uint32_t flashInterval;
+    uint32_t flashChecksum;
+    unsigned long lastFlashWrite;
+    uint32_t flashWrites;
+};
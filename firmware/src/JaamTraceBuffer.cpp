@@ -0,0 +1,136 @@
+#include "JaamTraceBuffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_RECORD_HEADER_SIZE 6
+static const uint8_t TRACE_SIGNATURE[] = {'J', 'T', 'R', '1'};
+#define TRACE_SIGNATURE_SIZE sizeof(TRACE_SIGNATURE)
+
+static uint32_t readUint32(const uint8_t* data) {
+  return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+static uint16_t readUint16(const uint8_t* data) {
+  return data[0] | (data[1] << 8);
+}
+
+JaamTraceBuffer::JaamTraceBuffer(size_t capacity) {
+  this->capacity = capacity;
+  storage = NULL;
+  used = 0;
+  count = 0;
+  droppedFrames = 0;
+}
+
+bool JaamTraceBuffer::allocate() {
+  if (!storage) storage = (uint8_t*) malloc(capacity);
+  return storage != NULL;
+}
+
+void JaamTraceBuffer::clear() {
+  used = 0;
+  count = 0;
+  droppedFrames = 0;
+}
+
+bool JaamTraceBuffer::add(uint32_t time, const uint8_t* data, size_t length) {
+  size_t recordSize = TRACE_RECORD_HEADER_SIZE + length;
+  if (!storage || length > UINT16_MAX || recordSize > capacity) {
+    droppedFrames++;
+    return false;
+  }
+  if (used + recordSize > capacity) dropOldest(used + recordSize - capacity);
+  uint8_t* record = storage + used;
+  for (int i = 0; i < 4; i++) record[i] = (time >> (i * 8)) & 0xFF;
+  record[4] = length & 0xFF;
+  record[5] = length >> 8;
+  memcpy(record + TRACE_RECORD_HEADER_SIZE, data, length);
+  used += recordSize;
+  count++;
+  return true;
+}
+
+// frees at least a quarter of the buffer, so frames are not moved on every add
+void JaamTraceBuffer::dropOldest(size_t needed) {
+  if (needed < capacity / 4) needed = capacity / 4;
+  size_t offset = 0;
+  while (offset < needed && offset < used) {
+    offset += TRACE_RECORD_HEADER_SIZE + readUint16(storage + offset + 4);
+    count--;
+    droppedFrames++;
+  }
+  memmove(storage, storage + offset, used - offset);
+  used -= offset;
+}
+
+bool JaamTraceBuffer::next(size_t* offset, uint32_t* time, const uint8_t** data, size_t* length) {
+  if (!storage || *offset + TRACE_RECORD_HEADER_SIZE > used) return false;
+  const uint8_t* record = storage + *offset;
+  *time = readUint32(record);
+  *length = readUint16(record + 4);
+  *data = record + TRACE_RECORD_HEADER_SIZE;
+  *offset += TRACE_RECORD_HEADER_SIZE + *length;
+  return true;
+}
+
+size_t JaamTraceBuffer::getFileSize() {
+  return TRACE_SIGNATURE_SIZE + used;
+}
+
+size_t JaamTraceBuffer::readFile(size_t index, uint8_t* buffer, size_t maxLength) {
+  size_t copied = 0;
+  while (copied < maxLength && index < TRACE_SIGNATURE_SIZE) {
+    buffer[copied++] = TRACE_SIGNATURE[index++];
+  }
+  if (index >= getFileSize() || copied == maxLength) return copied;
+  size_t length = getFileSize() - index;
+  if (length > maxLength - copied) length = maxLength - copied;
+  memcpy(buffer + copied, storage + index - TRACE_SIGNATURE_SIZE, length);
+  return copied + length;
+}
+
+bool JaamTraceBuffer::writeFile(size_t index, const uint8_t* data, size_t length) {
+  if (!storage) return false;
+  if (index == 0) clear();
+  // signature may be split between parts
+  while (length > 0 && index < TRACE_SIGNATURE_SIZE) {
+    if (*data != TRACE_SIGNATURE[index]) return false;
+    data++;
+    index++;
+    length--;
+  }
+  if (length == 0) return true;
+  if (index - TRACE_SIGNATURE_SIZE + length > capacity) return false;
+  memcpy(storage + index - TRACE_SIGNATURE_SIZE, data, length);
+  used = index - TRACE_SIGNATURE_SIZE + length;
+  return true;
+}
+
+int JaamTraceBuffer::finishFile() {
+  size_t offset = 0;
+  count = 0;
+  while (offset + TRACE_RECORD_HEADER_SIZE <= used) {
+    size_t recordSize = TRACE_RECORD_HEADER_SIZE + readUint16(storage + offset + 4);
+    if (offset + recordSize > used) break;
+    offset += recordSize;
+    count++;
+  }
+  used = offset;
+  return count;
+}
+
+int JaamTraceBuffer::getCount() {
+  return count;
+}
+
+uint32_t JaamTraceBuffer::getDroppedFrames() {
+  return droppedFrames;
+}
+
+size_t JaamTraceBuffer::getUsed() {
+  return used;
+}
+
+size_t JaamTraceBuffer::getCapacity() {
+  return capacity;
+}
@@ -0,0 +1,40 @@
+#include <stddef.h>
+#include <stdint.h>
+
+// Log of received websocket frames with their receive time, used to capture data stream and
+// replay it later. Frames are kept in one contiguous block of [u32 time, ms][u16 length][data]
+// records, so trace file is just a signature followed by this block. When the buffer is full,
+// at least a quarter of it is dropped from the oldest side.
+// Memory is allocated on first use and kept, so reading while buffer is changed by another
+// task gives wrong data but never touches freed memory. Not thread safe otherwise.
+class JaamTraceBuffer {
+
+public:
+    JaamTraceBuffer(size_t capacity);
+    // returns false if there is not enough memory
+    bool allocate();
+    void clear();
+    // frames longer than capacity are skipped, returns false if frame was not stored
+    bool add(uint32_t time, const uint8_t* data, size_t length);
+    // reads frame at offset and moves offset to the next frame, returns false at the end
+    bool next(size_t* offset, uint32_t* time, const uint8_t** data, size_t* length);
+    size_t getFileSize();
+    // copies up to maxLength bytes of trace file starting from index, returns number of copied bytes
+    size_t readFile(size_t index, uint8_t* buffer, size_t maxLength);
+    // file is written in parts as they arrive, returns false if it is not a trace or does not fit
+    bool writeFile(size_t index, const uint8_t* data, size_t length);
+    // checks frames of written file, incomplete last frame is cut, returns number of frames
+    int finishFile();
+    int getCount();
+    uint32_t getDroppedFrames();
+    size_t getUsed();
+    size_t getCapacity();
+
+private:
+    uint8_t* storage;
+    size_t capacity;
+    size_t used;
+    int count;
+    uint32_t droppedFrames;
+    void dropOldest(size_t needed);
+};
@@ -124,33 +124,111 @@ struct RGBColor {
   uint8_t b;
 };
 
+// hue (0 - 359) to RGB with full saturation and value, precomputed from float HSV conversion
+static const RGBColor HUE_TO_RGB[360] PROGMEM = {
+  {255, 0, 0}, {255, 4, 0}, {255, 9, 0}, {255, 13, 0}, {255, 17, 0}, {255, 21, 0},
+  {255, 26, 0}, {255, 30, 0}, {255, 34, 0}, {255, 38, 0}, {255, 43, 0}, {255, 47, 0},
+  {255, 51, 0}, {255, 55, 0}, {255, 60, 0}, {255, 64, 0}, {255, 68, 0}, {255, 72, 0},
+  {255, 77, 0}, {255, 81, 0}, {255, 85, 0}, {255, 89, 0}, {255, 94, 0}, {255, 98, 0},
+  {255, 102, 0}, {255, 106, 0}, {255, 111, 0}, {255, 115, 0}, {255, 119, 0}, {255, 123, 0},
+  {255, 128, 0}, {255, 132, 0}, {255, 136, 0}, {255, 140, 0}, {255, 145, 0}, {255, 149, 0},
+  {255, 153, 0}, {255, 157, 0}, {255, 162, 0}, {255, 166, 0}, {255, 170, 0}, {255, 174, 0},
+  {255, 179, 0}, {255, 183, 0}, {255, 187, 0}, {255, 191, 0}, {255, 196, 0}, {255, 200, 0},
+  {255, 204, 0}, {255, 208, 0}, {255, 213, 0}, {255, 217, 0}, {255, 221, 0}, {255, 225, 0},
+  {255, 230, 0}, {255, 234, 0}, {255, 238, 0}, {255, 242, 0}, {255, 247, 0}, {255, 251, 0},
+  {255, 255, 0}, {251, 255, 0}, {247, 255, 0}, {242, 255, 0}, {238, 255, 0}, {234, 255, 0},
+  {230, 255, 0}, {225, 255, 0}, {221, 255, 0}, {217, 255, 0}, {212, 255, 0}, {208, 255, 0},
+  {204, 255, 0}, {200, 255, 0}, {196, 255, 0}, {191, 255, 0}, {187, 255, 0}, {183, 255, 0},
+  {179, 255, 0}, {174, 255, 0}, {170, 255, 0}, {166, 255, 0}, {162, 255, 0}, {157, 255, 0},
+  {153, 255, 0}, {149, 255, 0}, {144, 255, 0}, {140, 255, 0}, {136, 255, 0}, {132, 255, 0},
+  {128, 255, 0}, {123, 255, 0}, {119, 255, 0}, {115, 255, 0}, {111, 255, 0}, {106, 255, 0},
+  {102, 255, 0}, {98, 255, 0}, {94, 255, 0}, {89, 255, 0}, {85, 255, 0}, {81, 255, 0},
+  {76, 255, 0}, {72, 255, 0}, {68, 255, 0}, {64, 255, 0}, {60, 255, 0}, {55, 255, 0},
+  {51, 255, 0}, {47, 255, 0}, {43, 255, 0}, {38, 255, 0}, {34, 255, 0}, {30, 255, 0},
+  {26, 255, 0}, {21, 255, 0}, {17, 255, 0}, {13, 255, 0}, {8, 255, 0}, {4, 255, 0},
+  {0, 255, 0}, {0, 255, 4}, {0, 255, 8}, {0, 255, 13}, {0, 255, 17}, {0, 255, 21},
+  {0, 255, 25}, {0, 255, 30}, {0, 255, 34}, {0, 255, 38}, {0, 255, 42}, {0, 255, 47},
+  {0, 255, 51}, {0, 255, 55}, {0, 255, 60}, {0, 255, 64}, {0, 255, 68}, {0, 255, 72},
+  {0, 255, 76}, {0, 255, 81}, {0, 255, 85}, {0, 255, 89}, {0, 255, 93}, {0, 255, 98},
+  {0, 255, 102}, {0, 255, 106}, {0, 255, 111}, {0, 255, 115}, {0, 255, 119}, {0, 255, 123},
+  {0, 255, 128}, {0, 255, 132}, {0, 255, 136}, {0, 255, 140}, {0, 255, 144}, {0, 255, 149},
+  {0, 255, 153}, {0, 255, 157}, {0, 255, 161}, {0, 255, 166}, {0, 255, 170}, {0, 255, 174},
+  {0, 255, 178}, {0, 255, 183}, {0, 255, 187}, {0, 255, 191}, {0, 255, 196}, {0, 255, 200},
+  {0, 255, 204}, {0, 255, 208}, {0, 255, 212}, {0, 255, 217}, {0, 255, 221}, {0, 255, 225},
+  {0, 255, 229}, {0, 255, 234}, {0, 255, 238}, {0, 255, 242}, {0, 255, 247}, {0, 255, 251},
+  {0, 255, 255}, {0, 251, 255}, {0, 247, 255}, {0, 242, 255}, {0, 238, 255}, {0, 234, 255},
+  {0, 230, 255}, {0, 225, 255}, {0, 221, 255}, {0, 217, 255}, {0, 212, 255}, {0, 208, 255},
+  {0, 204, 255}, {0, 200, 255}, {0, 196, 255}, {0, 191, 255}, {0, 187, 255}, {0, 183, 255},
+  {0, 178, 255}, {0, 174, 255}, {0, 170, 255}, {0, 166, 255}, {0, 162, 255}, {0, 157, 255},
+  {0, 153, 255}, {0, 149, 255}, {0, 144, 255}, {0, 140, 255}, {0, 136, 255}, {0, 132, 255},
+  {0, 128, 255}, {0, 123, 255}, {0, 119, 255}, {0, 115, 255}, {0, 111, 255}, {0, 106, 255},
+  {0, 102, 255}, {0, 98, 255}, {0, 94, 255}, {0, 89, 255}, {0, 85, 255}, {0, 81, 255},
+  {0, 76, 255}, {0, 72, 255}, {0, 68, 255}, {0, 64, 255}, {0, 60, 255}, {0, 55, 255},
+  {0, 51, 255}, {0, 47, 255}, {0, 42, 255}, {0, 38, 255}, {0, 34, 255}, {0, 30, 255},
+  {0, 26, 255}, {0, 21, 255}, {0, 17, 255}, {0, 13, 255}, {0, 8, 255}, {0, 4, 255},
+  {0, 0, 255}, {4, 0, 255}, {8, 0, 255}, {13, 0, 255}, {17, 0, 255}, {21, 0, 255},
+  {25, 0, 255}, {30, 0, 255}, {34, 0, 255}, {38, 0, 255}, {42, 0, 255}, {47, 0, 255},
+  {51, 0, 255}, {55, 0, 255}, {60, 0, 255}, {64, 0, 255}, {68, 0, 255}, {72, 0, 255},
+  {76, 0, 255}, {81, 0, 255}, {85, 0, 255}, {89, 0, 255}, {94, 0, 255}, {98, 0, 255},
+  {102, 0, 255}, {106, 0, 255}, {111, 0, 255}, {115, 0, 255}, {119, 0, 255}, {123, 0, 255},
+  {128, 0, 255}, {132, 0, 255}, {136, 0, 255}, {140, 0, 255}, {144, 0, 255}, {149, 0, 255},
+  {153, 0, 255}, {157, 0, 255}, {161, 0, 255}, {166, 0, 255}, {170, 0, 255}, {174, 0, 255},
+  {179, 0, 255}, {183, 0, 255}, {187, 0, 255}, {191, 0, 255}, {195, 0, 255}, {200, 0, 255},
+  {204, 0, 255}, {208, 0, 255}, {213, 0, 255}, {217, 0, 255}, {221, 0, 255}, {225, 0, 255},
+  {230, 0, 255}, {234, 0, 255}, {238, 0, 255}, {242, 0, 255}, {247, 0, 255}, {251, 0, 255},
+  {255, 0, 255}, {255, 0, 251}, {255, 0, 247}, {255, 0, 242}, {255, 0, 238}, {255, 0, 234},
+  {255, 0, 229}, {255, 0, 225}, {255, 0, 221}, {255, 0, 217}, {255, 0, 213}, {255, 0, 208},
+  {255, 0, 204}, {255, 0, 200}, {255, 0, 195}, {255, 0, 191}, {255, 0, 187}, {255, 0, 183},
+  {255, 0, 178}, {255, 0, 174}, {255, 0, 170}, {255, 0, 166}, {255, 0, 161}, {255, 0, 157},
+  {255, 0, 153}, {255, 0, 149}, {255, 0, 144}, {255, 0, 140}, {255, 0, 136}, {255, 0, 132},
+  {255, 0, 128}, {255, 0, 123}, {255, 0, 119}, {255, 0, 115}, {255, 0, 111}, {255, 0, 106},
+  {255, 0, 102}, {255, 0, 98}, {255, 0, 94}, {255, 0, 89}, {255, 0, 85}, {255, 0, 81},
+  {255, 0, 77}, {255, 0, 72}, {255, 0, 68}, {255, 0, 64}, {255, 0, 59}, {255, 0, 55},
+  {255, 0, 51}, {255, 0, 47}, {255, 0, 43}, {255, 0, 38}, {255, 0, 34}, {255, 0, 30},
+  {255, 0, 25}, {255, 0, 21}, {255, 0, 17}, {255, 0, 13}, {255, 0, 8}, {255, 0, 4}
+};
+
 static RGBColor hue2rgb(int hue) {
-  float r, g, b;
-
-  float h = hue / 360.0;
-  float s = 1.0;
-  float v = 1.0;
-
-  int i = floor(h * 6);
-  float f = h * 6 - i;
-  float p = v * (1 - s);
-  float q = v * (1 - f * s);
-  float t = v * (1 - (1 - f) * s);
-
-  switch (i % 6) {
-    case 0: r = v, g = t, b = p; break;
-    case 1: r = q, g = v, b = p; break;
-    case 2: r = p, g = v, b = t; break;
-    case 3: r = p, g = q, b = v; break;
-    case 4: r = t, g = p, b = v; break;
-    case 5: r = v, g = p, b = q; break;
-    default: r = 1.0, g = 1.0, b = 1.0; break;
-  }
-  RGBColor rgb;
-  rgb.r = round(r * 255);
-  rgb.g = round(g * 255);
-  rgb.b = round(b * 255);
-  return rgb;
+  if (hue < 0) return {255, 255, 255};
+  return HUE_TO_RGB[hue % 360];
+}
+
+#if GAMMA_CORRECTION_ENABLED
+// gamma 2.2 correction for nscale8 brightness, non zero values stay visible
+static const uint8_t BRIGHTNESS_GAMMA[256] PROGMEM = {
+  0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2,
+  3, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6,
+  6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10, 11, 11, 11, 12,
+  12, 13, 13, 13, 14, 14, 15, 15, 16, 16, 17, 17, 18, 18, 19, 19,
+  20, 20, 21, 22, 22, 23, 23, 24, 25, 25, 26, 26, 27, 28, 28, 29,
+  30, 30, 31, 32, 33, 33, 34, 35, 35, 36, 37, 38, 39, 39, 40, 41,
+  42, 43, 43, 44, 45, 46, 47, 48, 49, 49, 50, 51, 52, 53, 54, 55,
+  56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70, 71,
+  73, 74, 75, 76, 77, 78, 79, 81, 82, 83, 84, 85, 87, 88, 89, 90,
+  91, 93, 94, 95, 97, 98, 99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+  113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+  137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+  163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+  192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+  223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255
+};
+#endif
+
+/**
+* Converts brightness to nscale8 value.
+* @param brightness Brightness in 1/100 of percent, 0 is off, others are raised to minBrightness
+* @param brightnessScale Brightness factor * 255 / 10000 in Q24 fixed point
+* @param minBrightness Lowest visible brightness in percent
+*/
+static uint8_t scaleBrightness(uint32_t brightness, uint32_t brightnessScale, int minBrightness) {
+  if (brightness == 0) return 0;
+  brightness = min(max(brightness, (uint32_t) minBrightness * 100), (uint32_t) 10000);
+  uint8_t scaledBrightness = (brightness * brightnessScale + (1UL << 23)) >> 24;
+#if GAMMA_CORRECTION_ENABLED
+  scaledBrightness = BRIGHTNESS_GAMMA[scaledBrightness];
+#endif
+  return scaledBrightness;
 }
 
 static int rgb2hue(uint8_t red, uint8_t green, uint8_t blue) {
@@ -175,40 +253,6 @@ static int rgb2hue(uint8_t red, uint8_t green, uint8_t blue) {
   return round(h);
 }
 
-/**
-* Maps LED sequences to values.
-* @tparam V Type of the value to map to LEDs
-* @param ledsSequence Function that returns LED sequence for a given key
-* @param values Map of district IDs to values
-* @return Mapped LED values
-*/
-template <typename V>
-static std::map<int, V> mapLeds(std::pair<int, int*> (*ledsSequence)(int key), std::map<int, V> values, V (*combiModeHandler)(V kyiv, V kyivObl) = NULL) {
-  if (!ledsSequence) {
-    return {};
-  }
-  std::map<int, V> remaped = {};
-  for (int i = 0; i < DISTRICTS_COUNT; i++) {
-    int regId = DISTRICTS[i].id;
-    auto sequence = ledsSequence(regId);
-    int ledCount = sequence.first;
-    int *ledList = sequence.second;
-    if (!ledList) {
-      continue;
-    }
-    V valueForKey = values[regId];
-    if (combiModeHandler && regId == KYIV_REGION_ID) {
-        V kyivOblValue = values[KYIV_OBL_REGION_ID];
-        valueForKey = combiModeHandler(valueForKey, kyivOblValue);
-    }
-    for (int i = 0; i < ledCount; i++) {
-      remaped[ledList[i]] = valueForKey;
-    }
-    delete[] ledList; // Free the allocated array
-  }
-  return remaped;
-}
-
 static float mapf(float value, float istart, float istop, float ostart, float ostop) {
   return ostart + (ostop - ostart) * ((value - istart) / (istop - istart));
 }
@@ -252,270 +296,6 @@ static void getHaOptions(char* result, const char* options[], int optionsSize) {
   }
 }
 
-static std::pair<int, int*> mapTranscarpatiaStart1(int key) {
-  switch (key) {
-    case 11: return std::make_pair(1, new int[1]{0});
-    case 13: return std::make_pair(1, new int[1]{1});
-    case 21: return std::make_pair(1, new int[1]{2});
-    case 27: return std::make_pair(1, new int[1]{3});
-    case 8: return std::make_pair(1, new int[1]{4});
-    case 5: return std::make_pair(1, new int[1]{5});
-    case 10: return std::make_pair(1, new int[1]{6});
-    case 14: return std::make_pair(1, new int[1]{7});
-    case 25: return std::make_pair(1, new int[1]{8});
-    case 20: return std::make_pair(1, new int[1]{9});
-    case 22: return std::make_pair(1, new int[1]{10});
-    case 16: return std::make_pair(1, new int[1]{11});
-    case 28: return std::make_pair(1, new int[1]{12});
-    case 12: return std::make_pair(1, new int[1]{13});
-    case 23: return std::make_pair(1, new int[1]{14});
-    case 9999: return std::make_pair(1, new int[1]{15});
-    case 18: return std::make_pair(1, new int[1]{16});
-    case 17: return std::make_pair(1, new int[1]{17});
-    case 9: return std::make_pair(1, new int[1]{18});
-    case 19: return std::make_pair(1, new int[1]{19});
-    case 24: return std::make_pair(1, new int[1]{20});
-    case 15: return std::make_pair(1, new int[1]{21});
-    case 4: return std::make_pair(1, new int[1]{22});
-    case 3: return std::make_pair(1, new int[1]{23});
-    case 26: return std::make_pair(1, new int[1]{24});
-    default: return std::make_pair(0, new int[0]{});
-  }
-}
-
-static std::pair<int, int*> mapOdessaStart1(int key) {
-  switch (key) {
-    case 11: return std::make_pair(1, new int[1]{9});
-    case 13: return std::make_pair(1, new int[1]{10});
-    case 21: return std::make_pair(1, new int[1]{11});
-    case 27: return std::make_pair(1, new int[1]{12});
-    case 8: return std::make_pair(1, new int[1]{13});
-    case 5: return std::make_pair(1, new int[1]{14});
-    case 10: return std::make_pair(1, new int[1]{15});
-    case 14: return std::make_pair(1, new int[1]{16});
-    case 25: return std::make_pair(1, new int[1]{17});
-    case 20: return std::make_pair(1, new int[1]{18});
-    case 22: return std::make_pair(1, new int[1]{19});
-    case 16: return std::make_pair(1, new int[1]{20});
-    case 28: return std::make_pair(1, new int[1]{21});
-    case 12: return std::make_pair(1, new int[1]{22});
-    case 23: return std::make_pair(1, new int[1]{23});
-    case 9999: return std::make_pair(1, new int[1]{24});
-    case 18: return std::make_pair(1, new int[1]{0});
-    case 17: return std::make_pair(1, new int[1]{1});
-    case 9:  return std::make_pair(1, new int[1]{2});
-    case 19: return std::make_pair(1, new int[1]{3});
-    case 24: return std::make_pair(1, new int[1]{4});
-    case 15: return std::make_pair(1, new int[1]{5});
-    case 4:  return std::make_pair(1, new int[1]{6});
-    case 3:  return std::make_pair(1, new int[1]{7});
-    case 26: return std::make_pair(1, new int[1]{8});
-    default: return std::make_pair(0, new int[0]{});
-  }
-}
-
-static std::pair<int, int*> mapTranscarpatiaStart2(int key) {
-  switch (key) {
-    case 11: return std::make_pair(1, new int[1]{0});
-    case 13: return std::make_pair(1, new int[1]{1});
-    case 21: return std::make_pair(1, new int[1]{2});
-    case 27: return std::make_pair(1, new int[1]{3});
-    case 8: return std::make_pair(1, new int[1]{4});
-    case 5: return std::make_pair(1, new int[1]{5});
-    case 10: return std::make_pair(1, new int[1]{6});
-    case 14: return std::make_pair(0, new int[0]{});
-    case 25: return std::make_pair(1, new int[1]{8});
-    case 20: return std::make_pair(1, new int[1]{9});
-    case 22: return std::make_pair(1, new int[1]{10});
-    case 16: return std::make_pair(1, new int[1]{11});
-    case 28: return std::make_pair(1, new int[1]{12});
-    case 12: return std::make_pair(1, new int[1]{13});
-    case 23: return std::make_pair(1, new int[1]{14});
-    case 9999: return std::make_pair(1, new int[1]{15});
-    case 18: return std::make_pair(1, new int[1]{16});
-    case 17: return std::make_pair(1, new int[1]{17});
-    case 9:  return std::make_pair(1, new int[1]{18});
-    case 19: return std::make_pair(1, new int[1]{19});
-    case 24: return std::make_pair(1, new int[1]{20});
-    case 15: return std::make_pair(1, new int[1]{21});
-    case 4:  return std::make_pair(1, new int[1]{22});
-    case 3:  return std::make_pair(1, new int[1]{23});
-    case 26: return std::make_pair(1, new int[1]{24});
-    case 31: return std::make_pair(1, new int[1]{7});
-    default: return std::make_pair(0, new int[0]{});
-  }
-}
-
-static std::pair<int, int*> mapOdessaStart2(int key) {
-  switch (key) {
-    case 11: return std::make_pair(1, new int[1]{9});
-    case 13: return std::make_pair(1, new int[1]{10});
-    case 21: return std::make_pair(1, new int[1]{11});
-    case 27: return std::make_pair(1, new int[1]{12});
-    case 8: return std::make_pair(1, new int[1]{13});
-    case 5: return std::make_pair(1, new int[1]{14});
-    case 10: return std::make_pair(1, new int[1]{15});
-    case 14: return std::make_pair(0, new int[0]{});
-    case 25: return std::make_pair(1, new int[1]{17});
-    case 20: return std::make_pair(1, new int[1]{18});
-    case 22: return std::make_pair(1, new int[1]{19});
-    case 16: return std::make_pair(1, new int[1]{20});
-    case 28: return std::make_pair(1, new int[1]{21});
-    case 12: return std::make_pair(1, new int[1]{22});
-    case 23: return std::make_pair(1, new int[1]{23});
-    case 9999: return std::make_pair(1, new int[1]{24});
-    case 18: return std::make_pair(1, new int[1]{0});
-    case 17: return std::make_pair(1, new int[1]{1});
-    case 9:  return std::make_pair(1, new int[1]{2});
-    case 19: return std::make_pair(1, new int[1]{3});
-    case 24: return std::make_pair(1, new int[1]{4});
-    case 15: return std::make_pair(1, new int[1]{5});
-    case 4:  return std::make_pair(1, new int[1]{6});
-    case 3:  return std::make_pair(1, new int[1]{7});
-    case 26: return std::make_pair(1, new int[1]{8});
-    case 31: return std::make_pair(1, new int[1]{16});
-    default: return std::make_pair(0, new int[0]{});
-  }
-}
-
-static std::pair<int, int*> mapTranscarpatiaStart3(int key) {
-  switch (key) {
-    case 11: return std::make_pair(1, new int[1]{0});
-    case 13: return std::make_pair(1, new int[1]{1});
-    case 21: return std::make_pair(1, new int[1]{2});
-    case 27: return std::make_pair(1, new int[1]{3});
-    case 8: return std::make_pair(1, new int[1]{4});
-    case 5: return std::make_pair(1, new int[1]{5});
-    case 10: return std::make_pair(1, new int[1]{6});
-    case 14: return std::make_pair(1, new int[1]{7});
-    case 25: return std::make_pair(1, new int[1]{9});
-    case 20: return std::make_pair(1, new int[1]{10});
-    case 22: return std::make_pair(1, new int[1]{11});
-    case 16: return std::make_pair(1, new int[1]{12});
-    case 28: return std::make_pair(1, new int[1]{13});
-    case 12: return std::make_pair(1, new int[1]{14});
-    case 23: return std::make_pair(1, new int[1]{15});
-    case 9999: return std::make_pair(1, new int[1]{16});
-    case 18: return std::make_pair(1, new int[1]{17});
-    case 17: return std::make_pair(1, new int[1]{18});
-    case 9: return std::make_pair(1, new int[1]{19});
-    case 19: return std::make_pair(1, new int[1]{20});
-    case 24: return std::make_pair(1, new int[1]{21});
-    case 15: return std::make_pair(1, new int[1]{22});
-    case 4: return std::make_pair(1, new int[1]{23});
-    case 3: return std::make_pair(1, new int[1]{24});
-    case 26: return std::make_pair(1, new int[1]{25});
-    case 31: return std::make_pair(1, new int[1]{8});
-    default: return std::make_pair(0, new int[0]{});
-  }
-}
-
-static std::pair<int, int*> mapOdessaStart3(int key) {
-  switch (key) {
-    case 11: return std::make_pair(1, new int[1]{9});
-    case 13: return std::make_pair(1, new int[1]{10});
-    case 21: return std::make_pair(1, new int[1]{11});
-    case 27: return std::make_pair(1, new int[1]{12});
-    case 8: return std::make_pair(1, new int[1]{13});
-    case 5: return std::make_pair(1, new int[1]{14});
-    case 10: return std::make_pair(1, new int[1]{15});
-    case 14: return std::make_pair(1, new int[1]{16});
-    case 25: return std::make_pair(1, new int[1]{18});
-    case 20: return std::make_pair(1, new int[1]{19});
-    case 22: return std::make_pair(1, new int[1]{20});
-    case 16: return std::make_pair(1, new int[1]{21});
-    case 28: return std::make_pair(1, new int[1]{22});
-    case 12: return std::make_pair(1, new int[1]{23});
-    case 23: return std::make_pair(1, new int[1]{24});
-    case 9999: return std::make_pair(1, new int[1]{25});
-    case 18: return std::make_pair(1, new int[1]{0});
-    case 17: return std::make_pair(1, new int[1]{1});
-    case 9:  return std::make_pair(1, new int[1]{2});
-    case 19: return std::make_pair(1, new int[1]{3});
-    case 24: return std::make_pair(1, new int[1]{4});
-    case 15: return std::make_pair(1, new int[1]{5});
-    case 4:  return std::make_pair(1, new int[1]{6});
-    case 3:  return std::make_pair(1, new int[1]{7});
-    case 26: return std::make_pair(1, new int[1]{8});
-    case 31: return std::make_pair(1, new int[1]{17});
-    default: return std::make_pair(0, new int[0]{});
-  }
-}
-
-static std::pair<int, int*> mapTranscarpatiaStart4(int key) {
-  switch (key) {
-    case 11: return std::make_pair(1, new int[1]{0});
-    case 13: return std::make_pair(1, new int[1]{1});
-    case 21: return std::make_pair(1, new int[1]{2});
-    case 27: return std::make_pair(1, new int[1]{3});
-    case 8: return std::make_pair(1, new int[1]{4});
-    case 5: return std::make_pair(1, new int[1]{5});
-    case 10: return std::make_pair(1, new int[1]{6});
-    case 14: return std::make_pair(1, new int[1]{7});
-    case 25: return std::make_pair(1, new int[1]{8});
-    case 20: return std::make_pair(1, new int[1]{9});
-    case 22: return std::make_pair(1, new int[1]{10});
-    case 16: return std::make_pair(1, new int[1]{11});
-    case 28: return std::make_pair(1, new int[1]{12});
-    case 12: return std::make_pair(1, new int[1]{13});
-    case 23: return std::make_pair(1, new int[1]{14});
-    case 9999: return std::make_pair(1, new int[1]{15});
-    case 18: return std::make_pair(1, new int[1]{16});
-    case 17: return std::make_pair(1, new int[1]{17});
-    case 9:  return std::make_pair(1, new int[1]{18});
-    case 19: return std::make_pair(1, new int[1]{19});
-    case 24: return std::make_pair(1, new int[1]{20});
-    case 15: return std::make_pair(1, new int[1]{21});
-    case 4:  return std::make_pair(1, new int[1]{22});
-    case 3:  return std::make_pair(1, new int[1]{23});
-    case 26: return std::make_pair(1, new int[1]{24});
-    case 31: return std::make_pair(1, new int[1]{7});
-    default: return std::make_pair(0, new int[0]{});
-  }
-}
-
-static std::pair<int, int*> mapOdessaStart4(int key) {
-  switch (key) {
-    case 11: return std::make_pair(1, new int[1]{9});
-    case 13: return std::make_pair(1, new int[1]{10});
-    case 21: return std::make_pair(1, new int[1]{11});
-    case 27: return std::make_pair(1, new int[1]{12});
-    case 8: return std::make_pair(1, new int[1]{13});
-    case 5: return std::make_pair(1, new int[1]{14});
-    case 10: return std::make_pair(1, new int[1]{15});
-    case 14: return std::make_pair(1, new int[1]{16});
-    case 25: return std::make_pair(1, new int[1]{17});
-    case 20: return std::make_pair(1, new int[1]{18});
-    case 22: return std::make_pair(1, new int[1]{19});
-    case 16: return std::make_pair(1, new int[1]{20});
-    case 28: return std::make_pair(1, new int[1]{21});
-    case 12: return std::make_pair(1, new int[1]{22});
-    case 23: return std::make_pair(1, new int[1]{23});
-    case 9999: return std::make_pair(1, new int[1]{24});
-    case 18: return std::make_pair(1, new int[1]{0});
-    case 17: return std::make_pair(1, new int[1]{1});
-    case 9:  return std::make_pair(1, new int[1]{2});
-    case 19: return std::make_pair(1, new int[1]{3});
-    case 24: return std::make_pair(1, new int[1]{4});
-    case 15: return std::make_pair(1, new int[1]{5});
-    case 4:  return std::make_pair(1, new int[1]{6});
-    case 3:  return std::make_pair(1, new int[1]{7});
-    case 26: return std::make_pair(1, new int[1]{8});
-    case 31: return std::make_pair(1, new int[1]{16});
-    default: return std::make_pair(0, new int[0]{});
-  }
-}
-
-static bool isInArray(int value, int* array, int arraySize) {
-  if (!array || arraySize <= 0) {
-    return false;
-  }
-  for (int i = 0; i < arraySize; i++) {
-    if (array[i] == value) return true;
-  }
-  return false;
-}
-
 static int mapIndexToRegionId(int index) {
   switch (index) {
     case 0: return 11; // Закарпатська обл.
@@ -547,3 +327,130 @@ static int mapIndexToRegionId(int index) {
     default: return -1;
   }
 }
+
+#define REGION_SLOTS_COUNT DISTRICTS_COUNT
+#define ALL_REGION_SLOTS ((1UL << REGION_SLOTS_COUNT) - 1)
+#define ALL_LEDS ((1UL << MAIN_LEDS_COUNT) - 1)
+
+// region id to dense slot (index of the region in server payloads, see mapIndexToRegionId)
+static constexpr int8_t REGION_ID_TO_SLOT[] = {
+  -1, -1, -1, 23, 22, 5, -1, -1, 4, 18, 6, 0, 13, 1, 7, 21, 11, 17, 16, 19, 9, 2, 10, 14, 20, 8, 24, 3, 12, -1, -1, 25
+};
+
+static constexpr int regionSlot(int regionId) {
+  return regionId == 9999 ? 15 : (regionId >= 0 && regionId < (int) sizeof(REGION_ID_TO_SLOT) ? REGION_ID_TO_SLOT[regionId] : -1);
+}
+
+/**
+* Compares updated values with current ones.
+* @tparam V Type of the values
+* @return Bit mask of slots with changed values
+*/
+template <typename V>
+static uint32_t diffSlots(const V current[], const V updated[], int count) {
+  uint32_t changed = 0;
+  for (int i = 0; i < count; i++) {
+    if (current[i] != updated[i]) changed |= 1UL << i;
+  }
+  return changed;
+}
+
+#define KYIV_DISTRICT_MODES_COUNT 4
+
+// LED position to region slot when strip starts in Transcarpatia, one layout per Kyiv district mode
+static constexpr int8_t TRANSCARPATIA_START_LAYOUTS[KYIV_DISTRICT_MODES_COUNT][MAIN_LEDS_COUNT] PROGMEM = {
+  // 1 - Kyiv is not shown
+  {
+    regionSlot(11), regionSlot(13), regionSlot(21), regionSlot(27), regionSlot(8), regionSlot(5),
+    regionSlot(10), regionSlot(14), regionSlot(25), regionSlot(20), regionSlot(22), regionSlot(16),
+    regionSlot(28), regionSlot(12), regionSlot(23), regionSlot(9999), regionSlot(18), regionSlot(17),
+    regionSlot(9), regionSlot(19), regionSlot(24), regionSlot(15), regionSlot(4), regionSlot(3),
+    regionSlot(26), regionSlot(-1),
+  },
+  // 2 - Kyiv instead of Kyiv Oblast
+  {
+    regionSlot(11), regionSlot(13), regionSlot(21), regionSlot(27), regionSlot(8), regionSlot(5),
+    regionSlot(10), regionSlot(31), regionSlot(25), regionSlot(20), regionSlot(22), regionSlot(16),
+    regionSlot(28), regionSlot(12), regionSlot(23), regionSlot(9999), regionSlot(18), regionSlot(17),
+    regionSlot(9), regionSlot(19), regionSlot(24), regionSlot(15), regionSlot(4), regionSlot(3),
+    regionSlot(26), regionSlot(-1),
+  },
+  // 3 - Kyiv on a separate LED
+  {
+    regionSlot(11), regionSlot(13), regionSlot(21), regionSlot(27), regionSlot(8), regionSlot(5),
+    regionSlot(10), regionSlot(14), regionSlot(31), regionSlot(25), regionSlot(20), regionSlot(22),
+    regionSlot(16), regionSlot(28), regionSlot(12), regionSlot(23), regionSlot(9999), regionSlot(18),
+    regionSlot(17), regionSlot(9), regionSlot(19), regionSlot(24), regionSlot(15), regionSlot(4),
+    regionSlot(3), regionSlot(26),
+  },
+  // 4 - Kyiv and Kyiv Oblast combined on one LED
+  {
+    regionSlot(11), regionSlot(13), regionSlot(21), regionSlot(27), regionSlot(8), regionSlot(5),
+    regionSlot(10), regionSlot(31), regionSlot(25), regionSlot(20), regionSlot(22), regionSlot(16),
+    regionSlot(28), regionSlot(12), regionSlot(23), regionSlot(9999), regionSlot(18), regionSlot(17),
+    regionSlot(9), regionSlot(19), regionSlot(24), regionSlot(15), regionSlot(4), regionSlot(3),
+    regionSlot(26), regionSlot(-1),
+  },
+};
+
+// LED position to region slot when strip starts in Odessa, one layout per Kyiv district mode
+static constexpr int8_t ODESSA_START_LAYOUTS[KYIV_DISTRICT_MODES_COUNT][MAIN_LEDS_COUNT] PROGMEM = {
+  // 1 - Kyiv is not shown
+  {
+    regionSlot(18), regionSlot(17), regionSlot(9), regionSlot(19), regionSlot(24), regionSlot(15),
+    regionSlot(4), regionSlot(3), regionSlot(26), regionSlot(11), regionSlot(13), regionSlot(21),
+    regionSlot(27), regionSlot(8), regionSlot(5), regionSlot(10), regionSlot(14), regionSlot(25),
+    regionSlot(20), regionSlot(22), regionSlot(16), regionSlot(28), regionSlot(12), regionSlot(23),
+    regionSlot(9999), regionSlot(-1),
+  },
+  // 2 - Kyiv instead of Kyiv Oblast
+  {
+    regionSlot(18), regionSlot(17), regionSlot(9), regionSlot(19), regionSlot(24), regionSlot(15),
+    regionSlot(4), regionSlot(3), regionSlot(26), regionSlot(11), regionSlot(13), regionSlot(21),
+    regionSlot(27), regionSlot(8), regionSlot(5), regionSlot(10), regionSlot(31), regionSlot(25),
+    regionSlot(20), regionSlot(22), regionSlot(16), regionSlot(28), regionSlot(12), regionSlot(23),
+    regionSlot(9999), regionSlot(-1),
+  },
+  // 3 - Kyiv on a separate LED
+  {
+    regionSlot(18), regionSlot(17), regionSlot(9), regionSlot(19), regionSlot(24), regionSlot(15),
+    regionSlot(4), regionSlot(3), regionSlot(26), regionSlot(11), regionSlot(13), regionSlot(21),
+    regionSlot(27), regionSlot(8), regionSlot(5), regionSlot(10), regionSlot(14), regionSlot(31),
+    regionSlot(25), regionSlot(20), regionSlot(22), regionSlot(16), regionSlot(28), regionSlot(12),
+    regionSlot(23), regionSlot(9999),
+  },
+  // 4 - Kyiv and Kyiv Oblast combined on one LED
+  {
+    regionSlot(18), regionSlot(17), regionSlot(9), regionSlot(19), regionSlot(24), regionSlot(15),
+    regionSlot(4), regionSlot(3), regionSlot(26), regionSlot(11), regionSlot(13), regionSlot(21),
+    regionSlot(27), regionSlot(8), regionSlot(5), regionSlot(10), regionSlot(31), regionSlot(25),
+    regionSlot(20), regionSlot(22), regionSlot(16), regionSlot(28), regionSlot(12), regionSlot(23),
+    regionSlot(9999), regionSlot(-1),
+  },
+};
+
+/**
+* Fills LED layout from user defined list of region IDs.
+* @param layout Comma separated region IDs for each LED position, -1 for unused LED
+* @param ledSlots Slot of the region shown by each LED
+* @return true if layout is valid and has exactly MAIN_LEDS_COUNT positions
+*/
+static bool parseLedLayout(const char* layout, int8_t ledSlots[]) {
+  const char* pos = layout;
+  for (int led = 0; led < MAIN_LEDS_COUNT; led++) {
+    char* end;
+    long regionId = strtol(pos, &end, 10);
+    if (end == pos) return false;
+    int slot = regionSlot(regionId);
+    if (slot < 0 && regionId != -1) return false;
+    ledSlots[led] = slot;
+    while (*end == ' ') end++;
+    if (led < MAIN_LEDS_COUNT - 1) {
+      if (*end != ',') return false;
+      pos = end + 1;
+    } else if (*end != '\0') {
+      return false;
+    }
+  }
+  return true;
+}